@@ -75,9 +75,6 @@ uniform Material material;
 uniform int noTex;
 uniform vec3 viewPos;
 
-uniform int applyGrassTint;
-uniform vec3 grassTintColor;
-
 vec4 calcPointLight(int idx, vec3 norm, vec3 viewDir, vec4 diffMap, vec4 specMap);
 
 vec4 calcDirLight(vec3 norm, vec3 viewDir, vec4 diffMap, vec4 specMap);
@@ -97,10 +94,6 @@ void main(){
 		}else{
 		diffMap = texture(diffuse0, TexCoord);
 		specMap = texture(specular0, TexCoord);
-
-		if (applyGrassTint == 1) {
-            diffMap.rgb *= grassTintColor;
-        }
 	}
 
 
@@ -0,0 +1,19 @@
+#version 330 core
+// Chunk faces: the block texture lit by the light baked into the vertices (see voxel.vs)
+in vec2 TexCoord;
+flat in int Layer;
+flat in vec3 Light;
+
+out vec4 FragColor;
+
+uniform sampler2DArray blockTextures;
+uniform int grassTintLayer;
+uniform vec3 grassTintColor;
+
+void main(){
+	vec4 color = texture(blockTextures, vec3(TexCoord, float(Layer)));
+	if (Layer == grassTintLayer) {
+		color.rgb *= grassTintColor;
+	}
+	FragColor = vec4(color.rgb * Light, color.a);
+}
@@ -0,0 +1,45 @@
+#version 330 core
+// Chunk vertices in the packed VoxelVertex format (see chunkmesh.hpp)
+layout (location = 0) in uint aData0;
+layout (location = 1) in uint aData1;
+
+out vec2 TexCoord;
+flat out int Layer;
+// Colour the face's texture is multiplied by
+flat out vec3 Light;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+// Scales sky light, 1 in full daylight
+uniform float skyBrightness;
+
+// indexed by Face: FRONT, BACK, LEFT, RIGHT, TOP, BOTTOM. Light levels are per voxel,
+// so faces are shaded by which way they point to keep the blocks' edges readable.
+const float faceShade[6] = float[6](0.8, 0.8, 0.6, 0.6, 1.0, 0.5);
+
+const vec3 skyColor = vec3(1.0, 1.0, 1.0);
+const vec3 blockColor = vec3(1.0, 0.85, 0.6);
+
+// every level below 15 is a fifth darker than the one above it
+float brightness(uint level) {
+	return pow(0.8, float(15u - level));
+}
+
+void main(){
+	vec3 localPos = vec3(
+		float(aData0 & 0x1Fu),
+		float((aData0 >> 5) & 0x7Fu),
+		float((aData0 >> 12) & 0x1Fu)
+	);
+	uint face = (aData0 >> 17) & 0x7u;
+
+	TexCoord = vec2(float((aData0 >> 20) & 0x1Fu), float((aData0 >> 25) & 0x7Fu));
+	Layer = int(aData1 & 0xFFu);
+
+	vec3 sky = skyColor * brightness((aData1 >> 8) & 0xFu) * skyBrightness;
+	vec3 block = blockColor * brightness((aData1 >> 12) & 0xFu);
+	Light = max(sky, block) * faceShade[face];
+
+	gl_Position = projection * view * model * vec4(localPos, 1.0);
+}
@@ -0,0 +1,1923 @@
+#include "Benchmark.h"
+#include "../graphics/env/World.h"
+#include "../graphics/env/RegionStore.h"
+#include "../graphics/env/EditJournal.h"
+#include "../graphics/env/PendingWrites.h"
+#include "../graphics/env/ChunkPipeline.h"
+#include "../graphics/env/VoxelLight.h"
+#include "../graphics/models/chunkstorage.hpp"
+#include "../graphics/Mesh.h"
+#include "../graphics/Frustum.h"
+#include "../graphics/models/ThreadSafeQueue.hpp"
+#include "../graphics/models/ChunkLoadQueue.hpp"
+#include "../graphics/models/LockFreeQueue.hpp"
+#include "../jobs/JobSystem.h"
+#include "../generation/perlin.h"
+#include "../generation/NoiseGraph.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double elapsedMs(Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// Counts live heap bytes so the nested maps can be measured exactly
+	size_t g_mapBytes = 0;
+
+	template <typename T>
+	struct CountingAllocator {
+		typedef T value_type;
+
+		CountingAllocator() = default;
+		template <typename U>
+		CountingAllocator(const CountingAllocator<U>&) {}
+
+		T* allocate(size_t n) {
+			g_mapBytes += n * sizeof(T);
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		}
+
+		void deallocate(T* p, size_t n) {
+			g_mapBytes -= n * sizeof(T);
+			::operator delete(p);
+		}
+
+		template <typename U>
+		bool operator==(const CountingAllocator<U>&) const { return true; }
+		template <typename U>
+		bool operator!=(const CountingAllocator<U>&) const { return false; }
+	};
+
+	template <typename K, typename V>
+	using CountedMap = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, CountingAllocator<std::pair<const K, V>>>;
+
+	// The layout VoxelChunk used before ChunkStorage
+	typedef CountedMap<int, CountedMap<int, CountedMap<int, VoxelType>>> NestedVoxelMap;
+
+	VoxelType mapLookup(const NestedVoxelMap& voxels, int x, int y, int z) {
+		auto itX = voxels.find(x);
+		if (itX == voxels.end()) return VoxelType::AIR;
+		auto itY = itX->second.find(y);
+		if (itY == itX->second.end()) return VoxelType::AIR;
+		auto itZ = itY->second.find(z);
+		if (itZ == itY->second.end()) return VoxelType::AIR;
+		return itZ->second;
+	}
+
+	// Millions of queue operations per second with noThreads threads each pushing and
+	// popping batch items at a time, opsPerThread operations each
+	template <typename PushBatch, typename PopBatch>
+	double queueThroughput(int noThreads, int opsPerThread, int batch, PushBatch pushBatch, PopBatch popBatch) {
+		std::atomic<int> ready(0);
+		std::atomic<bool> go(false);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < noThreads; t++) {
+			threads.emplace_back([&, t]() {
+				std::vector<glm::ivec2> items;
+				ready++;
+				while (!go) std::this_thread::yield();
+				for (int done = 0; done < opsPerThread; done += 2 * batch) {
+					items.assign(batch, glm::ivec2(t, done));
+					pushBatch(items);
+					items.clear();
+					// other threads may have taken ours, keep going until we got as many back
+					size_t popped = 0;
+					while (popped < static_cast<size_t>(batch)) {
+						size_t n = popBatch(items, batch - popped);
+						if (n == 0) std::this_thread::yield();
+						popped += n;
+					}
+				}
+			});
+		}
+		while (ready < noThreads) std::this_thread::yield();
+		auto start = Clock::now();
+		go = true;
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		return noThreads * static_cast<double>(opsPerThread) / (elapsedMs(start) * 1000.0);
+	}
+
+	// Chunk layers the terrain surface runs through, heights 16 to 48
+	const int surfaceBottom = 1;
+	const int surfaceTop = 2;
+
+	// The chunks World::generateChunksAroundPosition loads around center, in the same order
+	std::vector<glm::ivec3> chunkCylinder(glm::ivec3 center, int radius, int height) {
+		std::vector<glm::ivec3> coords;
+		for (int x = center.x - radius; x <= center.x + radius; x++) {
+			for (int z = center.z - radius; z <= center.z + radius; z++) {
+				int dx = x - center.x, dz = z - center.z;
+				if (dx * dx + dz * dz > radius * radius) continue;
+				for (int y = center.y - height; y <= center.y + height; y++) {
+					coords.push_back(glm::ivec3(x, y, z));
+				}
+			}
+		}
+		return coords;
+	}
+
+	// Chunk i of a grid chunksPerSide columns wide centred on the origin, two surface layers per column
+	glm::ivec3 surfaceChunk(int i, int chunksPerSide) {
+		int column = i / 2;
+		return glm::ivec3(column % chunksPerSide - chunksPerSide / 2, surfaceBottom + i % 2, column / chunksPerSide - chunksPerSide / 2);
+	}
+
+	// Border slices of the chunks next to coords found in borders, the way World::gatherNeighbors collects them
+	ChunkNeighbors neighborsOf(glm::ivec3 coords, const std::unordered_map<long long, ChunkBorders>& borders) {
+		const Face sides[] = { Face::FRONT, Face::BACK, Face::LEFT, Face::RIGHT, Face::TOP, Face::BOTTOM };
+		const glm::ivec3 offsets[] = { {0, 0, 1}, {0, 0, -1}, {-1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, -1, 0} };
+		ChunkNeighbors neighbors;
+		for (int s = 0; s < 6; s++) {
+			glm::ivec3 next = coords + offsets[s];
+			auto it = borders.find(World::getChunkKey(next.x, next.y, next.z));
+			if (it != borders.end()) {
+				neighbors.edges[static_cast<int>(sides[s])] = it->second[static_cast<int>(VoxelChunk::oppositeFace(sides[s]))];
+			}
+		}
+		return neighbors;
+	}
+
+	// First chunk column of the biome region near the origin with the most forest, where trees
+	// grow thickest and reach into their neighbours most
+	glm::ivec2 mostForestedRegion(World& world) {
+		glm::ivec2 origin(0, 0);
+		int mostForest = -1;
+		for (int regionZ = -8; regionZ < 8; regionZ++) {
+			for (int regionX = -8; regionX < 8; regionX++) {
+				int forest = 0;
+				for (int z = 0; z < BiomeRegion::BLOCKS; z += 8) {
+					for (int x = 0; x < BiomeRegion::BLOCKS; x += 8) {
+						if (world.getBiomeAt(regionX * BiomeRegion::BLOCKS + x, regionZ * BiomeRegion::BLOCKS + z) == Biome::FOREST) forest++;
+					}
+				}
+				if (forest > mostForest) {
+					mostForest = forest;
+					origin = glm::ivec2(regionX, regionZ) * BiomeMap::REGION_SIZE;
+				}
+			}
+		}
+		return origin;
+	}
+
+	// Completion time of every chunk in coords, built by noWorkers threads the way
+	// the old dedicated chunk workers built them, with the chunks pushed in the given order
+	template <typename Queue>
+	std::vector<double> streamChunks(World& world, Queue& queue, const std::vector<glm::ivec3>& coords, int noWorkers) {
+		std::vector<double> doneMs(coords.size(), 0.0);
+		std::unordered_map<long long, size_t> indexOf;
+		for (size_t i = 0; i < coords.size(); i++) {
+			indexOf[World::getChunkKey(coords[i].x, coords[i].y, coords[i].z)] = i;
+		}
+
+		std::atomic<size_t> remaining(coords.size());
+		auto start = Clock::now();
+		std::vector<std::thread> workers;
+		for (int w = 0; w < noWorkers; w++) {
+			workers.emplace_back([&]() {
+				glm::ivec3 chunk;
+				while (queue.wait_and_pop(chunk)) {
+					ChunkMeshData meshData;
+					world.generateTerrain(chunk.x, chunk.y, chunk.z, meshData.voxels);
+					VoxelChunk::buildMeshData(meshData.voxels, ChunkNeighbors(), meshData, MeshingMode::NAIVE);
+					doneMs[indexOf[World::getChunkKey(chunk.x, chunk.y, chunk.z)]] = elapsedMs(start);
+					if (--remaining == 0) {
+						queue.stop();
+					}
+				}
+			});
+		}
+
+		for (const glm::ivec3& c : coords) {
+			queue.push(c);
+		}
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		return doneMs;
+	}
+}
+
+int Benchmark::run(const std::string& name, World& world) {
+	if (name == "storage") {
+		chunkStorage(world);
+	}
+	else if (name == "meshing") {
+		meshing(world);
+	}
+	else if (name == "seams") {
+		seamCulling(world);
+	}
+	else if (name == "vertexformat") {
+		vertexFormat(world);
+	}
+	else if (name == "drawcalls") {
+		drawCalls(world);
+	}
+	else if (name == "frustum") {
+		frustumCulling(world);
+	}
+	else if (name == "teleport") {
+		teleport(world);
+	}
+	else if (name == "jobs") {
+		jobScaling(world);
+	}
+	else if (name == "queues") {
+		queueContention(world);
+	}
+	else if (name == "edits") {
+		editRemesh(world);
+	}
+	else if (name == "cubic") {
+		cubicChunks(world);
+	}
+	else if (name == "regions") {
+		regionFiles(world);
+	}
+	else if (name == "journal") {
+		editJournal(world);
+	}
+	else if (name == "noise") {
+		noiseGrid(world);
+	}
+	else if (name == "heightmap") {
+		heightmapCache(world);
+	}
+	else if (name == "density") {
+		densityTerrain(world);
+	}
+	else if (name == "biomes") {
+		biomeMap(world);
+	}
+	else if (name == "graph") {
+		noiseGraph(world);
+	}
+	else if (name == "features") {
+		featurePlacement(world);
+	}
+	else if (name == "pipeline") {
+		chunkPipeline(world);
+	}
+	else if (name == "lighting") {
+		voxelLighting(world);
+	}
+	else {
+		std::cout << "Unknown benchmark: " << name << std::endl;
+		std::cout << "Available: storage, meshing, seams, vertexformat, drawcalls, frustum, teleport, jobs, queues, edits, cubic, regions, journal, noise, heightmap, density, biomes, graph, features, pipeline, lighting" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+void Benchmark::chunkStorage(World& world) {
+	const int chunksPerSide = 8;
+	const int noChunks = chunksPerSide * chunksPerSide * 2;
+	const int noLookups = 4000000;
+
+	std::vector<ChunkStorage> flat(noChunks);
+	std::vector<std::unique_ptr<NestedVoxelMap>> maps;
+	size_t solidVoxels = 0;
+
+	for (int i = 0; i < noChunks; i++) {
+		glm::ivec3 chunk = surfaceChunk(i, chunksPerSide);
+		world.generateTerrain(chunk.x, chunk.y, chunk.z, flat[i]);
+
+		maps.push_back(std::unique_ptr<NestedVoxelMap>(new NestedVoxelMap()));
+		for (int y = 0; y < CHUNK_HEIGHT; y++) {
+			for (int z = 0; z < CHUNK_SIZE; z++) {
+				for (int x = 0; x < CHUNK_SIZE; x++) {
+					VoxelType type = flat[i].get(x, y, z);
+					if (type != VoxelType::AIR) {
+						(*maps[i])[x][y][z] = type;
+						solidVoxels++;
+					}
+				}
+			}
+		}
+	}
+
+	size_t flatBytes = 0;
+	for (const ChunkStorage& storage : flat) {
+		flatBytes += storage.memoryUsage();
+	}
+	size_t mapBytes = g_mapBytes + noChunks * sizeof(NestedVoxelMap);
+
+	// Random lookups anywhere in the chunk volume, plus a bit of out of range like the mesher does
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> chunkDist(0, noChunks - 1);
+	std::uniform_int_distribution<int> xzDist(-1, CHUNK_SIZE);
+	std::uniform_int_distribution<int> yDist(-1, CHUNK_HEIGHT);
+	struct Lookup { int chunk, x, y, z; };
+	std::vector<Lookup> lookups(noLookups);
+	for (Lookup& l : lookups) {
+		l = { chunkDist(rng), xzDist(rng), yDist(rng), xzDist(rng) };
+	}
+
+	size_t checksumFlat = 0;
+	auto start = Clock::now();
+	for (const Lookup& l : lookups) {
+		checksumFlat += static_cast<size_t>(flat[l.chunk].get(l.x, l.y, l.z));
+	}
+	double flatRandomMs = elapsedMs(start);
+
+	size_t checksumMap = 0;
+	start = Clock::now();
+	for (const Lookup& l : lookups) {
+		checksumMap += static_cast<size_t>(mapLookup(*maps[l.chunk], l.x, l.y, l.z));
+	}
+	double mapRandomMs = elapsedMs(start);
+
+	// Sequential scan of every voxel, the access pattern of meshing
+	start = Clock::now();
+	for (int i = 0; i < noChunks; i++) {
+		for (int y = 0; y < CHUNK_HEIGHT; y++)
+			for (int z = 0; z < CHUNK_SIZE; z++)
+				for (int x = 0; x < CHUNK_SIZE; x++)
+					checksumFlat += static_cast<size_t>(flat[i].get(x, y, z));
+	}
+	double flatScanMs = elapsedMs(start);
+
+	start = Clock::now();
+	for (int i = 0; i < noChunks; i++) {
+		for (int y = 0; y < CHUNK_HEIGHT; y++)
+			for (int z = 0; z < CHUNK_SIZE; z++)
+				for (int x = 0; x < CHUNK_SIZE; x++)
+					checksumMap += static_cast<size_t>(mapLookup(*maps[i], x, y, z));
+	}
+	double mapScanMs = elapsedMs(start);
+
+	double scanLookups = static_cast<double>(noChunks) * ChunkStorage::VOLUME;
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Chunk storage benchmark (" << noChunks << " chunks, "
+		<< solidVoxels / noChunks << " solid voxels per chunk)" << std::endl;
+	std::cout << "                      nested maps    ChunkStorage" << std::endl;
+	std::cout << "  bytes per chunk     " << std::setw(11) << mapBytes / static_cast<double>(noChunks)
+		<< "    " << std::setw(12) << flatBytes / static_cast<double>(noChunks) << std::endl;
+	std::cout << "  random  Mlookups/s  " << std::setw(11) << noLookups / (mapRandomMs * 1000.0)
+		<< "    " << std::setw(12) << noLookups / (flatRandomMs * 1000.0) << std::endl;
+	std::cout << "  scan    Mlookups/s  " << std::setw(11) << scanLookups / (mapScanMs * 1000.0)
+		<< "    " << std::setw(12) << scanLookups / (flatScanMs * 1000.0) << std::endl;
+	std::cout << "  (checksums " << checksumMap << " / " << checksumFlat << ")" << std::endl;
+}
+
+void Benchmark::meshing(World& world) {
+	const int chunksPerSide = 8;
+	const int noChunks = chunksPerSide * chunksPerSide * 2;
+	const int repeats = 5;
+
+	std::vector<ChunkStorage> voxels(noChunks);
+	for (int i = 0; i < noChunks; i++) {
+		glm::ivec3 chunk = surfaceChunk(i, chunksPerSide);
+		world.generateTerrain(chunk.x, chunk.y, chunk.z, voxels[i]);
+	}
+
+	const MeshingMode modes[] = { MeshingMode::NAIVE, MeshingMode::GREEDY };
+	const char* names[] = { "naive", "greedy" };
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Meshing benchmark (" << noChunks << " chunks, best of " << repeats << " runs)" << std::endl;
+	std::cout << "  mode      vertices/chunk  indices/chunk  ms/chunk" << std::endl;
+	for (int m = 0; m < 2; m++) {
+		size_t vertices = 0, indices = 0;
+		double bestMs = 0.0;
+		for (int r = 0; r < repeats; r++) {
+			double totalMs = 0.0;
+			vertices = indices = 0;
+			for (int i = 0; i < noChunks; i++) {
+				ChunkMeshData meshData;
+				VoxelChunk::buildMeshData(voxels[i], ChunkNeighbors(), meshData, modes[m]);
+				totalMs += meshData.meshingTimeMs;
+				vertices += meshData.vertexCount();
+				indices += meshData.indexCount();
+			}
+			if (r == 0 || totalMs < bestMs) bestMs = totalMs;
+		}
+		std::cout << "  " << std::left << std::setw(8) << names[m] << std::right
+			<< std::setw(16) << vertices / static_cast<double>(noChunks)
+			<< std::setw(15) << indices / static_cast<double>(noChunks)
+			<< std::setw(10) << std::setprecision(3) << bestMs / noChunks << std::setprecision(1) << std::endl;
+	}
+}
+
+void Benchmark::seamCulling(World& world) {
+	const int renderDistance = 8;
+
+	// Same chunk set World::generateChunksAroundPosition loads around the origin, the surface layers and one above
+	std::vector<glm::ivec3> coords = chunkCylinder(glm::ivec3(0, surfaceTop, 0), renderDistance, 1);
+
+	std::vector<ChunkStorage> voxels(coords.size());
+	std::unordered_map<long long, ChunkBorders> borders;
+	for (size_t i = 0; i < coords.size(); i++) {
+		world.generateTerrain(coords[i].x, coords[i].y, coords[i].z, voxels[i]);
+		borders[World::getChunkKey(coords[i].x, coords[i].y, coords[i].z)] = VoxelChunk::extractBorders(voxels[i]);
+	}
+
+	size_t isolatedFaces = 0, seamFaces = 0, culled = 0;
+	for (size_t i = 0; i < coords.size(); i++) {
+		ChunkNeighbors neighbors = neighborsOf(coords[i], borders);
+
+		ChunkMeshData isolated, withNeighbors;
+		VoxelChunk::buildMeshData(voxels[i], ChunkNeighbors(), isolated, MeshingMode::NAIVE);
+		VoxelChunk::buildMeshData(voxels[i], neighbors, withNeighbors, MeshingMode::NAIVE);
+		isolatedFaces += isolated.indexCount() / 6;
+		seamFaces += withNeighbors.indexCount() / 6;
+		culled += withNeighbors.seamFacesCulled;
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Seam culling benchmark (render distance " << renderDistance << ", " << coords.size() << " chunks)" << std::endl;
+	std::cout << "  faces, chunk-local culling    " << isolatedFaces << std::endl;
+	std::cout << "  faces, neighbour-aware        " << seamFaces << std::endl;
+	std::cout << "  seam faces removed            " << culled << " ("
+		<< 100.0 * culled / static_cast<double>(isolatedFaces) << "%)" << std::endl;
+}
+
+void Benchmark::vertexFormat(World& world) {
+	const int chunksPerSide = 8;
+	const int noChunks = chunksPerSide * chunksPerSide * 2;
+
+	std::vector<ChunkStorage> voxels(noChunks);
+	for (int i = 0; i < noChunks; i++) {
+		glm::ivec3 chunk = surfaceChunk(i, chunksPerSide);
+		world.generateTerrain(chunk.x, chunk.y, chunk.z, voxels[i]);
+	}
+
+	const MeshingMode modes[] = { MeshingMode::NAIVE, MeshingMode::GREEDY };
+	const char* names[] = { "naive", "greedy" };
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Vertex format benchmark (" << noChunks << " chunks, Vertex " << sizeof(Vertex)
+		<< " bytes, VoxelVertex " << sizeof(VoxelVertex) << " bytes)" << std::endl;
+	std::cout << "  mode      KB/chunk Vertex  KB/chunk VoxelVertex  saved" << std::endl;
+	for (int m = 0; m < 2; m++) {
+		size_t vertices = 0, indices = 0;
+		for (int i = 0; i < noChunks; i++) {
+			ChunkMeshData meshData;
+			VoxelChunk::buildMeshData(voxels[i], ChunkNeighbors(), meshData, modes[m]);
+			vertices += meshData.vertexCount();
+			indices += meshData.indexCount();
+		}
+
+		// Mesh also kept its vertex and index vectors after upload, ChunkMesh does not
+		double indexBytes = static_cast<double>(indices) * sizeof(unsigned int);
+		double before = 2.0 * (vertices * sizeof(Vertex) + indexBytes);
+		double after = vertices * sizeof(VoxelVertex) + indexBytes;
+		std::cout << "  " << std::left << std::setw(8) << names[m] << std::right
+			<< std::setw(17) << before / noChunks / 1024.0
+			<< std::setw(22) << after / noChunks / 1024.0
+			<< std::setw(6) << 100.0 * (1.0 - after / before) << "%" << std::endl;
+	}
+}
+
+void Benchmark::drawCalls(World& world) {
+	const int renderDistance = 8;
+
+	size_t chunks = 0, materialDraws = 0, chunkDraws = 0;
+	for (const glm::ivec3& c : chunkCylinder(glm::ivec3(0, surfaceTop, 0), renderDistance, 1)) {
+		ChunkStorage voxels;
+		world.generateTerrain(c.x, c.y, c.z, voxels);
+		ChunkMeshData meshData;
+		VoxelChunk::buildMeshData(voxels, ChunkNeighbors(), meshData, MeshingMode::NAIVE);
+
+		chunks++;
+		for (int i = 0; i < VoxelChunk::MATERIAL_BUCKETS; i++) {
+			if (meshData.materialBuckets & (1 << i)) materialDraws++;
+		}
+		if (!meshData.indices.empty()) chunkDraws++;
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Draw call benchmark (render distance " << renderDistance << ", " << chunks << " chunks)" << std::endl;
+	std::cout << "  draws per frame, mesh per material    " << materialDraws << std::endl;
+	std::cout << "  draws per frame, texture array        " << chunkDraws << std::endl;
+}
+
+void Benchmark::frustumCulling(World& world) {
+	const int renderDistance = 8;
+	const int repeats = 10000;
+
+	// Chunk bounds around the origin with the same tight Y range VoxelChunk uses
+	AabbList tight, full;
+	for (const glm::ivec3& c : chunkCylinder(glm::ivec3(0, surfaceTop, 0), renderDistance, 1)) {
+		ChunkStorage voxels;
+		world.generateTerrain(c.x, c.y, c.z, voxels);
+		int minY, maxY;
+		if (!voxels.solidHeightRange(minY, maxY)) continue;
+
+		glm::vec3 corner(c * CHUNK_SIZE);
+		tight.push(corner + glm::vec3(0.0f, minY, 0.0f), corner + glm::vec3(CHUNK_SIZE, maxY, CHUNK_SIZE));
+		full.push(corner, corner + glm::vec3(CHUNK_SIZE, CHUNK_HEIGHT, CHUNK_SIZE));
+	}
+
+	// Same projection as main.cpp, standing above the terrain and looking level along +x
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	glm::vec3 eye(8.0f, 50.0f, 8.0f);
+	glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(projection * view);
+
+	std::vector<uint8_t> visible;
+	size_t tightVisible = frustum.testBoxes(tight, visible);
+	size_t fullVisible = frustum.testBoxes(full, visible);
+
+	size_t mismatches = 0;
+	frustum.testBoxes(tight, visible);
+	for (size_t i = 0; i < tight.size(); i++) {
+		bool scalar = frustum.intersects(glm::vec3(tight.minX[i], tight.minY[i], tight.minZ[i]),
+			glm::vec3(tight.maxX[i], tight.maxY[i], tight.maxZ[i]));
+		if (scalar != (visible[i] != 0)) mismatches++;
+	}
+
+	size_t checksum = 0;
+	auto start = Clock::now();
+	for (int r = 0; r < repeats; r++) {
+		checksum += frustum.testBoxes(tight, visible);
+	}
+	double soaMs = elapsedMs(start);
+
+	start = Clock::now();
+	for (int r = 0; r < repeats; r++) {
+		for (size_t i = 0; i < tight.size(); i++) {
+			checksum += frustum.intersects(glm::vec3(tight.minX[i], tight.minY[i], tight.minZ[i]),
+				glm::vec3(tight.maxX[i], tight.maxY[i], tight.maxZ[i]));
+		}
+	}
+	double scalarMs = elapsedMs(start);
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Frustum culling benchmark (render distance " << renderDistance << ", " << tight.size() << " chunks)" << std::endl;
+	std::cout << "  visible, whole chunk bounds      " << fullVisible << std::endl;
+	std::cout << "  visible, solid Y bounds          " << tightVisible << " ("
+		<< 100.0 * (tight.size() - tightVisible) / tight.size() << "% culled)" << std::endl;
+	std::cout << std::setprecision(3);
+	std::cout << "  SoA test     us/frame            " << 1000.0 * soaMs / repeats << std::endl;
+	std::cout << "  per box test us/frame            " << 1000.0 * scalarMs / repeats << std::endl;
+	std::cout << "  (mismatches " << mismatches << ", checksum " << checksum << ")" << std::endl;
+}
+
+void Benchmark::teleport(World& world) {
+	const int renderDistance = 8;
+	const int noWorkers = 4;
+	const int repeats = 5;
+
+	// Fixed destination and heading so runs are comparable
+	glm::vec3 destination(2000.0f, 50.0f, -1200.0f);
+	glm::vec3 heading = glm::normalize(glm::vec3(1.0f, -0.2f, 0.4f));
+
+	// Row by row, the order World::generateChunksAroundPosition pushes them in
+	std::vector<glm::ivec3> coords = chunkCylinder(world.getChunkCoords(destination), renderDistance, world.getVerticalRenderDistance());
+
+	// "Visible terrain" is every chunk the main.cpp camera would draw at the destination
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(destination, destination + heading, glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(projection * view);
+	std::vector<size_t> visible;
+	for (size_t i = 0; i < coords.size(); i++) {
+		glm::vec3 corner(coords[i] * CHUNK_SIZE);
+		if (frustum.intersects(corner, corner + glm::vec3(CHUNK_SIZE, CHUNK_HEIGHT, CHUNK_SIZE))) {
+			visible.push_back(i);
+		}
+	}
+
+	// first visible chunk, 90% and all of them, and the whole render distance
+	struct Result { double first, most, all, total; };
+	auto summarize = [&](const std::vector<double>& doneMs) {
+		std::vector<double> times;
+		for (size_t i : visible) times.push_back(doneMs[i]);
+		std::sort(times.begin(), times.end());
+		Result r;
+		r.first = times.front();
+		r.most = times[(times.size() * 9 + 9) / 10 - 1];
+		r.all = times.back();
+		r.total = *std::max_element(doneMs.begin(), doneMs.end());
+		return r;
+	};
+	auto median = [](std::vector<Result> runs, double Result::* field) {
+		std::sort(runs.begin(), runs.end(), [field](const Result& a, const Result& b) { return a.*field < b.*field; });
+		return runs[runs.size() / 2].*field;
+	};
+
+	std::vector<Result> fifoRuns, priorityRuns;
+	for (int r = 0; r < repeats; r++) {
+		ThreadSafeQueue<glm::ivec3> fifo;
+		fifoRuns.push_back(summarize(streamChunks(world, fifo, coords, noWorkers)));
+
+		ChunkLoadQueue prioritized;
+		prioritized.setFocus(destination, heading);
+		priorityRuns.push_back(summarize(streamChunks(world, prioritized, coords, noWorkers)));
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Teleport benchmark (render distance " << renderDistance << ", " << coords.size() << " chunks, "
+		<< visible.size() << " in view, " << noWorkers << " workers, median of " << repeats << " runs)" << std::endl;
+	std::cout << "  ms until              FIFO    prioritized" << std::endl;
+	const char* labels[] = { "first chunk in view", "90% of view        ", "all of view        ", "whole area         " };
+	double Result::* fields[] = { &Result::first, &Result::most, &Result::all, &Result::total };
+	for (int i = 0; i < 4; i++) {
+		std::cout << "  " << labels[i] << std::setw(7) << median(fifoRuns, fields[i])
+			<< std::setw(15) << median(priorityRuns, fields[i]) << std::endl;
+	}
+}
+
+void Benchmark::jobScaling(World& world) {
+	const int renderDistance = 8;
+	const int repeats = 3;
+
+	std::vector<glm::ivec3> coords = chunkCylinder(glm::ivec3(0, surfaceTop, 0), renderDistance, 1);
+
+	std::vector<int> threadCounts;
+	int hardwareThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	for (int n = 1; n < hardwareThreads; n *= 2) {
+		threadCounts.push_back(n);
+	}
+	threadCounts.push_back(hardwareThreads);
+
+	auto median = [](std::vector<double> runs) {
+		std::sort(runs.begin(), runs.end());
+		return runs[runs.size() / 2];
+	};
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Job system benchmark (render distance " << renderDistance << ", " << coords.size()
+		<< " chunks generated and meshed, median of " << repeats << " runs)" << std::endl;
+	std::cout << "  threads   worker loop chunks/s   job system chunks/s   speedup   stolen" << std::endl;
+
+	for (int threads : threadCounts) {
+		std::vector<double> loopRuns, jobRuns;
+		size_t stolen = 0;
+		for (int r = 0; r < repeats; r++) {
+			// every thread blocking on one shared queue, like World's old worker loop
+			ThreadSafeQueue<glm::ivec3> queue;
+			auto start = Clock::now();
+			streamChunks(world, queue, coords, threads);
+			loopRuns.push_back(coords.size() / (elapsedMs(start) / 1000.0));
+
+			// generation and meshing as separate dependent jobs, like World::queueChunk;
+			// the main thread only waits, so both sides use the same number of threads
+			JobSystem jobs(threads);
+			start = Clock::now();
+			std::vector<JobHandle> meshed;
+			for (const glm::ivec3& c : coords) {
+				std::shared_ptr<ChunkMeshData> meshData = std::make_shared<ChunkMeshData>();
+				JobHandle generation = jobs.submit([&world, c, meshData] { world.generateTerrain(c.x, c.y, c.z, meshData->voxels); });
+				meshed.push_back(jobs.submit([meshData] {
+					VoxelChunk::buildMeshData(meshData->voxels, ChunkNeighbors(), *meshData, MeshingMode::NAIVE);
+				}, { generation }));
+			}
+			std::promise<void> finished;
+			jobs.submit([&finished] { finished.set_value(); }, meshed);
+			finished.get_future().wait();
+			jobRuns.push_back(coords.size() / (elapsedMs(start) / 1000.0));
+			stolen += jobs.getJobsStolen();
+		}
+
+		double loopRate = median(loopRuns);
+		double jobRate = median(jobRuns);
+		std::cout << "  " << std::setw(7) << threads << std::setw(23) << loopRate << std::setw(22) << jobRate
+			<< std::setw(9) << std::setprecision(2) << jobRate / loopRate << "x"
+			<< std::setw(9) << stolen / repeats << std::setprecision(1) << std::endl;
+	}
+}
+
+void Benchmark::queueContention(World&) {
+	const int opsPerThread = 200000;
+	const int batch = 16;
+	const int threadCounts[] = { 1, 2, 4, 8, 16, 32 };
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Queue contention benchmark (Mops/s, each thread pushes then pops, " << opsPerThread << " ops per thread, "
+		<< std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+	std::cout << "  threads   ThreadSafeQueue   LockFreeQueue   LockFreeQueue x" << batch << std::endl;
+
+	for (int threads : threadCounts) {
+		ThreadSafeQueue<glm::ivec2> locked;
+		double lockedRate = queueThroughput(threads, opsPerThread, 1,
+			[&](std::vector<glm::ivec2>& items) { for (glm::ivec2& item : items) locked.push(item); },
+			[&](std::vector<glm::ivec2>& out, size_t) {
+				glm::ivec2 item;
+				if (!locked.try_pop(item)) return static_cast<size_t>(0);
+				out.push_back(item);
+				return static_cast<size_t>(1);
+			});
+
+		LockFreeQueue<glm::ivec2> lockFree(4096);
+		double lockFreeRate = queueThroughput(threads, opsPerThread, 1,
+			[&](std::vector<glm::ivec2>& items) { for (glm::ivec2& item : items) lockFree.push(item); },
+			[&](std::vector<glm::ivec2>& out, size_t) {
+				glm::ivec2 item;
+				if (!lockFree.try_pop(item)) return static_cast<size_t>(0);
+				out.push_back(item);
+				return static_cast<size_t>(1);
+			});
+
+		LockFreeQueue<glm::ivec2> batched(4096);
+		double batchedRate = queueThroughput(threads, opsPerThread, batch,
+			[&](std::vector<glm::ivec2>& items) { batched.push_n(items); },
+			[&](std::vector<glm::ivec2>& out, size_t maxCount) { return batched.try_pop_n(out, maxCount); });
+
+		std::cout << "  " << std::setw(7) << threads << std::setw(18) << lockedRate
+			<< std::setw(16) << lockFreeRate << std::setw(18) << batchedRate << std::endl;
+	}
+}
+
+void Benchmark::editRemesh(World& world) {
+	const int edits = 500;
+
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<int> local(0, CHUNK_SIZE - 1);
+	std::uniform_int_distribution<int> chunkCoord(-4, 4);
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Edit remesh benchmark (" << edits << " single block edits at the surface, CPU meshing only)" << std::endl;
+	std::cout << "  us per edit   remesh job   snapshot" << std::endl;
+
+	const char* names[] = { "naive", "greedy" };
+	for (int m = 0; m < 2; m++) {
+		MeshingMode mode = static_cast<MeshingMode>(m);
+		double remeshMs = 0.0, snapshotMs = 0.0;
+
+		for (int i = 0; i < edits; i++) {
+			int chunkX = chunkCoord(rng), chunkZ = chunkCoord(rng);
+			ChunkMeshData current;
+			world.generateTerrain(chunkX, surfaceBottom + i % 2, chunkZ, current.voxels);
+			VoxelChunk::buildMeshData(current.voxels, ChunkNeighbors(), current, mode);
+
+			// dig out the top block of a random column, the way a click would
+			int x = local(rng), z = local(rng);
+			int y = CHUNK_HEIGHT - 1;
+			while (y > 0 && !current.voxels.isSolid(x, y, z)) y--;
+			current.voxels.set(x, y, z, VoxelType::AIR);
+
+			// all the main thread does itself since remeshing moved to a job
+			auto start = Clock::now();
+			std::shared_ptr<ChunkStorage> snapshot = std::make_shared<ChunkStorage>(current.voxels);
+			snapshotMs += elapsedMs(start);
+
+			start = Clock::now();
+			ChunkMeshData remeshed;
+			VoxelChunk::buildMeshData(*snapshot, ChunkNeighbors(), remeshed, mode);
+			remeshMs += elapsedMs(start);
+		}
+
+		std::cout << "  " << std::left << std::setw(12) << names[m] << std::right
+			<< std::setw(12) << 1000.0 * remeshMs / edits
+			<< std::setw(11) << 1000.0 * snapshotMs / edits << std::endl;
+	}
+}
+
+void Benchmark::cubicChunks(World& world) {
+	const int renderDistance = 8;
+	const int heights[] = { 1, 3, 6, 12 };
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Cubic chunk benchmark (render distance " << renderDistance << ", player at y 50, naive meshing)" << std::endl;
+	std::cout << "  layers   world height   chunks   empty   buried   meshed   faces    KB voxels   mesh ms" << std::endl;
+
+	for (int height : heights) {
+		std::vector<glm::ivec3> coords = chunkCylinder(world.getChunkCoords(glm::vec3(0.0f, 50.0f, 0.0f)), renderDistance, height);
+
+		std::vector<ChunkStorage> voxels(coords.size());
+		std::unordered_map<long long, ChunkBorders> borders;
+		for (size_t i = 0; i < coords.size(); i++) {
+			world.generateTerrain(coords[i].x, coords[i].y, coords[i].z, voxels[i]);
+			borders[World::getChunkKey(coords[i].x, coords[i].y, coords[i].z)] = VoxelChunk::extractBorders(voxels[i]);
+		}
+
+		size_t empty = 0, buried = 0, meshed = 0, faces = 0, voxelBytes = 0;
+		double meshMs = 0.0;
+		for (size_t i = 0; i < coords.size(); i++) {
+			voxelBytes += voxels[i].memoryUsage();
+			ChunkNeighbors neighbors = neighborsOf(coords[i], borders);
+			neighbors.missingIsSolid = voxels[i].isFull();
+			if (voxels[i].isEmpty()) empty++;
+			else if (neighbors.buried()) buried++;
+			else meshed++;
+
+			ChunkMeshData meshData;
+			VoxelChunk::buildMeshData(voxels[i], neighbors, meshData, MeshingMode::NAIVE);
+			meshMs += meshData.meshingTimeMs;
+			faces += meshData.indexCount() / 6;
+		}
+
+		std::cout << "  " << std::setw(6) << 2 * height + 1 << std::setw(15) << (2 * height + 1) * CHUNK_HEIGHT
+			<< std::setw(9) << coords.size() << std::setw(8) << empty << std::setw(9) << buried << std::setw(9) << meshed
+			<< std::setw(8) << faces << std::setw(13) << voxelBytes / 1024.0 << std::setw(10) << meshMs << std::endl;
+	}
+}
+
+void Benchmark::regionFiles(World& world) {
+	const int side = RegionFile::REGION_SIZE;
+	const int layer = surfaceTop;
+	const std::string directory = "saves/bench_regions";
+
+	// One full region of surface chunks, each with a block dug out like a saved edit
+	std::vector<glm::ivec3> coords;
+	std::vector<ChunkStorage> voxels(side * side);
+	size_t memoryBytes = 0;
+	auto start = Clock::now();
+	for (int i = 0; i < side * side; i++) {
+		coords.push_back(glm::ivec3(i % side, layer, i / side));
+		world.generateTerrain(coords[i].x, coords[i].y, coords[i].z, voxels[i]);
+	}
+	double generateMs = elapsedMs(start);
+	for (int i = 0; i < side * side; i++) {
+		voxels[i].set(i % CHUNK_SIZE, 0, (i / CHUNK_SIZE) % CHUNK_SIZE, VoxelType::AIR);
+		memoryBytes += voxels[i].memoryUsage();
+	}
+
+	std::string path;
+	double writeMs;
+	{
+		RegionStore store(directory);
+		start = Clock::now();
+		for (int i = 0; i < side * side; i++) {
+			store.save(coords[i], voxels[i]);
+		}
+		if (!store.flush()) {
+			std::cout << "  Some chunks could not be written to " << directory << std::endl;
+		}
+		writeMs = elapsedMs(start);
+	}
+	path = directory + "/r.0." + std::to_string(layer) + ".0.vxr";
+
+	long fileBytes = 0;
+	if (FILE* file = std::fopen(path.c_str(), "rb")) {
+		std::fseek(file, 0, SEEK_END);
+		fileBytes = std::ftell(file);
+		std::fclose(file);
+	}
+
+	// Every chunk read back through a fresh store, so the mapping is made again as well
+	size_t mismatches = 0;
+	auto loadAll = [&](double& worstUs) {
+		RegionStore store(directory);
+		ChunkStorage loaded;
+		double totalMs = 0.0;
+		worstUs = 0.0;
+		for (int i = 0; i < side * side; i++) {
+			auto chunkStart = Clock::now();
+			bool found = store.load(coords[i], loaded);
+			double ms = elapsedMs(chunkStart);
+			totalMs += ms;
+			worstUs = std::max(worstUs, 1000.0 * ms);
+
+			std::vector<VoxelType> expected, actual;
+			voxels[i].unpack(expected);
+			loaded.unpack(actual);
+			if (!found || expected != actual) mismatches++;
+		}
+		return 1000.0 * totalMs / (side * side);
+	};
+
+	double warmWorst, coldWorst;
+	loadAll(warmWorst);
+	double warmUs = loadAll(warmWorst);
+	bool evicted = RegionFile::evictFromPageCache(path);
+	double coldUs = loadAll(coldWorst);
+
+	std::remove(path.c_str());
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Region file benchmark (" << side * side << " modified surface chunks, one region)" << std::endl;
+	std::cout << "  file bytes per chunk        " << static_cast<double>(fileBytes) / (side * side)
+		<< " (ChunkStorage in memory " << static_cast<double>(memoryBytes) / (side * side) << ")" << std::endl;
+	std::cout << "  write us per chunk          " << 1000.0 * writeMs / (side * side) << " (background writer)" << std::endl;
+	std::cout << "  generate us per chunk       " << 1000.0 * generateMs / (side * side) << std::endl;
+	std::cout << "  load us per chunk, warm     " << warmUs << " (worst " << warmWorst << ")" << std::endl;
+	std::cout << "  load us per chunk, cold     " << coldUs << " (worst " << coldWorst << ")"
+		<< (evicted ? "" : "  page cache could not be dropped") << std::endl;
+	std::cout << "  (mismatches " << mismatches << ")" << std::endl;
+}
+
+void Benchmark::editJournal(World& world) {
+	const int chunksX = 16;
+	const int chunksZ = 8;
+	const int noChunks = chunksX * chunksZ;
+	const int noEdits = 3000;
+	const int layer = surfaceTop;
+	const std::string directory = "saves/bench_journal";
+	const std::string journalPath = directory + "/edits.journal";
+
+	auto fileBytes = [](const std::string& path) {
+		long bytes = 0;
+		if (FILE* file = std::fopen(path.c_str(), "rb")) {
+			std::fseek(file, 0, SEEK_END);
+			bytes = std::ftell(file);
+			std::fclose(file);
+		}
+		return bytes;
+	};
+
+	std::vector<glm::ivec3> coords;
+	std::vector<ChunkStorage> voxels(noChunks);
+	for (int i = 0; i < noChunks; i++) {
+		coords.push_back(glm::ivec3(i % chunksX, layer, i / chunksX));
+		world.generateTerrain(coords[i].x, coords[i].y, coords[i].z, voxels[i]);
+	}
+
+	// Digging and building across the area; a third of the edits go back to a voxel
+	// edited before, like a block placed and then broken again
+	std::remove(journalPath.c_str());
+	std::mt19937 rng(7);
+	std::vector<std::pair<int, glm::ivec3>> edited;
+	double recordMs;
+	{
+		EditJournal journal(journalPath);
+		auto start = Clock::now();
+		for (int e = 0; e < noEdits; e++) {
+			std::pair<int, glm::ivec3> edit;
+			if (!edited.empty() && rng() % 3 == 0) {
+				edit = edited[rng() % edited.size()];
+			}
+			else {
+				edit = std::make_pair(static_cast<int>(rng() % noChunks),
+					glm::ivec3(rng() % CHUNK_SIZE, rng() % CHUNK_HEIGHT, rng() % CHUNK_SIZE));
+				edited.push_back(edit);
+			}
+			VoxelType type = rng() % 2 == 0 ? VoxelType::AIR : VoxelType::COBBLESTONE;
+			voxels[edit.first].set(edit.second.x, edit.second.y, edit.second.z, type);
+			journal.record(coords[edit.first], edit.second, type);
+		}
+		journal.flush();
+		recordMs = elapsedMs(start);
+	}
+	long journalBytes = fileBytes(journalPath);
+
+	double replayMs;
+	size_t deltas;
+	{
+		auto start = Clock::now();
+		EditJournal journal(journalPath);
+		replayMs = elapsedMs(start);
+		deltas = journal.getDeltaCount();
+		journal.compact();
+	}
+	long compactedBytes = fileBytes(journalPath);
+
+	// The same edited chunks saved whole, the way REGION_FILES mode does on unload
+	{
+		RegionStore store(directory);
+		for (int i = 0; i < noChunks; i++) {
+			store.save(coords[i], voxels[i]);
+		}
+	}
+	std::string regionPath = directory + "/r.0." + std::to_string(layer) + ".0.vxr";
+	long regionBytes = fileBytes(regionPath);
+
+	size_t mismatches = 0;
+	auto matches = [&](int i, const ChunkStorage& loaded) {
+		std::vector<VoxelType> expected, actual;
+		voxels[i].unpack(expected);
+		loaded.unpack(actual);
+		return expected == actual;
+	};
+
+	double journalLoadMs = 0.0;
+	{
+		EditJournal journal(journalPath);
+		for (int i = 0; i < noChunks; i++) {
+			ChunkStorage loaded;
+			auto start = Clock::now();
+			world.generateTerrain(coords[i].x, coords[i].y, coords[i].z, loaded);
+			journal.apply(coords[i], loaded);
+			journalLoadMs += elapsedMs(start);
+			if (!matches(i, loaded)) mismatches++;
+		}
+	}
+
+	double regionLoadMs = 0.0;
+	{
+		RegionStore store(directory);
+		for (int i = 0; i < noChunks; i++) {
+			ChunkStorage loaded;
+			auto start = Clock::now();
+			bool found = store.load(coords[i], loaded);
+			regionLoadMs += elapsedMs(start);
+			if (!found || !matches(i, loaded)) mismatches++;
+		}
+	}
+
+	std::remove(journalPath.c_str());
+	std::remove(regionPath.c_str());
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Edit journal benchmark (" << noEdits << " edits over " << noChunks << " surface chunks, "
+		<< deltas << " distinct voxels)" << std::endl;
+	std::cout << "                        bytes    bytes/chunk   load us/chunk" << std::endl;
+	std::cout << "  region files   " << std::setw(12) << regionBytes << std::setw(15) << static_cast<double>(regionBytes) / noChunks
+		<< std::setw(16) << 1000.0 * regionLoadMs / noChunks << std::endl;
+	std::cout << "  journal        " << std::setw(12) << journalBytes << std::setw(15) << static_cast<double>(journalBytes) / noChunks
+		<< std::setw(16) << 1000.0 * journalLoadMs / noChunks << "  (generate + apply)" << std::endl;
+	std::cout << "  compacted      " << std::setw(12) << compactedBytes << std::setw(15) << static_cast<double>(compactedBytes) / noChunks
+		<< std::endl;
+	std::cout << "  record us per edit " << 1000.0 * recordMs / noEdits << ", replay ms " << replayMs << std::endl;
+	std::cout << "  (mismatches " << mismatches << ")" << std::endl;
+}
+
+void Benchmark::noiseGrid(World& world) {
+	const int chunksPerSide = 16;
+	const int samplesPerChunk = CHUNK_SIZE * CHUNK_SIZE;
+	const int noSamples = chunksPerSide * chunksPerSide * samplesPerChunk;
+	const double spacing = 0.01;
+	PerlinNoise noise(12345);
+
+	// Chunk grids the way generateTerrain asks for them, across negative coordinates too
+	std::vector<double> scalar(noSamples), batched(noSamples);
+	auto start = Clock::now();
+	for (int c = 0; c < chunksPerSide * chunksPerSide; c++) {
+		int x0 = (c % chunksPerSide - chunksPerSide / 2) * CHUNK_SIZE;
+		int z0 = (c / chunksPerSide - chunksPerSide / 2) * CHUNK_SIZE;
+		for (int z = 0; z < CHUNK_SIZE; z++) {
+			for (int x = 0; x < CHUNK_SIZE; x++) {
+				scalar[c * samplesPerChunk + z * CHUNK_SIZE + x] =
+					noise.fractalNoise(static_cast<float>(x0 + x) * spacing, static_cast<float>(z0 + z) * spacing, 4, 0.5, 1.0);
+			}
+		}
+	}
+	double scalarMs = elapsedMs(start);
+
+	start = Clock::now();
+	for (int c = 0; c < chunksPerSide * chunksPerSide; c++) {
+		int x0 = (c % chunksPerSide - chunksPerSide / 2) * CHUNK_SIZE;
+		int z0 = (c / chunksPerSide - chunksPerSide / 2) * CHUNK_SIZE;
+		noise.fractalNoiseGrid(&batched[c * samplesPerChunk], CHUNK_SIZE, CHUNK_SIZE, x0, z0, spacing, 4, 0.5, 1.0);
+	}
+	double batchedMs = elapsedMs(start);
+
+	size_t mismatches = 0;
+	double maxDifference = 0.0;
+	for (int i = 0; i < noSamples; i++) {
+		if (std::memcmp(&scalar[i], &batched[i], sizeof(double)) != 0) mismatches++;
+		maxDifference = std::max(maxDifference, std::abs(scalar[i] - batched[i]));
+	}
+
+	// A width that doesn't divide into lanes, so the scalar tail is checked as well
+	const int oddWidth = 13, oddHeight = 7;
+	double odd[oddWidth * oddHeight];
+	noise.fractalNoiseGrid(odd, oddWidth, oddHeight, -40.0, 25.0, spacing, 6, 0.45, 2.0);
+	for (int row = 0; row < oddHeight; row++) {
+		for (int col = 0; col < oddWidth; col++) {
+			double expected = noise.fractalNoise((-40.0 + col) * spacing, (25.0 + row) * spacing, 6, 0.45, 2.0);
+			if (std::memcmp(&expected, &odd[row * oddWidth + col], sizeof(double)) != 0) mismatches++;
+		}
+	}
+
+	ChunkStorage voxels;
+	start = Clock::now();
+	for (int c = 0; c < chunksPerSide * chunksPerSide; c++) {
+		voxels = ChunkStorage();
+		world.generateTerrain(c % chunksPerSide, surfaceBottom, c / chunksPerSide, voxels);
+	}
+	double generateMs = elapsedMs(start);
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Noise grid benchmark (" << noSamples << " samples, 4 octaves, " << PerlinNoise::gridInstructionSet()
+		<< " " << PerlinNoise::gridLanes() << " doubles per op)" << std::endl;
+	std::cout << "  fractalNoise per column     " << noSamples / (scalarMs * 1000.0) << " M samples/s" << std::endl;
+	std::cout << "  fractalNoiseGrid            " << noSamples / (batchedMs * 1000.0) << " M samples/s ("
+		<< scalarMs / batchedMs << "x)" << std::endl;
+	std::cout << "  generateTerrain us per chunk " << 1000.0 * generateMs / (chunksPerSide * chunksPerSide) << std::endl;
+	std::cout << "  (mismatches " << mismatches << ", max difference " << std::scientific << std::setprecision(2) << maxDifference << ")" << std::endl;
+}
+
+void Benchmark::heightmapCache(World& world) {
+	const int chunksPerSide = 8;
+	const int layers = 4;
+	const int noQueries = 200000;
+	const int noEdits = 5000;
+
+	// Every layer the terrain can reach, for a square of columns
+	std::unordered_map<long long, ChunkStorage> voxels;
+	std::unordered_map<long long, ChunkHeightmap> heightmaps;
+	double buildMs = 0.0;
+	for (int x = 0; x < chunksPerSide; x++) {
+		for (int z = 0; z < chunksPerSide; z++) {
+			for (int y = 0; y < layers; y++) {
+				long long key = World::getChunkKey(x, y, z);
+				world.generateTerrain(x, y, z, voxels[key]);
+				auto start = Clock::now();
+				heightmaps[key].build(voxels[key]);
+				buildMs += elapsedMs(start);
+			}
+		}
+	}
+
+	// Walks the layers top down like World::getColumnTop does for loaded chunks
+	auto cachedTop = [&](int worldX, int worldZ) {
+		int chunkX = worldX / CHUNK_SIZE, chunkZ = worldZ / CHUNK_SIZE;
+		for (int y = layers - 1; y >= 0; y--) {
+			int8_t top = heightmaps[World::getChunkKey(chunkX, y, chunkZ)].get(worldX % CHUNK_SIZE, worldZ % CHUNK_SIZE);
+			if (top != ChunkHeightmap::EMPTY) return y * CHUNK_HEIGHT + top;
+		}
+		return -1;
+	};
+
+	std::mt19937 rng(99);
+	std::uniform_int_distribution<int> column(0, chunksPerSide * CHUNK_SIZE - 1);
+	std::vector<glm::ivec2> queries(noQueries);
+	for (glm::ivec2& query : queries) {
+		query = glm::ivec2(column(rng), column(rng));
+	}
+
+	// summed so neither loop can be optimized away
+	long long checksum = 0;
+	auto start = Clock::now();
+	for (const glm::ivec2& query : queries) {
+		checksum += static_cast<long long>(world.getGeneratedHeight(static_cast<float>(query.x), static_cast<float>(query.y)));
+	}
+	double noiseMs = elapsedMs(start);
+
+	start = Clock::now();
+	for (const glm::ivec2& query : queries) {
+		checksum += cachedTop(query.x, query.y);
+	}
+	double cachedMs = elapsedMs(start);
+
+	size_t mismatches = 0;
+	for (const glm::ivec2& query : queries) {
+		if (static_cast<int>(world.getGeneratedHeight(static_cast<float>(query.x), static_cast<float>(query.y))) != cachedTop(query.x, query.y)) {
+			mismatches++;
+		}
+	}
+
+	// Dig and build at random, then check the updated heightmaps against rebuilt ones
+	std::uniform_int_distribution<int> height(0, layers * CHUNK_HEIGHT - 1);
+	double updateMs = 0.0;
+	for (int e = 0; e < noEdits; e++) {
+		int x = column(rng), y = height(rng), z = column(rng);
+		long long key = World::getChunkKey(x / CHUNK_SIZE, y / CHUNK_HEIGHT, z / CHUNK_SIZE);
+		ChunkStorage& chunk = voxels[key];
+		chunk.set(x % CHUNK_SIZE, y % CHUNK_HEIGHT, z % CHUNK_SIZE, e % 2 == 0 ? VoxelType::AIR : VoxelType::DIRT);
+		start = Clock::now();
+		heightmaps[key].update(chunk, x % CHUNK_SIZE, y % CHUNK_HEIGHT, z % CHUNK_SIZE);
+		updateMs += elapsedMs(start);
+	}
+	for (const auto& entry : voxels) {
+		ChunkHeightmap rebuilt;
+		rebuilt.build(entry.second);
+		const ChunkHeightmap& kept = heightmaps[entry.first];
+		if (rebuilt.top != kept.top || rebuilt.maxTop != kept.maxTop) mismatches++;
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "Heightmap benchmark (" << noQueries << " column queries over " << chunksPerSide << "x" << chunksPerSide
+		<< " columns of " << layers << " chunks)" << std::endl;
+	std::cout << "  us per query, noise         " << 1000.0 * noiseMs / noQueries << std::endl;
+	std::cout << "  us per query, heightmaps    " << 1000.0 * cachedMs / noQueries << " (" << std::setprecision(1)
+		<< noiseMs / cachedMs << "x)" << std::endl;
+	std::cout << std::setprecision(3);
+	std::cout << "  us per chunk to build       " << 1000.0 * buildMs / voxels.size() << std::endl;
+	std::cout << "  us per edit to update       " << 1000.0 * updateMs / noEdits << std::endl;
+	std::cout << "  heightmap bytes per chunk   " << sizeof(ChunkHeightmap) << std::endl;
+	std::cout << "  (mismatches " << mismatches << ", checksum " << checksum << ")" << std::endl;
+}
+
+void Benchmark::densityTerrain(World& world) {
+	const int chunksPerSide = 8;
+	const int lowestLayer = -1;
+	const int highestLayer = 5;
+	const int perVoxelChunks = 16;
+
+	std::vector<glm::ivec3> coords;
+	for (int x = 0; x < chunksPerSide; x++) {
+		for (int z = 0; z < chunksPerSide; z++) {
+			for (int y = lowestLayer; y <= highestLayer; y++) {
+				coords.push_back(glm::ivec3(x, y, z));
+			}
+		}
+	}
+
+	// Air with solid ground above it in the same chunk: cave ceilings and overhangs
+	auto countOverhangs = [](const ChunkStorage& voxels) {
+		size_t count = 0;
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			for (int z = 0; z < CHUNK_SIZE; z++) {
+				bool roofed = false;
+				for (int y = CHUNK_HEIGHT - 1; y >= 0; y--) {
+					bool solid = voxels.isSolid(x, y, z);
+					if (!solid && roofed) count++;
+					roofed = roofed || solid;
+				}
+			}
+		}
+		return count;
+	};
+
+	struct Result { double ms = 0.0; size_t overhangs = 0; };
+	Result heightmap, density;
+	std::vector<ChunkStorage> densityChunks(coords.size());
+	for (size_t i = 0; i < coords.size(); i++) {
+		ChunkStorage voxels;
+		auto start = Clock::now();
+		world.generateHeightmapTerrain(coords[i].x, coords[i].y, coords[i].z, voxels);
+		heightmap.ms += elapsedMs(start);
+		heightmap.overhangs += countOverhangs(voxels);
+
+		start = Clock::now();
+		world.generateDensityTerrain(coords[i].x, coords[i].y, coords[i].z, densityChunks[i]);
+		density.ms += elapsedMs(start);
+		density.overhangs += countOverhangs(densityChunks[i]);
+	}
+
+	// The same density evaluated at every voxel of a few surface chunks, and how often
+	// the lattice disagrees with it about a voxel being solid
+	double perVoxelMs = 0.0;
+	size_t disagreements = 0, compared = 0;
+	for (size_t i = 0, done = 0; i < coords.size() && done < perVoxelChunks; i++) {
+		if (coords[i].y != surfaceTop) continue;
+		glm::ivec3 origin = coords[i] * CHUNK_SIZE;
+		for (int y = 0; y < CHUNK_HEIGHT; y++) {
+			for (int z = 0; z < CHUNK_SIZE; z++) {
+				for (int x = 0; x < CHUNK_SIZE; x++) {
+					auto start = Clock::now();
+					bool solid = world.sampleDensity(origin.x + x, origin.y + y, origin.z + z) > 0.0;
+					perVoxelMs += elapsedMs(start);
+					if (solid != densityChunks[i].isSolid(x, y, z)) disagreements++;
+					compared++;
+				}
+			}
+		}
+		done++;
+	}
+
+	const int latticeSamples = (CHUNK_SIZE / 4 + 1) * (CHUNK_SIZE / 4 + 1) * 4;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Density terrain benchmark (" << coords.size() << " chunks, layers " << lowestLayer << " to " << highestLayer << ")" << std::endl;
+	std::cout << "                          us/chunk   noise samples/chunk   overhang voxels" << std::endl;
+	std::cout << "  2D heightmap        " << std::setw(12) << 1000.0 * heightmap.ms / coords.size()
+		<< std::setw(22) << CHUNK_SIZE * CHUNK_SIZE << std::setw(18) << heightmap.overhangs << std::endl;
+	std::cout << "  3D density lattice  " << std::setw(12) << 1000.0 * density.ms / coords.size()
+		<< std::setw(22) << latticeSamples << std::setw(18) << density.overhangs << std::endl;
+	std::cout << "  3D density per voxel" << std::setw(12) << 1000.0 * perVoxelMs / (compared / ChunkStorage::VOLUME)
+		<< std::setw(22) << ChunkStorage::VOLUME << "   (density only, " << compared / ChunkStorage::VOLUME << " chunks)" << std::endl;
+	std::cout << "  (lattice disagrees with per voxel density on " << 100.0 * disagreements / std::max<size_t>(compared, 1)
+		<< "% of voxels)" << std::endl;
+}
+
+void Benchmark::biomeMap(World& world) {
+	const int chunksPerSide = 16;
+	const int coverageBlocks = 4096;
+	const int coverageStep = 8;
+	BiomeMap& biomes = world.getBiomeMap();
+
+	std::vector<glm::ivec3> coords;
+	for (int x = 0; x < chunksPerSide; x++) {
+		for (int z = 0; z < chunksPerSide; z++) {
+			for (int y = surfaceBottom - 1; y <= surfaceTop; y++) {
+				coords.push_back(glm::ivec3(x, y, z));
+			}
+		}
+	}
+
+	// The same chunks twice: once with regions cached and shared, once rebuilding the region every chunk
+	struct Result { double ms = 0.0; size_t lookups = 0; size_t built = 0; };
+	auto generateAll = [&](bool shared) {
+		Result result;
+		biomes.clear();
+		size_t lookupsBefore = biomes.getLookups();
+		size_t builtBefore = biomes.getRegionsBuilt();
+		for (const glm::ivec3& c : coords) {
+			if (!shared) biomes.clear();
+			ChunkStorage voxels;
+			auto start = Clock::now();
+			world.generateHeightmapTerrain(c.x, c.y, c.z, voxels);
+			result.ms += elapsedMs(start);
+		}
+		result.lookups = biomes.getLookups() - lookupsBefore;
+		result.built = biomes.getRegionsBuilt() - builtBefore;
+		return result;
+	};
+	Result cached = generateAll(true);
+	Result rebuilt = generateAll(false);
+
+	// Share of each biome over a large area, and the steepest step between neighbouring
+	// columns where the biome changes, which blending keeps down to ordinary slopes
+	size_t counts[BIOME_COUNT] = {};
+	size_t samples = 0;
+	for (int z = 0; z < coverageBlocks; z += coverageStep) {
+		for (int x = 0; x < coverageBlocks; x += coverageStep) {
+			counts[static_cast<int>(world.getBiomeAt(x, z))]++;
+			samples++;
+		}
+	}
+	int borderStep = 0, sameStep = 0;
+	const int stepBlocks = chunksPerSide * CHUNK_SIZE;
+	for (int z = 0; z < stepBlocks; z++) {
+		for (int x = 0; x + 1 < stepBlocks; x++) {
+			int step = std::abs(static_cast<int>(world.getGeneratedHeight(static_cast<float>(x + 1), static_cast<float>(z))) -
+				static_cast<int>(world.getGeneratedHeight(static_cast<float>(x), static_cast<float>(z))));
+			if (world.getBiomeAt(x, z) != world.getBiomeAt(x + 1, z)) borderStep = std::max(borderStep, step);
+			else sameStep = std::max(sameStep, step);
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Biome map benchmark (" << coords.size() << " heightmap chunks, regions of "
+		<< BiomeMap::REGION_SIZE << "x" << BiomeMap::REGION_SIZE << " chunk columns)" << std::endl;
+	std::cout << "                       us/chunk   regions built   cache hit rate" << std::endl;
+	std::cout << "  shared regions   " << std::setw(12) << 1000.0 * cached.ms / coords.size() << std::setw(16) << cached.built
+		<< std::setw(16) << 100.0 * (cached.lookups - cached.built) / std::max<size_t>(cached.lookups, 1) << "%" << std::endl;
+	std::cout << "  region per chunk " << std::setw(12) << 1000.0 * rebuilt.ms / coords.size() << std::setw(16) << rebuilt.built
+		<< std::setw(16) << 100.0 * (rebuilt.lookups - rebuilt.built) / std::max<size_t>(rebuilt.lookups, 1) << "%" << std::endl;
+	std::cout << "  (" << std::setprecision(3) << biomes.getAverageBuildMs() << " ms per region build)" << std::endl;
+	std::cout << std::setprecision(1);
+	std::cout << "  Coverage over " << coverageBlocks << "x" << coverageBlocks << " blocks:";
+	for (int b = 0; b < BIOME_COUNT; b++) {
+		std::cout << " " << BiomeMap::info(static_cast<Biome>(b)).name << " " << 100.0 * counts[b] / samples << "%";
+	}
+	std::cout << std::endl;
+	std::cout << "  Steepest neighbour step: " << borderStep << " blocks across biome borders, "
+		<< sameStep << " inside a biome" << std::endl;
+}
+
+void Benchmark::noiseGraph(World& world) {
+	const int chunksPerSide = 16;
+	const char* layered =
+		"continents = fractal scale=0.002 octaves=3 seed=11\n"
+		"land = curve continents -1:-0.6 -0.2:-0.2 0.2:0.1 1:0.3\n"
+		"hills = fractal scale=0.01 octaves=4 persistence=0.5\n"
+		"gentle = mul hills 0.5\n"
+		"rolling = add land gentle\n"
+		"ridges = fractal scale=0.006 octaves=3 seed=12\n"
+		"folded = abs ridges\n"
+		"peaks = sub 0.9 folded\n"
+		"steep = mul peaks 1.2\n"
+		"capped = clamp steep -0.5 0.8\n"
+		"mountains = add land capped\n"
+		"unused = fractal scale=0.05 octaves=6 seed=13\n"
+		"surface = select continents rolling mountains threshold=0.25 falloff=0.1\n"
+		"output surface\n";
+
+	struct Case { const char* name; NoiseGraph* graph; };
+	NoiseGraph layeredGraph(world.getSeed());
+	layeredGraph.parse(layered, "layered graph");
+	Case cases[] = {
+		{ "terrain.graph", &world.getTerrainGraph() },
+		{ "layered", &layeredGraph },
+	};
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Noise graph benchmark (" << chunksPerSide * chunksPerSide << " chunk columns of "
+		<< CHUNK_SIZE << "x" << CHUNK_SIZE << ")" << std::endl;
+	std::cout << "                  nodes  steps  buffers   interpreted us/chunk   compiled us/chunk   speedup   max difference" << std::endl;
+	for (const Case& c : cases) {
+		double interpretedMs = 0.0, compiledMs = 0.0, maxDifference = 0.0;
+		double grid[CHUNK_SIZE * CHUNK_SIZE];
+		for (int cx = 0; cx < chunksPerSide; cx++) {
+			for (int cz = 0; cz < chunksPerSide; cz++) {
+				auto start = Clock::now();
+				c.graph->evaluateGrid(grid, CHUNK_SIZE, CHUNK_SIZE, cx * CHUNK_SIZE, cz * CHUNK_SIZE);
+				compiledMs += elapsedMs(start);
+
+				start = Clock::now();
+				for (int z = 0; z < CHUNK_SIZE; z++) {
+					for (int x = 0; x < CHUNK_SIZE; x++) {
+						double value = c.graph->interpret(cx * CHUNK_SIZE + x, cz * CHUNK_SIZE + z);
+						maxDifference = std::max(maxDifference, std::abs(value - grid[z * CHUNK_SIZE + x]));
+					}
+				}
+				interpretedMs += elapsedMs(start);
+			}
+		}
+		int chunks = chunksPerSide * chunksPerSide;
+		std::cout << "  " << std::left << std::setw(16) << c.name << std::right
+			<< std::setw(5) << c.graph->getNodeCount() << std::setw(7) << c.graph->getStepCount()
+			<< std::setw(9) << c.graph->getRegisterCount()
+			<< std::setw(23) << 1000.0 * interpretedMs / chunks << std::setw(20) << 1000.0 * compiledMs / chunks
+			<< std::setw(9) << interpretedMs / std::max(compiledMs, 1e-9) << "x"
+			<< std::setw(16) << std::scientific << std::setprecision(1) << maxDifference << std::fixed << std::endl;
+	}
+}
+
+void Benchmark::featurePlacement(World& world) {
+	const int chunksPerSide = 8;
+	PendingWrites& pending = world.getPendingWrites();
+
+	glm::ivec2 origin = mostForestedRegion(world);
+
+	std::vector<glm::ivec3> coords;
+	for (int x = origin.x; x < origin.x + chunksPerSide; x++) {
+		for (int z = origin.y; z < origin.y + chunksPerSide; z++) {
+			for (int y = surfaceBottom - 1; y <= surfaceTop + 1; y++) {
+				coords.push_back(glm::ivec3(x, y, z));
+			}
+		}
+	}
+
+	// Builds every chunk in the given order, then merges the writes that arrived after
+	// their target was built, the way World::update would
+	struct Build {
+		std::unordered_map<long long, ChunkStorage> chunks;
+		double ms = 0.0;
+		size_t late = 0;
+	};
+	auto buildAll = [&](const std::vector<glm::ivec3>& order, bool parallel) {
+		Build build;
+		pending.clear();
+		for (const glm::ivec3& c : order) {
+			build.chunks[World::getChunkKey(c.x, c.y, c.z)];
+		}
+		auto start = Clock::now();
+		if (parallel) {
+			std::atomic<int> remaining(static_cast<int>(order.size()));
+			for (const glm::ivec3& c : order) {
+				ChunkStorage* voxels = &build.chunks[World::getChunkKey(c.x, c.y, c.z)];
+				JobSystem::get().submit([&world, &remaining, c, voxels] {
+					world.generateTerrain(c.x, c.y, c.z, *voxels);
+					world.decorateChunk(c, *voxels);
+					world.applyFeatureWrites(c, *voxels);
+					remaining--;
+				});
+			}
+			JobSystem::get().waitUntil([&remaining] { return remaining == 0; });
+		}
+		else {
+			for (const glm::ivec3& c : order) {
+				ChunkStorage& voxels = build.chunks[World::getChunkKey(c.x, c.y, c.z)];
+				world.generateTerrain(c.x, c.y, c.z, voxels);
+				world.decorateChunk(c, voxels);
+				world.applyFeatureWrites(c, voxels);
+			}
+		}
+		build.ms = elapsedMs(start);
+
+		std::vector<PendingWrites::Batch> late;
+		pending.takeLate(late);
+		build.late = late.size();
+		for (const PendingWrites::Batch& batch : late) {
+			auto it = build.chunks.find(batch.target);
+			if (it != build.chunks.end()) {
+				PendingWrites::apply(batch.writes, it->second);
+			}
+		}
+		return build;
+	};
+	auto differingVoxels = [&](const Build& a, const Build& b) {
+		size_t differing = 0;
+		for (const auto& chunk : a.chunks) {
+			const ChunkStorage& other = b.chunks.at(chunk.first);
+			for (int y = 0; y < CHUNK_HEIGHT; y++) {
+				for (int z = 0; z < CHUNK_SIZE; z++) {
+					for (int x = 0; x < CHUNK_SIZE; x++) {
+						if (chunk.second.get(x, y, z) != other.get(x, y, z)) differing++;
+					}
+				}
+			}
+		}
+		return differing;
+	};
+
+	double terrainMs = 0.0;
+	for (const glm::ivec3& c : coords) {
+		ChunkStorage voxels;
+		auto start = Clock::now();
+		world.generateTerrain(c.x, c.y, c.z, voxels);
+		terrainMs += elapsedMs(start);
+	}
+
+	size_t featuresBefore = world.getFeaturesPlaced();
+	Build ordered = buildAll(coords, false);
+	size_t features = world.getFeaturesPlaced() - featuresBefore;
+	size_t pushedWrites = pending.getPushedWrites();
+	size_t targets = pending.getTargetCount();
+
+	std::vector<glm::ivec3> reversed(coords.rbegin(), coords.rend());
+	Build backwards = buildAll(reversed, false);
+	std::vector<glm::ivec3> shuffled = coords;
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(7));
+	Build threaded = buildAll(shuffled, true);
+
+	size_t logs = 0, leaves = 0;
+	for (const auto& chunk : ordered.chunks) {
+		for (int y = 0; y < CHUNK_HEIGHT; y++) {
+			for (int z = 0; z < CHUNK_SIZE; z++) {
+				for (int x = 0; x < CHUNK_SIZE; x++) {
+					VoxelType type = chunk.second.get(x, y, z);
+					if (type == VoxelType::LOG) logs++;
+					if (type == VoxelType::LEAVES) leaves++;
+				}
+			}
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Feature placement benchmark (" << coords.size() << " chunks from chunk " << origin.x << ", " << origin.y
+		<< ", " << JobSystem::get().getWorkerCount() << " job workers)" << std::endl;
+	std::cout << "  Terrain only:          " << std::setw(8) << 1000.0 * terrainMs / coords.size() << " us/chunk" << std::endl;
+	std::cout << "  Terrain and features:  " << std::setw(8) << 1000.0 * ordered.ms / coords.size() << " us/chunk" << std::endl;
+	std::cout << "  " << features << " features, " << logs << " log and " << leaves << " leaf voxels, "
+		<< pushedWrites << " writes queued into " << targets << " other chunks" << std::endl;
+	std::cout << "                        wall ms   late batches   voxels differing from in order" << std::endl;
+	std::cout << "  in order          " << std::setw(12) << ordered.ms << std::setw(15) << ordered.late << std::setw(18) << 0 << std::endl;
+	std::cout << "  reversed          " << std::setw(12) << backwards.ms << std::setw(15) << backwards.late
+		<< std::setw(18) << differingVoxels(ordered, backwards) << std::endl;
+	std::cout << "  shuffled, threads " << std::setw(12) << threaded.ms << std::setw(15) << threaded.late
+		<< std::setw(18) << differingVoxels(ordered, threaded) << std::endl;
+}
+
+void Benchmark::chunkPipeline(World& world) {
+	const int radius = 5;
+	PendingWrites& pending = world.getPendingWrites();
+	JobSystem& jobs = JobSystem::get();
+
+	glm::ivec2 region = mostForestedRegion(world);
+	glm::ivec3 center(region.x + BiomeMap::REGION_SIZE / 2, surfaceBottom, region.y + BiomeMap::REGION_SIZE / 2);
+	std::vector<glm::ivec3> coords = chunkCylinder(center, radius, 1);
+	// nearest first, roughly the order ChunkLoadQueue hands them out
+	std::stable_sort(coords.begin(), coords.end(), [center](const glm::ivec3& a, const glm::ivec3& b) {
+		glm::ivec3 da = a - center, db = b - center;
+		return da.x * da.x + da.z * da.z < db.x * db.x + db.z * db.z;
+	});
+
+	struct Result {
+		double ms = 0.0;
+		// Chunks a feature write reached after they were meshed, each needing a merge and a remesh
+		size_t lateBatches = 0;
+		// Chunks meshed before a face neighbour's borders were out, each needing a recull
+		size_t reculls = 0;
+	};
+
+	std::mutex bordersMutex;
+	std::unordered_map<long long, ChunkBorders> borders;
+	std::unordered_map<long long, uint8_t> masks;
+	auto publish = [&](long long key, const ChunkStorage& voxels) {
+		ChunkBorders extracted = VoxelChunk::extractBorders(voxels);
+		std::lock_guard<std::mutex> lock(bordersMutex);
+		borders[key] = extracted;
+	};
+	auto mesh = [&](ChunkJob& job) {
+		ChunkNeighbors neighbors;
+		{
+			std::lock_guard<std::mutex> lock(bordersMutex);
+			neighbors = neighborsOf(job.coords, borders);
+		}
+		neighbors.missingIsSolid = job.meshData.voxels.isFull();
+		VoxelChunk::buildMeshData(job.meshData.voxels, neighbors, job.meshData, MeshingMode::NAIVE);
+		std::lock_guard<std::mutex> lock(bordersMutex);
+		masks[job.meshData.chunkKey] = job.meshData.neighborMask;
+	};
+	auto reset = [&] {
+		pending.clear();
+		borders.clear();
+		masks.clear();
+	};
+	auto finish = [&](Result& result, Clock::time_point start) {
+		result.ms = elapsedMs(start);
+		std::vector<PendingWrites::Batch> late;
+		pending.takeLate(late);
+		result.lateBatches = late.size();
+
+		const Face sides[] = { Face::FRONT, Face::BACK, Face::LEFT, Face::RIGHT, Face::TOP, Face::BOTTOM };
+		const glm::ivec3 offsets[] = { {0, 0, 1}, {0, 0, -1}, {-1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, -1, 0} };
+		for (const auto& chunk : masks) {
+			glm::ivec3 c = World::getChunkCoords(chunk.first);
+			for (int s = 0; s < 6; s++) {
+				glm::ivec3 next = c + offsets[s];
+				if (masks.count(World::getChunkKey(next.x, next.y, next.z)) && !(chunk.second & (1 << static_cast<int>(sides[s])))) {
+					result.reculls++;
+					break;
+				}
+			}
+		}
+	};
+
+	// Every chunk built start to finish by one job, like the generation and meshing jobs before stages
+	reset();
+	Result onePass;
+	{
+		std::atomic<int> remaining(static_cast<int>(coords.size()));
+		auto start = Clock::now();
+		for (const glm::ivec3& c : coords) {
+			jobs.submit([&, c] {
+				ChunkJob job;
+				job.coords = c;
+				job.meshData.chunkKey = World::getChunkKey(c.x, c.y, c.z);
+				world.generateTerrain(c.x, c.y, c.z, job.meshData.voxels);
+				world.decorateChunk(c, job.meshData.voxels);
+				world.applyFeatureWrites(c, job.meshData.voxels);
+				job.meshData.heightmap.build(job.meshData.voxels);
+				publish(job.meshData.chunkKey, job.meshData.voxels);
+				mesh(job);
+				remaining--;
+			});
+		}
+		jobs.waitUntil([&remaining] { return remaining == 0; });
+		finish(onePass, start);
+	}
+
+	// The stages World::runStage runs, scheduled by a ChunkPipeline. Nothing is drawn
+	// here, so UPLOAD completes as soon as it starts.
+	reset();
+	Result staged;
+	ChunkPipeline pipeline;
+	{
+		std::atomic<int> remaining(static_cast<int>(coords.size()));
+		std::function<void(ChunkStage, std::shared_ptr<ChunkJob>)> runStage;
+		auto submit = [&](const std::vector<ChunkPipeline::Ready>& ready) {
+			for (const ChunkPipeline::Ready& next : ready) {
+				jobs.submit([&runStage, next] { runStage(next.stage, next.job); });
+			}
+		};
+		runStage = [&](ChunkStage stage, std::shared_ptr<ChunkJob> job) {
+			glm::ivec3 c = job->coords;
+			ChunkMeshData& meshData = job->meshData;
+			auto start = Clock::now();
+			switch (stage) {
+			case ChunkStage::TERRAIN:
+				world.generateTerrain(c.x, c.y, c.z, meshData.voxels);
+				break;
+			case ChunkStage::FEATURES:
+				world.decorateChunk(c, meshData.voxels);
+				break;
+			case ChunkStage::LIGHT:
+				world.applyFeatureWrites(c, meshData.voxels);
+				meshData.heightmap.build(meshData.voxels);
+				publish(meshData.chunkKey, meshData.voxels);
+				break;
+			case ChunkStage::MESH:
+				mesh(*job);
+				break;
+			default:
+				break;
+			}
+			std::vector<ChunkPipeline::Ready> ready;
+			pipeline.complete(meshData.chunkKey, stage, elapsedMs(start), ready);
+			if (stage == ChunkStage::MESH) {
+				pipeline.start(meshData.chunkKey, ChunkStage::UPLOAD);
+				pipeline.complete(meshData.chunkKey, ChunkStage::UPLOAD, 0.0, ready);
+				remaining--;
+			}
+			submit(ready);
+		};
+
+		auto start = Clock::now();
+		std::vector<std::shared_ptr<ChunkJob>> queued;
+		for (const glm::ivec3& c : coords) {
+			std::shared_ptr<ChunkJob> job = std::make_shared<ChunkJob>();
+			job->coords = c;
+			job->meshData.chunkKey = World::getChunkKey(c.x, c.y, c.z);
+			pipeline.add(job->meshData.chunkKey, job);
+			queued.push_back(job);
+		}
+		for (const std::shared_ptr<ChunkJob>& job : queued) {
+			jobs.submit([&, job] {
+				if (pipeline.start(job->meshData.chunkKey, ChunkStage::TERRAIN)) {
+					runStage(ChunkStage::TERRAIN, job);
+				}
+			});
+		}
+		jobs.waitUntil([&remaining] { return remaining == 0; });
+		finish(staged, start);
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Chunk pipeline benchmark (" << coords.size() << " chunks around chunk " << center.x << ", " << center.z
+		<< ", " << jobs.getWorkerCount() << " job workers)" << std::endl;
+	std::cout << "                 wall ms   late feature merges   seam reculls" << std::endl;
+	std::cout << "  one pass  " << std::setw(10) << onePass.ms << std::setw(22) << onePass.lateBatches << std::setw(15) << onePass.reculls << std::endl;
+	std::cout << "  staged    " << std::setw(10) << staged.ms << std::setw(22) << staged.lateBatches << std::setw(15) << staged.reculls << std::endl;
+	std::cout << "  stage          avg ms   peak waiting" << std::endl;
+	for (int s = static_cast<int>(ChunkStage::TERRAIN); s < static_cast<int>(ChunkStage::UPLOAD); s++) {
+		ChunkStageStats stats = pipeline.getStats(static_cast<ChunkStage>(s));
+		std::cout << "  " << std::left << std::setw(10) << ChunkPipeline::stageName(static_cast<ChunkStage>(s)) << std::right
+			<< std::setw(10) << std::setprecision(3) << stats.averageMs << std::setw(15) << stats.peakWaiting << std::setprecision(1) << std::endl;
+	}
+	std::cout << "  " << pipeline.getAverageLatencyMs() << " ms on average from queued to meshed" << std::endl;
+}
+
+void Benchmark::voxelLighting(World& world) {
+	const int radius = 3;
+	const int editsPerKind = 40;
+	// Density terrain, for caves and overhangs the light has to find its way into. The
+	// top layer is taken for open sky, like World does past the highest terrain.
+	glm::ivec3 center(0, 2, 0);
+	std::vector<glm::ivec3> coords = chunkCylinder(center, radius, 2);
+	int topLayer = center.y + 2;
+	VoxelLight::OpenSkyTest openSky = [topLayer](int chunkY) { return chunkY >= topLayer; };
+	// top down, so each chunk is lit after the one above it like in the pipeline
+	std::stable_sort(coords.begin(), coords.end(), [](const glm::ivec3& a, const glm::ivec3& b) { return a.y > b.y; });
+
+	std::unordered_map<long long, ChunkStorage> terrain;
+	for (const glm::ivec3& c : coords) {
+		world.generateDensityTerrain(c.x, c.y, c.z, terrain[World::getChunkKey(c.x, c.y, c.z)]);
+	}
+
+	auto makeChunks = [&](VoxelLight::ChunkMap& chunks, std::function<const ChunkStorage&(long long)> voxelsOf) {
+		for (const glm::ivec3& c : coords) {
+			long long key = World::getChunkKey(c.x, c.y, c.z);
+			std::unique_ptr<VoxelChunk> chunk = std::make_unique<VoxelChunk>(glm::vec3(c * CHUNK_SIZE), world.getSeed());
+			chunk->voxels = voxelsOf(key);
+			chunks[key] = std::move(chunk);
+		}
+	};
+
+	// Every chunk lit on its own as it would be built, then the seams between them settled
+	struct Lighting {
+		double chunkMs = 0.0;
+		double settleMs = 0.0;
+		size_t settledVoxels = 0;
+		size_t uniform = 0;
+		size_t bytes = 0;
+		std::unordered_map<long long, ChunkBorders> borders;
+	};
+	auto lightAll = [&](VoxelLight::ChunkMap& chunks) {
+		Lighting result;
+		auto start = Clock::now();
+		for (const glm::ivec3& c : coords) {
+			long long key = World::getChunkKey(c.x, c.y, c.z);
+			VoxelChunk* chunk = chunks.at(key).get();
+			VoxelLight::lightChunk(chunk->voxels, neighborsOf(c, result.borders), openSky(c.y), chunk->light);
+			result.borders[key] = VoxelChunk::extractBorders(chunk->voxels, &chunk->light);
+		}
+		result.chunkMs = elapsedMs(start);
+
+		VoxelLight light(chunks, openSky);
+		start = Clock::now();
+		for (const glm::ivec3& c : coords) {
+			VoxelLight::ChangedChunks changed;
+			light.settleSeams(c, changed);
+			result.settledVoxels += light.getLastVoxelsChanged();
+		}
+		result.settleMs = elapsedMs(start);
+
+		for (const auto& chunk : chunks) {
+			if (chunk.second->light.isUniform()) result.uniform++;
+			result.bytes += chunk.second->light.memoryUsage();
+		}
+		return result;
+	};
+
+	VoxelLight::ChunkMap chunks;
+	makeChunks(chunks, [&](long long key) -> const ChunkStorage& { return terrain.at(key); });
+	Lighting generated = lightAll(chunks);
+	VoxelLight light(chunks, openSky);
+
+	auto chunkOf = [&](glm::ivec3 position, glm::ivec3& local) -> VoxelChunk* {
+		glm::ivec3 c = world.getChunkCoords(glm::vec3(position));
+		local = position - c * CHUNK_SIZE;
+		auto it = chunks.find(World::getChunkKey(c.x, c.y, c.z));
+		return it != chunks.end() ? it->second.get() : nullptr;
+	};
+	auto typeAt = [&](glm::ivec3 position) {
+		glm::ivec3 local;
+		VoxelChunk* chunk = chunkOf(position, local);
+		return chunk ? chunk->voxels.get(local.x, local.y, local.z) : VoxelType::AIR;
+	};
+	// Highest solid voxel of the column within the region
+	auto surfaceAt = [&](int x, int z) {
+		for (int y = (topLayer + 1) * CHUNK_HEIGHT - 1; y >= (center.y - 2) * CHUNK_HEIGHT; y--) {
+			if (typeAt(glm::ivec3(x, y, z)) != VoxelType::AIR) return y;
+		}
+		return (center.y - 2) * CHUNK_HEIGHT;
+	};
+
+	struct EditCost {
+		const char* name;
+		int edits = 0;
+		double incrementalUs = 0.0;
+		double neighbourhoodUs = 0.0;
+		size_t voxels = 0;
+		size_t chunks = 0;
+	};
+	// What a relight without the incremental passes costs at the least: lighting the 27
+	// chunks around the edit again on their own, before settling any seams
+	auto relightNeighbourhood = [&](glm::ivec3 position) {
+		glm::ivec3 c = world.getChunkCoords(glm::vec3(position));
+		auto start = Clock::now();
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					glm::ivec3 next = c + glm::ivec3(dx, dy, dz);
+					auto it = chunks.find(World::getChunkKey(next.x, next.y, next.z));
+					if (it == chunks.end()) continue;
+					ChunkLight scratch;
+					VoxelLight::lightChunk(it->second->voxels, neighborsOf(next, generated.borders), openSky(next.y), scratch);
+				}
+			}
+		}
+		return 1000.0 * elapsedMs(start);
+	};
+	auto edit = [&](glm::ivec3 position, VoxelType type, EditCost& cost) {
+		glm::ivec3 local;
+		VoxelChunk* chunk = chunkOf(position, local);
+		if (!chunk) return false;
+		chunk->setBlock(local.x, local.y, local.z, type);
+
+		VoxelLight::ChangedChunks changed;
+		auto start = Clock::now();
+		light.relight(position, changed);
+		cost.incrementalUs += 1000.0 * elapsedMs(start);
+		cost.voxels += light.getLastVoxelsChanged();
+		cost.chunks += changed.size();
+		cost.neighbourhoodUs += relightNeighbourhood(position);
+		cost.edits++;
+		return true;
+	};
+
+	// Edits stay a chunk away from the sides of the region
+	std::mt19937 rng(11);
+	int extent = (radius - 1) * CHUNK_SIZE;
+	std::uniform_int_distribution<int> column(-extent, extent + CHUNK_SIZE - 1);
+
+	EditCost roofs{ "roof over open ground" }, digs{ "dig out the surface" }, lamps{ "lamp in a cave" }, unlit{ "take the lamp out" };
+	for (int i = 0; i < editsPerKind; i++) {
+		int x = column(rng), z = column(rng);
+		edit(glm::ivec3(x, surfaceAt(x, z) + 3, z), VoxelType::COBBLESTONE, roofs);
+	}
+	for (int i = 0; i < editsPerKind; i++) {
+		int x = column(rng), z = column(rng);
+		edit(glm::ivec3(x, surfaceAt(x, z), z), VoxelType::AIR, digs);
+	}
+	// air the sky doesn't reach, or failing that any air
+	std::uniform_int_distribution<int> height((center.y - 1) * CHUNK_HEIGHT, (topLayer + 1) * CHUNK_HEIGHT - 1);
+	std::vector<glm::ivec3> lampPositions;
+	for (int tries = 0; tries < 20000 && static_cast<int>(lampPositions.size()) < editsPerKind; tries++) {
+		glm::ivec3 position(column(rng), height(rng), column(rng));
+		glm::ivec3 local;
+		VoxelChunk* chunk = chunkOf(position, local);
+		int index = ChunkStorage::index(local.x, local.y, local.z);
+		if (!chunk || chunk->voxels.get(local.x, local.y, local.z) != VoxelType::AIR) continue;
+		if (chunk->light.get(index, LightChannel::SKY) > 0 && tries < 15000) continue;
+		if (edit(position, VoxelType::LAMP, lamps)) {
+			lampPositions.push_back(position);
+		}
+	}
+	for (const glm::ivec3& position : lampPositions) {
+		edit(position, VoxelType::AIR, unlit);
+	}
+	// leave some lamps in for the faces below
+	for (size_t i = 0; i < lampPositions.size(); i += 2) {
+		EditCost again{ "" };
+		edit(lampPositions[i], VoxelType::LAMP, again);
+	}
+
+	// The edited world lit from scratch has to come out the same
+	VoxelLight::ChunkMap fresh;
+	makeChunks(fresh, [&](long long key) -> const ChunkStorage& { return chunks.at(key)->voxels; });
+	Lighting relit = lightAll(fresh);
+	size_t differing = 0;
+	for (const auto& chunk : chunks) {
+		const ChunkLight& other = fresh.at(chunk.first)->light;
+		for (int i = 0; i < ChunkStorage::VOLUME; i++) {
+			if (chunk.second->light.get(i) != other.get(i)) differing++;
+		}
+	}
+
+	// What the light does to the meshes: faces left in the dark, and greedy quads split up
+	// where the light changes along a surface
+	size_t quads = 0, darkQuads = 0, lampLitQuads = 0, greedyLit = 0, greedyUnlit = 0;
+	for (const glm::ivec3& c : coords) {
+		VoxelChunk* chunk = fresh.at(World::getChunkKey(c.x, c.y, c.z)).get();
+		ChunkNeighbors neighbors = neighborsOf(c, relit.borders);
+		ChunkMeshData naive, greedy, greedyWithoutLight;
+		VoxelChunk::buildMeshData(chunk->voxels, neighbors, naive, MeshingMode::NAIVE, &chunk->light);
+		VoxelChunk::buildMeshData(chunk->voxels, neighbors, greedy, MeshingMode::GREEDY, &chunk->light);
+		VoxelChunk::buildMeshData(chunk->voxels, neighbors, greedyWithoutLight, MeshingMode::GREEDY);
+		for (size_t v = 0; v < naive.vertices.size(); v += 4) {
+			quads++;
+			if (naive.vertices[v].skyLight() == 0 && naive.vertices[v].blockLight() == 0) darkQuads++;
+			if (naive.vertices[v].blockLight() > naive.vertices[v].skyLight()) lampLitQuads++;
+		}
+		greedyLit += greedy.vertexCount() / 4;
+		greedyUnlit += greedyWithoutLight.vertexCount() / 4;
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Voxel lighting benchmark (" << coords.size() << " density terrain chunks around chunk 0, 0)" << std::endl;
+	std::cout << "  Lighting chunks as built:    " << std::setw(8) << 1000.0 * generated.chunkMs / coords.size() << " us/chunk" << std::endl;
+	std::cout << "  Settling the seams:          " << std::setw(8) << 1000.0 * generated.settleMs / coords.size() << " us/chunk, "
+		<< generated.settledVoxels << " voxels changed" << std::endl;
+	std::cout << "  " << generated.uniform << " chunks with uniform light, " << generated.bytes / 1024.0 << " KB of light" << std::endl;
+	std::cout << "  edit                     incremental us   voxels   chunks   27 chunks relit us" << std::endl;
+	for (const EditCost* cost : { &roofs, &digs, &lamps, &unlit }) {
+		int n = std::max(cost->edits, 1);
+		std::cout << "  " << std::left << std::setw(24) << cost->name << std::right << std::setw(15) << cost->incrementalUs / n
+			<< std::setw(9) << static_cast<double>(cost->voxels) / n << std::setw(9) << static_cast<double>(cost->chunks) / n
+			<< std::setw(21) << cost->neighbourhoodUs / n << std::endl;
+	}
+	std::cout << "  Voxels differing from the edited world relit from scratch: " << differing << std::endl;
+	std::cout << "  " << quads << " faces, " << darkQuads << " in full darkness, " << lampLitQuads << " lit mostly by lamps" << std::endl;
+	std::cout << "  Greedy quads: " << greedyLit << " lit vs " << greedyUnlit << " without light" << std::endl;
+}
@@ -0,0 +1,62 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+
+class World;
+
+// Offline measurements for the voxel engine.
+// Run with `OpenGLTest --bench <name>`; results are printed to the console
+// and the game window is never opened.
+class Benchmark {
+public:
+	static int run(const std::string& name, World& world);
+
+	// Lookup throughput and bytes per chunk: ChunkStorage vs the old nested maps
+	static void chunkStorage(World& world);
+	// Vertex count, index count and meshing time per chunk for each MeshingMode on the same seed
+	static void meshing(World& world);
+	// Faces removed by culling against neighbour chunk borders at render distance 8
+	static void seamCulling(World& world);
+	// Mesh bytes per chunk with the generic 32 byte Vertex vs the packed VoxelVertex
+	static void vertexFormat(World& world);
+	// Chunk draw calls per frame at render distance 8: one mesh per material vs one per chunk
+	static void drawCalls(World& world);
+	// Chunks kept by the frustum test for a camera in the middle of render distance 8, and its cost
+	static void frustumCulling(World& world);
+	// Time until the chunks in view are built after a teleport, FIFO vs ChunkLoadQueue order
+	static void teleport(World& world);
+	// Chunks generated and meshed per second on 1 to N threads, old worker loop vs JobSystem
+	static void jobScaling(World& world);
+	// Queue operations per second at 1 to 32 threads: ThreadSafeQueue vs LockFreeQueue
+	static void queueContention(World& world);
+	// Microseconds per block edit: the remesh job and the snapshot the main thread takes for it
+	static void editRemesh(World& world);
+	// Chunks loaded, meshed and voxel memory as the world grows taller around the player
+	static void cubicChunks(World& world);
+	// Region file size per chunk and load latency per chunk with a warm and a cold page cache
+	static void regionFiles(World& world);
+	// Save size and load time for a typically edited area: EditJournal deltas vs whole chunks in region files
+	static void editJournal(World& world);
+	// Perlin samples per second: fractalNoise per column vs fractalNoiseGrid, and whether they agree
+	static void noiseGrid(World& world);
+	// Column height queries answered by noise vs by chunk heightmaps, and heightmap upkeep under edits
+	static void heightmapCache(World& world);
+	// Generation cost per chunk: 2D heightmap terrain vs 3D density on a coarse lattice vs density per voxel
+	static void densityTerrain(World& world);
+	// Heightmap generation per chunk with biome regions shared between chunks vs rebuilt for each, and biome coverage
+	static void biomeMap(World& world);
+	// Terrain graph samples per second: the interpreter per column vs the compiled grid program
+	static void noiseGraph(World& world);
+	// Cost of decorating chunks with features, and whether chunks built in different orders and on
+	// several threads end up with the same voxels once every pending write has landed
+	static void featurePlacement(World& world);
+	// Chunks built in one pass each vs through the staged ChunkPipeline: feature merges and seam
+	// reculls left to do afterwards, time per stage and how many chunks wait on their neighbours
+	static void chunkPipeline(World& world);
+	// Sky and block light: flood filling chunks as they're built, and relighting after an edit
+	// incrementally vs relighting the chunks around it from scratch, checked against a full relight
+	static void voxelLighting(World& world);
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "BiomeMap.h"
+#include "../graphics/env/ChunkKey.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+	// Noise coordinates per block, climate features are several hundred blocks across
+	const double climateScale = 0.0015;
+	const int climatePoints = BiomeRegion::BLOCKS / BiomeMap::CLIMATE_STEP + 1;
+
+	// Every biome keeps heightOffset + 16 * variationScale within 16, so blended terrain
+	// stays inside the same bounds as the unscaled height noise
+	const BiomeInfo biomeTable[BIOME_COUNT] = {
+		{ "Plains",    0.0f,  0.0f,   0.0f, 0.7f,
+			{ VoxelType::GRASS, VoxelType::DIRT, VoxelType::COBBLESTONE, VoxelType::SAND, 3 } },
+		{ "Forest",    -0.2f, 0.25f,  2.0f, 0.875f,
+			{ VoxelType::GRASS, VoxelType::DIRT, VoxelType::COBBLESTONE, VoxelType::SAND, 5 } },
+		{ "Desert",    0.35f, -0.35f, -1.0f, 0.35f,
+			{ VoxelType::SAND, VoxelType::SAND, VoxelType::COBBLESTONE, VoxelType::SAND, 4 } },
+		{ "Mountains", -0.4f, -0.2f,  4.0f, 0.75f,
+			{ VoxelType::COBBLESTONE, VoxelType::COBBLESTONE, VoxelType::COBBLESTONE, VoxelType::COBBLESTONE, 0 } },
+		{ "Swamp",     0.2f,  0.4f,   -3.0f, 0.25f,
+			{ VoxelType::DIRT, VoxelType::DIRT, VoxelType::COBBLESTONE, VoxelType::DIRT, 2 } },
+	};
+
+	long long regionKey(int regionX, int regionZ) {
+		return (static_cast<long long>(regionX) << 32) | static_cast<uint32_t>(regionZ);
+	}
+
+	// Deterministic value in [0, 1) per column, picks the biome where several overlap
+	float columnDither(int worldX, int worldZ) {
+		uint32_t h = static_cast<uint32_t>(worldX) * 0x8da6b343u ^ static_cast<uint32_t>(worldZ) * 0xd8163841u;
+		h ^= h >> 15;
+		h *= 0x2c1b3c6du;
+		h ^= h >> 12;
+		return static_cast<float>(h >> 8) / static_cast<float>(1 << 24);
+	}
+}
+
+const float BiomeMap::BLEND_WIDTH = 0.08f;
+
+BiomeMap::BiomeMap(unsigned int seed, size_t capacity)
+	: m_temperature(seed + 1),
+	m_humidity(seed + 2),
+	m_capacity(capacity),
+	m_regionsBuilt(0),
+	m_lookups(0),
+	m_buildNanoseconds(0) {
+}
+
+const BiomeInfo& BiomeMap::info(Biome biome) {
+	return biomeTable[static_cast<int>(biome)];
+}
+
+VoxelType BiomeMap::blockAt(Biome biome, int depth, int surfaceY, int seaLevel) {
+	const BiomeBlocks& blocks = info(biome).blocks;
+	if (depth <= blocks.soilDepth && surfaceY < seaLevel) {
+		return blocks.shore;
+	}
+	if (depth == 0) {
+		return blocks.surface;
+	}
+	return depth <= blocks.soilDepth ? blocks.soil : blocks.stone;
+}
+
+std::shared_ptr<const BiomeRegion> BiomeMap::regionFor(int chunkX, int chunkZ) {
+	int regionX = floorDiv(chunkX, REGION_SIZE);
+	int regionZ = floorDiv(chunkZ, REGION_SIZE);
+	long long key = regionKey(regionX, regionZ);
+	m_lookups++;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_regions.find(key);
+		if (it != m_regions.end()) {
+			m_order.splice(m_order.begin(), m_order, it->second.order);
+			return it->second.region;
+		}
+	}
+
+	// Built outside the lock so other jobs keep hitting the cache meanwhile. Two jobs that
+	// miss the same region both build it and the first one in wins.
+	std::shared_ptr<const BiomeRegion> region = buildRegion(regionX, regionZ);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_regions.find(key);
+	if (it != m_regions.end()) {
+		return it->second.region;
+	}
+	m_order.push_front(key);
+	m_regions[key] = Entry{ region, m_order.begin() };
+	while (m_regions.size() > m_capacity) {
+		m_regions.erase(m_order.back());
+		m_order.pop_back();
+	}
+	return region;
+}
+
+void BiomeMap::clear() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_regions.clear();
+	m_order.clear();
+}
+
+double BiomeMap::getAverageBuildMs() const {
+	size_t built = m_regionsBuilt;
+	return built > 0 ? m_buildNanoseconds / 1e6 / built : 0.0;
+}
+
+std::shared_ptr<const BiomeRegion> BiomeMap::buildRegion(int regionX, int regionZ) {
+	auto start = std::chrono::steady_clock::now();
+
+	// Climate on a coarse lattice covering the region and its far edge
+	double temperature[climatePoints * climatePoints];
+	double humidity[climatePoints * climatePoints];
+	double latticeX = static_cast<double>(regionX * (BiomeRegion::BLOCKS / CLIMATE_STEP));
+	double latticeZ = static_cast<double>(regionZ * (BiomeRegion::BLOCKS / CLIMATE_STEP));
+	double spacing = climateScale * CLIMATE_STEP;
+	m_temperature.fractalNoiseGrid(temperature, climatePoints, climatePoints, latticeX, latticeZ, spacing, 3, 0.5, 1.0);
+	m_humidity.fractalNoiseGrid(humidity, climatePoints, climatePoints, latticeX, latticeZ, spacing, 3, 0.5, 1.0);
+
+	std::shared_ptr<BiomeRegion> region = std::make_shared<BiomeRegion>();
+	int originX = regionX * BiomeRegion::BLOCKS;
+	int originZ = regionZ * BiomeRegion::BLOCKS;
+	for (int z = 0; z < BiomeRegion::BLOCKS; z++) {
+		int k = z / CLIMATE_STEP;
+		float tz = static_cast<float>(z % CLIMATE_STEP) / CLIMATE_STEP;
+		for (int x = 0; x < BiomeRegion::BLOCKS; x++) {
+			int i = x / CLIMATE_STEP;
+			float tx = static_cast<float>(x % CLIMATE_STEP) / CLIMATE_STEP;
+			int corner = k * climatePoints + i;
+
+			float t0 = static_cast<float>(temperature[corner] + tx * (temperature[corner + 1] - temperature[corner]));
+			float t1 = static_cast<float>(temperature[corner + climatePoints] + tx * (temperature[corner + climatePoints + 1] - temperature[corner + climatePoints]));
+			float h0 = static_cast<float>(humidity[corner] + tx * (humidity[corner + 1] - humidity[corner]));
+			float h1 = static_cast<float>(humidity[corner + climatePoints] + tx * (humidity[corner + climatePoints + 1] - humidity[corner + climatePoints]));
+			float t = t0 + tz * (t1 - t0);
+			float h = h0 + tz * (h1 - h0);
+
+			// Weight falls off linearly with climate distance beyond the closest biome
+			float distance[BIOME_COUNT];
+			float closest = 1e9f;
+			for (int b = 0; b < BIOME_COUNT; b++) {
+				float dt = t - biomeTable[b].temperature;
+				float dh = h - biomeTable[b].humidity;
+				distance[b] = std::sqrt(dt * dt + dh * dh);
+				closest = std::min(closest, distance[b]);
+			}
+			float weight[BIOME_COUNT];
+			float total = 0.0f;
+			for (int b = 0; b < BIOME_COUNT; b++) {
+				weight[b] = std::max(0.0f, closest + BLEND_WIDTH - distance[b]);
+				total += weight[b];
+			}
+
+			BiomeColumn& column = region->columns[z * BiomeRegion::BLOCKS + x];
+			column.heightOffset = 0.0f;
+			column.variationScale = 0.0f;
+			float pick = columnDither(originX + x, originZ + z) * total;
+			int picked = -1;
+			for (int b = 0; b < BIOME_COUNT; b++) {
+				column.heightOffset += weight[b] / total * biomeTable[b].heightOffset;
+				column.variationScale += weight[b] / total * biomeTable[b].variationScale;
+				if (picked < 0 && weight[b] > 0.0f) {
+					pick -= weight[b];
+					if (pick < 0.0f) picked = b;
+				}
+			}
+			if (picked < 0) {
+				// rounding left the pick just past the last weight
+				for (int b = BIOME_COUNT - 1; b >= 0; b--) {
+					if (weight[b] > 0.0f) { picked = b; break; }
+				}
+			}
+			column.biome = static_cast<Biome>(picked);
+		}
+	}
+
+	m_buildNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	m_regionsBuilt++;
+	return region;
+}
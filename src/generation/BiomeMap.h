@@ -0,0 +1,122 @@
+#ifndef BIOMEMAP_H
+#define BIOMEMAP_H
+
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "perlin.h"
+#include "../graphics/models/chunkstorage.hpp"
+
+enum class Biome : uint8_t {
+	PLAINS,
+	FOREST,
+	DESERT,
+	MOUNTAINS,
+	SWAMP
+};
+
+const int BIOME_COUNT = 5;
+
+// What a biome builds its columns from
+struct BiomeBlocks {
+	VoxelType surface;
+	VoxelType soil;
+	VoxelType stone;
+	// Surface and soil of columns that end below sea level
+	VoxelType shore;
+	// Soil layers under the surface block, at most BiomeMap::MAX_SOIL_DEPTH
+	int soilDepth;
+};
+
+struct BiomeInfo {
+	const char* name;
+	// Climate the biome is centred on, temperature and humidity in [-1, 1]
+	float temperature;
+	float humidity;
+	// Surface height: base + heightOffset + noise * variation * variationScale
+	float heightOffset;
+	float variationScale;
+	BiomeBlocks blocks;
+};
+
+// Biome of a column, with the height parameters of the biomes around it blended in
+struct BiomeColumn {
+	Biome biome;
+	float heightOffset;
+	float variationScale;
+};
+
+// Columns of one square region, BiomeMap::REGION_SIZE chunks on a side
+struct BiomeRegion {
+	static const int BLOCKS = 4 * CHUNK_SIZE;
+	std::array<BiomeColumn, BLOCKS * BLOCKS> columns;
+
+	const BiomeColumn& at(int worldX, int worldZ) const {
+		return columns[(worldZ & (BLOCKS - 1)) * BLOCKS + (worldX & (BLOCKS - 1))];
+	}
+};
+
+// Temperature and humidity from two low frequency noise fields, turned into biomes.
+//
+// Climate changes over hundreds of blocks, so it is sampled every CLIMATE_STEP blocks
+// and interpolated. Each biome is weighted by how close the column's climate is to its
+// own; within BLEND_WIDTH of the closest one biomes share the column, which blends the
+// height parameters across borders and dithers the block tables.
+//
+// Regions are built on first use and kept in a small LRU cache, so the stacked chunks of
+// a column and neighbouring chunk jobs share one grid. Safe to use from any thread.
+class BiomeMap {
+public:
+	static const int REGION_SIZE = BiomeRegion::BLOCKS / CHUNK_SIZE;
+	static const int CLIMATE_STEP = 4;
+	// Deepest soil of any biome, how far below a surface blockAt can return something but stone
+	static const int MAX_SOIL_DEPTH = 5;
+	// How much further from a column's climate than the closest biome another biome can be
+	// and still share the column
+	static const float BLEND_WIDTH;
+
+	explicit BiomeMap(unsigned int seed, size_t capacity = 64);
+
+	BiomeMap(const BiomeMap&) = delete;
+	BiomeMap& operator=(const BiomeMap&) = delete;
+
+	// The region holding this chunk column, built if it isn't cached
+	std::shared_ptr<const BiomeRegion> regionFor(int chunkX, int chunkZ);
+	void clear();
+
+	static const BiomeInfo& info(Biome biome);
+	// Surface, soil or stone for the block depth blocks below the surface of a column at surfaceY
+	static VoxelType blockAt(Biome biome, int depth, int surfaceY, int seaLevel);
+
+	size_t getRegionsBuilt() const { return m_regionsBuilt; }
+	size_t getLookups() const { return m_lookups; }
+	double getAverageBuildMs() const;
+
+private:
+	PerlinNoise m_temperature;
+	PerlinNoise m_humidity;
+	size_t m_capacity;
+
+	std::mutex m_mutex;
+	// Most recently used at the front
+	std::list<long long> m_order;
+	struct Entry {
+		std::shared_ptr<const BiomeRegion> region;
+		std::list<long long>::iterator order;
+	};
+	std::unordered_map<long long, Entry> m_regions;
+
+	std::atomic<size_t> m_regionsBuilt;
+	std::atomic<size_t> m_lookups;
+	std::atomic<long long> m_buildNanoseconds;
+
+	std::shared_ptr<const BiomeRegion> buildRegion(int regionX, int regionZ);
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "FeaturePlacer.h"
+#include "../graphics/env/ChunkKey.h"
+
+#include <cstdlib>
+
+namespace {
+	// Chance per cell of a tree and of a boulder, indexed by Biome
+	const float treeChance[BIOME_COUNT] = { 0.08f, 0.7f, 0.0f, 0.0f, 0.3f };
+	const float boulderChance[BIOME_COUNT] = { 0.02f, 0.0f, 0.03f, 0.15f, 0.0f };
+
+	int featureRank(VoxelType type) {
+		switch (type) {
+		case VoxelType::AIR:    return 0;
+		case VoxelType::LEAVES: return 1;
+		case VoxelType::LOG:    return 2;
+		default:                return 3;
+		}
+	}
+
+	struct Root {
+		glm::ivec3 position;
+		bool tree;
+		uint32_t shape;
+	};
+}
+
+FeaturePlacer::FeaturePlacer(unsigned int seed)
+	: m_seed(seed) {
+}
+
+bool FeaturePlacer::replaces(VoxelType current, VoxelType placed) {
+	// anything solid that isn't a feature block is terrain
+	if (current != VoxelType::AIR && current != VoxelType::LEAVES && current != VoxelType::LOG) {
+		return false;
+	}
+	return featureRank(placed) > featureRank(current);
+}
+
+uint32_t FeaturePlacer::hash(int cellX, int cellZ, uint32_t salt) const {
+	uint32_t h = m_seed * 0x9e3779b9u ^ static_cast<uint32_t>(cellX) * 0x85ebca6bu ^
+		static_cast<uint32_t>(cellZ) * 0xc2b2ae35u ^ salt * 0x27d4eb2fu;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+int FeaturePlacer::decorate(glm::ivec3 coords, ChunkStorage& voxels, BiomeMap& biomes, std::vector<Write>& outside) const {
+	glm::ivec3 origin = coords * CHUNK_SIZE;
+	std::shared_ptr<const BiomeRegion> region = biomes.regionFor(coords.x, coords.z);
+
+	// Find every root on the bare terrain first, so one feature can't hide another's root
+	std::vector<Root> roots;
+	int firstCellX = floorDiv(origin.x, CELL_SIZE);
+	int firstCellZ = floorDiv(origin.z, CELL_SIZE);
+	int lastCellX = floorDiv(origin.x + CHUNK_SIZE - 1, CELL_SIZE);
+	int lastCellZ = floorDiv(origin.z + CHUNK_SIZE - 1, CELL_SIZE);
+	for (int cellZ = firstCellZ; cellZ <= lastCellZ; cellZ++) {
+		for (int cellX = firstCellX; cellX <= lastCellX; cellX++) {
+			uint32_t position = hash(cellX, cellZ, 0);
+			int localX = cellX * CELL_SIZE + static_cast<int>(position % CELL_SIZE) - origin.x;
+			int localZ = cellZ * CELL_SIZE + static_cast<int>((position / CELL_SIZE) % CELL_SIZE) - origin.z;
+			// cells straddle chunk borders, the chunk holding the root column grows it
+			if (localX < 0 || localX >= CHUNK_SIZE || localZ < 0 || localZ >= CHUNK_SIZE) continue;
+
+			int biome = static_cast<int>(region->at(origin.x + localX, origin.z + localZ).biome);
+			float roll = static_cast<float>(hash(cellX, cellZ, 1) >> 8) / static_cast<float>(1 << 24);
+			bool tree = roll < treeChance[biome];
+			if (!tree && roll >= treeChance[biome] + boulderChance[biome]) continue;
+
+			// The topmost solid voxel of the column. Grass is always open to the sky where
+			// it's generated; other blocks need air above them within this chunk.
+			for (int y = CHUNK_HEIGHT - 1; y >= 0; y--) {
+				VoxelType type = voxels.get(localX, y, localZ);
+				if (type == VoxelType::AIR) continue;
+				bool open = type == VoxelType::GRASS || y < CHUNK_HEIGHT - 1;
+				if (open && (!tree || type == VoxelType::GRASS)) {
+					roots.push_back(Root{ glm::ivec3(localX, y, localZ) + origin, tree, hash(cellX, cellZ, 2) });
+				}
+				break;
+			}
+		}
+	}
+
+	auto place = [&](glm::ivec3 position, VoxelType type) {
+		glm::ivec3 local = position - origin;
+		if (!ChunkStorage::inBounds(local.x, local.y, local.z)) {
+			outside.push_back(Write{ position, type });
+		}
+		else if (replaces(voxels.get(local.x, local.y, local.z), type)) {
+			voxels.set(local.x, local.y, local.z, type);
+		}
+	};
+
+	for (const Root& root : roots) {
+		glm::ivec3 base = root.position;
+		if (root.tree) {
+			int height = 4 + static_cast<int>(root.shape % 3);
+			// two wide layers of leaves with ragged corners, a narrow one, and a cap
+			for (int dy = height - 2; dy <= height + 1; dy++) {
+				int radius = dy < height ? 2 : (dy == height ? 1 : 0);
+				for (int dz = -radius; dz <= radius; dz++) {
+					for (int dx = -radius; dx <= radius; dx++) {
+						// the narrow layer is a plus, the wide ones drop a corner on one bit of the shape each
+						bool corner = radius > 0 && std::abs(dx) == radius && std::abs(dz) == radius;
+						int cornerBit = 8 + (dx > 0) + 2 * (dz > 0) + 4 * (dy - height + 2);
+						if (corner && (radius == 1 || ((root.shape >> cornerBit) & 1))) continue;
+						place(base + glm::ivec3(dx, dy, dz), VoxelType::LEAVES);
+					}
+				}
+			}
+			for (int dy = 1; dy <= height; dy++) {
+				place(base + glm::ivec3(0, dy, 0), VoxelType::LOG);
+			}
+		}
+		else {
+			int radius = 1 + static_cast<int>(root.shape % 2);
+			for (int dy = -1; dy <= radius; dy++) {
+				for (int dz = -radius; dz <= radius; dz++) {
+					for (int dx = -radius; dx <= radius; dx++) {
+						if (dx * dx + dy * dy + dz * dz <= radius * radius + 1) {
+							place(base + glm::ivec3(dx, dy + 1, dz), VoxelType::COBBLESTONE);
+						}
+					}
+				}
+			}
+		}
+	}
+	return static_cast<int>(roots.size());
+}
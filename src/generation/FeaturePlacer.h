@@ -0,0 +1,49 @@
+#ifndef FEATUREPLACER_H
+#define FEATUREPLACER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BiomeMap.h"
+#include "../graphics/models/chunkstorage.hpp"
+
+// Trees and boulders on top of generated terrain.
+//
+// Every CELL_SIZE x CELL_SIZE block cell of the world has at most one candidate
+// feature, at a position and of a kind picked by hashing the seed and the cell, with
+// a chance that depends on the biome there. A candidate grows from the topmost
+// grass (trees) or any surface (boulders) of its column in the chunk being
+// decorated, so the same seed always grows the same features whatever order chunks
+// are built in. Features never replace terrain; where two overlap, replaces() picks
+// the same winner whichever is placed first.
+class FeaturePlacer {
+public:
+	static const int CELL_SIZE = 5;
+	// How far a feature reaches from its root column, and above its root block
+	static const int MAX_RADIUS = 2;
+	static const int MAX_HEIGHT = 8;
+
+	// A voxel a feature places outside the chunk it is rooted in
+	struct Write {
+		glm::ivec3 position;
+		VoxelType type;
+	};
+
+	explicit FeaturePlacer(unsigned int seed);
+
+	// Whether a feature voxel of type placed goes over what's already there:
+	// air < leaves < log < boulder stone, and terrain is never replaced
+	static bool replaces(VoxelType current, VoxelType placed);
+
+	// Grows the features rooted in this chunk. Voxels inside it go straight into
+	// voxels, the others are appended to outside. Returns the number of features.
+	int decorate(glm::ivec3 coords, ChunkStorage& voxels, BiomeMap& biomes, std::vector<Write>& outside) const;
+
+private:
+	unsigned int m_seed;
+
+	uint32_t hash(int cellX, int cellZ, uint32_t salt) const;
+};
+
+#endif
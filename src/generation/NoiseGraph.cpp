@@ -0,0 +1,536 @@
+#include "NoiseGraph.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+
+const char* const NoiseGraph::DEFAULT_GRAPH =
+	"height = fractal scale=0.01 octaves=4 persistence=0.5\n"
+	"output height\n";
+
+namespace {
+	bool parseNumber(const std::string& token, double& value) {
+		if (token.empty()) return false;
+		char* end = nullptr;
+		value = std::strtod(token.c_str(), &end);
+		return end == token.c_str() + token.size();
+	}
+
+	// low below threshold - falloff, high above threshold + falloff, smooth in between
+	double blend(double control, double low, double high, double threshold, double falloff) {
+		if (falloff <= 0.0) {
+			return control > threshold ? high : low;
+		}
+		double t = (control - threshold + falloff) / (2.0 * falloff);
+		t = std::min(1.0, std::max(0.0, t));
+		return low + t * t * (3.0 - 2.0 * t) * (high - low);
+	}
+}
+
+NoiseGraph::NoiseGraph(unsigned int seed)
+	: m_seed(seed),
+	m_output(-1),
+	m_registerCount(0),
+	m_resultRegister(0) {
+	parse(DEFAULT_GRAPH, "default graph");
+}
+
+bool NoiseGraph::load(const std::string& path) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "Could not open " << path << std::endl;
+		return false;
+	}
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	return parse(buffer.str(), path);
+}
+
+bool NoiseGraph::parse(const std::string& text, const std::string& source) {
+	std::vector<Node> nodes;
+	std::unordered_map<std::string, int> names;
+	std::vector<unsigned int> seeds;
+	int output = -1;
+
+	std::istringstream lines(text);
+	std::string line;
+	int lineNumber = 0;
+	auto fail = [&](const std::string& message) {
+		std::cout << source << ":" << lineNumber << ": " << message << std::endl;
+		return false;
+	};
+
+	while (std::getline(lines, line)) {
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) {
+			line.erase(comment);
+		}
+		std::istringstream words(line);
+		std::vector<std::string> tokens;
+		std::string token;
+		while (words >> token) {
+			tokens.push_back(token);
+		}
+		if (tokens.empty()) {
+			continue;
+		}
+
+		if (tokens[0] == "output") {
+			if (tokens.size() != 2 || names.find(tokens[1]) == names.end()) {
+				return fail("output takes one node defined above it");
+			}
+			output = names[tokens[1]];
+			continue;
+		}
+		if (tokens.size() < 3 || tokens[1] != "=") {
+			return fail("expected <name> = <op> <arguments>");
+		}
+		if (names.find(tokens[0]) != names.end()) {
+			return fail(tokens[0] + " is defined twice");
+		}
+
+		// Positional arguments, then key=value parameters in any order
+		std::vector<std::string> args;
+		std::unordered_map<std::string, double> keys;
+		for (size_t i = 3; i < tokens.size(); i++) {
+			size_t equals = tokens[i].find('=');
+			if (equals == std::string::npos) {
+				args.push_back(tokens[i]);
+				continue;
+			}
+			double value;
+			if (!parseNumber(tokens[i].substr(equals + 1), value)) {
+				return fail("bad number in " + tokens[i]);
+			}
+			keys[tokens[i].substr(0, equals)] = value;
+		}
+		auto key = [&](const char* name, double fallback) {
+			auto it = keys.find(name);
+			if (it == keys.end()) return fallback;
+			double value = it->second;
+			keys.erase(it);
+			return value;
+		};
+
+		const std::string& op = tokens[2];
+		Node node;
+		size_t operands = args.size();
+		if (op == "fractal" || op == "perlin") {
+			node.op = Op::FRACTAL;
+			node.params[0] = key("scale", 1.0);
+			node.params[1] = op == "perlin" ? 1.0 : key("octaves", 4.0);
+			node.params[2] = key("persistence", 0.5);
+			unsigned int seed = m_seed + static_cast<unsigned int>(static_cast<int>(key("seed", 0.0)));
+			if (node.params[1] < 1.0) {
+				return fail("octaves must be at least 1");
+			}
+			node.noise = static_cast<int>(std::find(seeds.begin(), seeds.end(), seed) - seeds.begin());
+			if (node.noise == static_cast<int>(seeds.size())) {
+				seeds.push_back(seed);
+			}
+			operands = 0;
+		}
+		else if (op == "const" || op == "abs") {
+			node.op = op == "const" ? Op::CONSTANT : Op::ABS;
+			operands = 1;
+		}
+		else if (op == "add" || op == "sub" || op == "mul" || op == "min" || op == "max") {
+			node.op = op == "add" ? Op::ADD : op == "sub" ? Op::SUB : op == "mul" ? Op::MUL : op == "min" ? Op::MIN : Op::MAX;
+			operands = 2;
+		}
+		else if (op == "clamp") {
+			node.op = Op::CLAMP;
+			if (args.size() != 3 || !parseNumber(args[1], node.params[0]) || !parseNumber(args[2], node.params[1])) {
+				return fail("clamp takes a node and two numbers");
+			}
+			operands = 1;
+		}
+		else if (op == "curve") {
+			node.op = Op::CURVE;
+			for (size_t i = 1; i < args.size(); i++) {
+				size_t colon = args[i].find(':');
+				double x, y;
+				if (colon == std::string::npos || !parseNumber(args[i].substr(0, colon), x) || !parseNumber(args[i].substr(colon + 1), y)) {
+					return fail("curve points are x:y, got " + args[i]);
+				}
+				if (!node.curve.empty() && x <= node.curve[node.curve.size() - 2]) {
+					return fail("curve points must be in increasing x");
+				}
+				node.curve.push_back(x);
+				node.curve.push_back(y);
+			}
+			if (node.curve.size() < 4) {
+				return fail("curve needs at least two points");
+			}
+			operands = 1;
+		}
+		else if (op == "select") {
+			node.op = Op::SELECT;
+			node.params[0] = key("threshold", 0.0);
+			node.params[1] = key("falloff", 0.0);
+			operands = 3;
+		}
+		else {
+			return fail("unknown op " + op);
+		}
+
+		if (args.size() < operands || (node.op != Op::CLAMP && node.op != Op::CURVE && args.size() != operands)) {
+			return fail(op + " takes " + std::to_string(operands) + " operands");
+		}
+		for (size_t i = 0; i < operands; i++) {
+			Operand operand;
+			auto it = names.find(args[i]);
+			if (it != names.end()) {
+				operand.node = it->second;
+			}
+			else if (!parseNumber(args[i], operand.value)) {
+				return fail("no node called " + args[i] + " defined above");
+			}
+			node.inputs.push_back(operand);
+		}
+		if (node.op == Op::CONSTANT && node.inputs[0].node >= 0) {
+			return fail("const takes a number");
+		}
+		if (!keys.empty()) {
+			return fail("unknown parameter " + keys.begin()->first + " for " + op);
+		}
+
+		names[tokens[0]] = static_cast<int>(nodes.size());
+		nodes.push_back(node);
+	}
+
+	if (output < 0) {
+		return fail("no output line");
+	}
+
+	m_source = source;
+	m_text = text;
+	m_nodes = std::move(nodes);
+	m_output = output;
+	m_noises.clear();
+	for (unsigned int seed : seeds) {
+		m_noises.emplace_back(seed);
+	}
+	compile();
+	return true;
+}
+
+double NoiseGraph::applyCurve(const std::vector<double>& curve, double v) {
+	if (v <= curve[0]) return curve[1];
+	for (size_t i = 2; i < curve.size(); i += 2) {
+		if (v < curve[i]) {
+			return curve[i - 1] + (v - curve[i - 2]) / (curve[i] - curve[i - 2]) * (curve[i + 1] - curve[i - 1]);
+		}
+	}
+	return curve[curve.size() - 1];
+}
+
+double NoiseGraph::apply(const Node& node, const double* inputs) {
+	switch (node.op) {
+	case Op::CONSTANT: return inputs[0];
+	case Op::ADD:      return inputs[0] + inputs[1];
+	case Op::SUB:      return inputs[0] - inputs[1];
+	case Op::MUL:      return inputs[0] * inputs[1];
+	case Op::MIN:      return std::min(inputs[0], inputs[1]);
+	case Op::MAX:      return std::max(inputs[0], inputs[1]);
+	case Op::ABS:      return std::abs(inputs[0]);
+	case Op::CLAMP:    return std::min(std::max(inputs[0], node.params[0]), node.params[1]);
+	case Op::CURVE:    return applyCurve(node.curve, inputs[0]);
+	case Op::SELECT:   return blend(inputs[0], inputs[1], inputs[2], node.params[0], node.params[1]);
+	default:           return 0.0;
+	}
+}
+
+double NoiseGraph::interpretNode(int index, double x, double z) {
+	const Node& node = m_nodes[index];
+	if (node.op == Op::FRACTAL) {
+		double scale = node.params[0];
+		return m_noises[node.noise].fractalNoise(x * scale, z * scale, static_cast<int>(node.params[1]), node.params[2], 1.0);
+	}
+	double inputs[3];
+	for (size_t i = 0; i < node.inputs.size(); i++) {
+		inputs[i] = node.inputs[i].node < 0 ? node.inputs[i].value : interpretNode(node.inputs[i].node, x, z);
+	}
+	return apply(node, inputs);
+}
+
+double NoiseGraph::interpret(double x, double z) {
+	return std::min(std::max(interpretNode(m_output, x, z), -1.0), 1.0);
+}
+
+void NoiseGraph::compile() {
+	const int count = static_cast<int>(m_nodes.size());
+
+	// Nodes only refer to nodes above them, so one pass upwards finds what the output needs
+	std::vector<bool> live(count, false);
+	live[m_output] = true;
+	for (int n = count - 1; n >= 0; n--) {
+		if (!live[n]) continue;
+		for (const Operand& operand : m_nodes[n].inputs) {
+			if (operand.node >= 0) live[operand.node] = true;
+		}
+	}
+
+	// Fold nodes that only depend on numbers
+	std::vector<bool> constant(count, false);
+	std::vector<double> value(count, 0.0);
+	for (int n = 0; n < count; n++) {
+		const Node& node = m_nodes[n];
+		if (!live[n] || node.op == Op::FRACTAL) continue;
+		double inputs[3];
+		bool folds = true;
+		for (size_t i = 0; i < node.inputs.size(); i++) {
+			int input = node.inputs[i].node;
+			if (input >= 0 && !constant[input]) folds = false;
+			inputs[i] = input < 0 ? node.inputs[i].value : value[input];
+		}
+		if (folds) {
+			constant[n] = true;
+			value[n] = apply(node, inputs);
+		}
+	}
+
+	// Sources with the same noise and parameters are evaluated once
+	std::vector<int> alias(count);
+	for (int n = 0; n < count; n++) {
+		alias[n] = n;
+		const Node& node = m_nodes[n];
+		if (!live[n] || node.op != Op::FRACTAL) continue;
+		for (int m = 0; m < n; m++) {
+			const Node& other = m_nodes[m];
+			if (live[m] && alias[m] == m && other.op == Op::FRACTAL && other.noise == node.noise &&
+				other.params[0] == node.params[0] && other.params[1] == node.params[1] && other.params[2] == node.params[2]) {
+				alias[n] = m;
+				break;
+			}
+		}
+	}
+	auto resolve = [&](Operand operand) {
+		if (operand.node >= 0 && constant[operand.node]) {
+			operand.value = value[operand.node];
+			operand.node = -1;
+		}
+		else if (operand.node >= 0) {
+			operand.node = alias[operand.node];
+		}
+		return operand;
+	};
+
+	// How many steps still read each node's value; the output counts as one
+	std::vector<int> uses(count, 0);
+	for (int n = 0; n < count; n++) {
+		if (!live[n] || constant[n] || alias[n] != n) continue;
+		for (const Operand& operand : m_nodes[n].inputs) {
+			Operand input = resolve(operand);
+			if (input.node >= 0) uses[input.node]++;
+		}
+	}
+	int output = alias[m_output];
+	if (!constant[m_output]) uses[output]++;
+	const std::vector<int> readers = uses;
+
+	m_steps.clear();
+	std::vector<int> stepOf(count, -1), registerOf(count, -1);
+	std::vector<int> freeRegisters;
+	int registers = 0;
+	auto allocate = [&]() {
+		if (freeRegisters.empty()) return registers++;
+		int reg = freeRegisters.back();
+		freeRegisters.pop_back();
+		return reg;
+	};
+	auto release = [&](int node) {
+		if (--uses[node] == 0) freeRegisters.push_back(registerOf[node]);
+	};
+	// Applies link to the value of input: in place if nothing else ever reads it, else on a copy
+	auto appendLink = [&](int input, ChainOp link) {
+		int step;
+		int reg;
+		if (readers[input] == 1) {
+			uses[input] = 0;
+			step = stepOf[input];
+			reg = registerOf[input];
+		}
+		else {
+			Step copy;
+			copy.op = Op::COPY;
+			copy.inputs[0] = registerOf[input];
+			copy.dest = allocate();
+			release(input);
+			step = static_cast<int>(m_steps.size());
+			reg = copy.dest;
+			m_steps.push_back(copy);
+		}
+		std::vector<ChainOp>& chain = m_steps[step].chain;
+		if (link.op == Op::AFFINE && !chain.empty() && chain.back().op == Op::AFFINE) {
+			chain.back().b = chain.back().b * link.a + link.b;
+			chain.back().a *= link.a;
+		}
+		else {
+			chain.push_back(link);
+		}
+		return std::make_pair(step, reg);
+	};
+
+	for (int n = 0; n < count; n++) {
+		if (!live[n] || constant[n] || alias[n] != n) continue;
+		const Node& node = m_nodes[n];
+		Operand inputs[3];
+		int variables = 0, variable = -1;
+		for (size_t i = 0; i < node.inputs.size(); i++) {
+			inputs[i] = resolve(node.inputs[i]);
+			if (inputs[i].node >= 0) {
+				variables++;
+				variable = static_cast<int>(i);
+			}
+		}
+
+		// One varying input and the rest numbers: a link in its input's chain
+		if (variables == 1 && node.op != Op::SELECT) {
+			ChainOp link;
+			double other = node.inputs.size() == 2 ? inputs[1 - variable].value : 0.0;
+			switch (node.op) {
+			case Op::ADD:   link.op = Op::AFFINE; link.a = 1.0; link.b = other; break;
+			case Op::SUB:   link.op = Op::AFFINE; link.a = variable == 0 ? 1.0 : -1.0; link.b = variable == 0 ? -other : other; break;
+			case Op::MUL:   link.op = Op::AFFINE; link.a = other; link.b = 0.0; break;
+			case Op::MIN:
+			case Op::MAX:   link.op = node.op; link.a = other; break;
+			case Op::CLAMP: link.op = Op::CLAMP; link.a = node.params[0]; link.b = node.params[1]; break;
+			default:        link.op = node.op; link.node = n; break;
+			}
+			std::pair<int, int> placed = appendLink(inputs[variable].node, link);
+			stepOf[n] = placed.first;
+			registerOf[n] = placed.second;
+			continue;
+		}
+
+		Step step;
+		step.op = node.op;
+		step.node = n;
+		std::vector<int> filled;
+		for (size_t i = 0; i < node.inputs.size(); i++) {
+			if (inputs[i].node >= 0) {
+				step.inputs[i] = registerOf[inputs[i].node];
+				continue;
+			}
+			// only select mixes numbers with varying inputs this way
+			Step fill;
+			fill.op = Op::CONSTANT;
+			fill.value = inputs[i].value;
+			fill.dest = allocate();
+			m_steps.push_back(fill);
+			step.inputs[i] = fill.dest;
+			filled.push_back(fill.dest);
+		}
+		// Every op reads element i before writing it, so dest may reuse an input's register
+		for (size_t i = 0; i < node.inputs.size(); i++) {
+			if (inputs[i].node >= 0) release(inputs[i].node);
+		}
+		freeRegisters.insert(freeRegisters.end(), filled.begin(), filled.end());
+		step.dest = allocate();
+		stepOf[n] = static_cast<int>(m_steps.size());
+		registerOf[n] = step.dest;
+		m_steps.push_back(step);
+	}
+
+	ChainOp clamp;
+	clamp.op = Op::CLAMP;
+	clamp.a = -1.0;
+	clamp.b = 1.0;
+	if (constant[m_output]) {
+		Step fill;
+		fill.op = Op::CONSTANT;
+		fill.value = std::min(std::max(value[m_output], -1.0), 1.0);
+		fill.dest = allocate();
+		m_steps.push_back(fill);
+		m_resultRegister = fill.dest;
+	}
+	else {
+		m_resultRegister = appendLink(output, clamp).second;
+	}
+	m_registerCount = registers;
+}
+
+void NoiseGraph::evaluateGrid(double* out, int width, int height, double x0, double z0) {
+	const size_t cells = static_cast<size_t>(width) * height;
+	std::vector<double> registers(m_registerCount * cells);
+
+	for (const Step& step : m_steps) {
+		double* dest = &registers[step.dest * cells];
+		const double* a = &registers[step.inputs[0] * cells];
+		const double* b = &registers[step.inputs[1] * cells];
+		const double* c = &registers[step.inputs[2] * cells];
+		const Node& node = m_nodes[step.node];
+		switch (step.op) {
+		case Op::FRACTAL:
+			m_noises[node.noise].fractalNoiseGrid(dest, width, height, x0, z0, node.params[0],
+				static_cast<int>(node.params[1]), node.params[2], 1.0);
+			break;
+		case Op::CONSTANT:
+			std::fill(dest, dest + cells, step.value);
+			break;
+		case Op::COPY:
+			std::copy(a, a + cells, dest);
+			break;
+		case Op::ADD:
+			for (size_t i = 0; i < cells; i++) dest[i] = a[i] + b[i];
+			break;
+		case Op::SUB:
+			for (size_t i = 0; i < cells; i++) dest[i] = a[i] - b[i];
+			break;
+		case Op::MUL:
+			for (size_t i = 0; i < cells; i++) dest[i] = a[i] * b[i];
+			break;
+		case Op::MIN:
+			for (size_t i = 0; i < cells; i++) dest[i] = std::min(a[i], b[i]);
+			break;
+		case Op::MAX:
+			for (size_t i = 0; i < cells; i++) dest[i] = std::max(a[i], b[i]);
+			break;
+		case Op::SELECT:
+			for (size_t i = 0; i < cells; i++) dest[i] = blend(a[i], b[i], c[i], node.params[0], node.params[1]);
+			break;
+		default:
+			break;
+		}
+
+		// The fused chain, one tight loop per link over the buffer while it's still in cache
+		for (const ChainOp& link : step.chain) {
+			switch (link.op) {
+			case Op::AFFINE:
+				for (size_t i = 0; i < cells; i++) dest[i] = dest[i] * link.a + link.b;
+				break;
+			case Op::MIN:
+				for (size_t i = 0; i < cells; i++) dest[i] = std::min(dest[i], link.a);
+				break;
+			case Op::MAX:
+				for (size_t i = 0; i < cells; i++) dest[i] = std::max(dest[i], link.a);
+				break;
+			case Op::ABS:
+				for (size_t i = 0; i < cells; i++) dest[i] = std::abs(dest[i]);
+				break;
+			case Op::CLAMP:
+				for (size_t i = 0; i < cells; i++) dest[i] = std::min(std::max(dest[i], link.a), link.b);
+				break;
+			case Op::CURVE:
+				for (size_t i = 0; i < cells; i++) dest[i] = applyCurve(m_nodes[link.node].curve, dest[i]);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	const double* result = &registers[m_resultRegister * cells];
+	std::copy(result, result + cells, out);
+}
+
+double NoiseGraph::evaluate(double x, double z) {
+	double value;
+	evaluateGrid(&value, 1, 1, x, z);
+	return value;
+}
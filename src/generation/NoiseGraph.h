@@ -0,0 +1,121 @@
+#ifndef NOISEGRAPH_H
+#define NOISEGRAPH_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "perlin.h"
+
+// Terrain surface noise described by a graph of nodes in a text file, one per line:
+//
+//     hills = fractal scale=0.01 octaves=4 persistence=0.5 seed=0
+//     flat  = mul hills 0.5
+//     output flat
+//
+// Sources: fractal (scale, octaves, persistence, seed), perlin (one octave), const.
+// Combinators: add, sub, mul, min, max of two operands, abs, clamp <in> <lo> <hi>,
+// curve <in> x:y x:y ... (piecewise linear, flat past the ends) and
+// select <control> <low> <high> threshold=t falloff=f, which blends from low to high as
+// control crosses threshold. Operands are node names or numbers; nodes must be defined
+// before they are used. seed is added to the world seed. The output is clamped to [-1, 1].
+//
+// parse() compiles the graph into a list of steps over whole grids: unused nodes are
+// dropped, constant nodes folded, identical sources evaluated once, and chains of
+// single input operations fused into the step that produced their input, so a chunk is
+// a handful of tight loops over one buffer per live value. interpret() walks the graph
+// per sample instead and is kept as the reference.
+class NoiseGraph {
+public:
+	explicit NoiseGraph(unsigned int seed);
+
+	// Replace the graph with the one in a file or string; on errors the old graph stays
+	bool load(const std::string& path);
+	bool parse(const std::string& text, const std::string& source);
+
+	// out[row * width + col] gets the value at (x0 + col, z0 + row). Any thread.
+	void evaluateGrid(double* out, int width, int height, double x0, double z0);
+	double evaluate(double x, double z);
+	// One sample by walking the nodes with scalar noise, no compilation
+	double interpret(double x, double z);
+
+	const std::string& getSource() const { return m_source; }
+	// The text the current graph was parsed from
+	const std::string& getText() const { return m_text; }
+	size_t getNodeCount() const { return m_nodes.size(); }
+	size_t getStepCount() const { return m_steps.size(); }
+	size_t getRegisterCount() const { return m_registerCount; }
+
+	// Plain fractal noise, what the terrain was before graphs
+	static const char* const DEFAULT_GRAPH;
+
+private:
+	enum class Op {
+		CONSTANT,
+		FRACTAL,
+		ADD,
+		SUB,
+		MUL,
+		MIN,
+		MAX,
+		ABS,
+		CLAMP,
+		CURVE,
+		SELECT,
+		// Compiled steps only: copies a value that's still needed elsewhere before changing it
+		COPY,
+		// Fused chains only: v * a + b
+		AFFINE
+	};
+
+	// A node name or, with node -1, a number
+	struct Operand {
+		int node = -1;
+		double value = 0.0;
+	};
+
+	struct Node {
+		Op op;
+		std::vector<Operand> inputs;
+		// fractal: scale, octaves, persistence; clamp: lo, hi; select: threshold, falloff
+		double params[3] = { 0.0, 0.0, 0.0 };
+		int noise = 0;
+		// curve: x0, y0, x1, y1, ...
+		std::vector<double> curve;
+	};
+
+	struct ChainOp {
+		Op op;
+		double a = 0.0;
+		double b = 0.0;
+		int node = -1;
+	};
+
+	struct Step {
+		Op op;
+		int dest = 0;
+		int inputs[3] = { 0, 0, 0 };
+		// The source or combinator node this step evaluates
+		int node = 0;
+		double value = 0.0;
+		std::vector<ChainOp> chain;
+	};
+
+	unsigned int m_seed;
+	std::string m_source;
+	std::string m_text;
+	std::vector<Node> m_nodes;
+	int m_output;
+	std::vector<PerlinNoise> m_noises;
+
+	std::vector<Step> m_steps;
+	int m_registerCount;
+	int m_resultRegister;
+
+	double interpretNode(int node, double x, double z);
+	static double apply(const Node& node, const double* inputs);
+	static double applyCurve(const std::vector<double>& curve, double v);
+	void compile();
+};
+
+#endif
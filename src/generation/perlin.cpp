@@ -1,9 +1,90 @@
 #include "perlin.h"
 
-PerlinNoise::PerlinNoise(unsigned int seed) {
-    // Create permutation table
-    permutation.resize(512);
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PERLIN_SSE2
+#endif
+
+namespace {
+    // The same few operations on COUNT doubles at a time. The grid kernel is written once
+    // against these and does every operation in the order noise() does, so the results match.
+#if defined(__AVX2__)
+    struct Lanes {
+        static const int COUNT = 4;
+        typedef __m256d Value;
+        static Value load(const double* p) { return _mm256_loadu_pd(p); }
+        static void store(double* p, Value a) { _mm256_storeu_pd(p, a); }
+        static Value set1(double a) { return _mm256_set1_pd(a); }
+        // table[index[lane]] in each lane
+        static Value lookup(const double* table, const int* index) {
+            return _mm256_set_pd(table[index[3]], table[index[2]], table[index[1]], table[index[0]]);
+        }
+        static Value add(Value a, Value b) { return _mm256_add_pd(a, b); }
+        static Value sub(Value a, Value b) { return _mm256_sub_pd(a, b); }
+        static Value mul(Value a, Value b) { return _mm256_mul_pd(a, b); }
+        static Value div(Value a, Value b) { return _mm256_div_pd(a, b); }
+        static Value flipSign(Value a, Value signs) { return _mm256_xor_pd(a, signs); }
+        static Value floor(Value a) { return _mm256_floor_pd(a); }
+    };
+    const char* instructionSet = "AVX2";
+#elif defined(PERLIN_SSE2)
+    struct Lanes {
+        static const int COUNT = 2;
+        typedef __m128d Value;
+        static Value load(const double* p) { return _mm_loadu_pd(p); }
+        static void store(double* p, Value a) { _mm_storeu_pd(p, a); }
+        static Value set1(double a) { return _mm_set1_pd(a); }
+        static Value lookup(const double* table, const int* index) {
+            return _mm_set_pd(table[index[1]], table[index[0]]);
+        }
+        static Value add(Value a, Value b) { return _mm_add_pd(a, b); }
+        static Value sub(Value a, Value b) { return _mm_sub_pd(a, b); }
+        static Value mul(Value a, Value b) { return _mm_mul_pd(a, b); }
+        static Value div(Value a, Value b) { return _mm_div_pd(a, b); }
+        static Value flipSign(Value a, Value signs) { return _mm_xor_pd(a, signs); }
+        // SSE2 has no floor: truncate, then step down where that rounded up
+        static Value floor(Value a) {
+            Value truncated = _mm_cvtepi32_pd(_mm_cvttpd_epi32(a));
+            return _mm_sub_pd(truncated, _mm_and_pd(_mm_cmpgt_pd(truncated, a), _mm_set1_pd(1.0)));
+        }
+    };
+    const char* instructionSet = "SSE2";
+#else
+    struct Lanes {
+        static const int COUNT = 1;
+        typedef double Value;
+        static Value load(const double* p) { return *p; }
+        static void store(double* p, Value a) { *p = a; }
+        static Value set1(double a) { return a; }
+        static Value lookup(const double* table, const int* index) { return table[index[0]]; }
+        static Value add(Value a, Value b) { return a + b; }
+        static Value sub(Value a, Value b) { return a - b; }
+        static Value mul(Value a, Value b) { return a * b; }
+        static Value div(Value a, Value b) { return a / b; }
+        static Value flipSign(Value a, Value signs) { return std::signbit(signs) ? -a : a; }
+        static Value floor(Value a) { return std::floor(a); }
+    };
+    const char* instructionSet = "scalar";
+#endif
+
+    // grad() as sign flips: hash & 3 picks x + y, -x + y, y - x or -x - y
+    const double gradSignX[4] = { 0.0, -0.0, -0.0, -0.0 };
+    const double gradSignY[4] = { 0.0, 0.0, 0.0, -0.0 };
+
+    Lanes::Value fadeLanes(Lanes::Value t) {
+        Lanes::Value cube = Lanes::mul(Lanes::mul(t, t), t);
+        Lanes::Value inner = Lanes::add(Lanes::mul(Lanes::sub(Lanes::mul(t, Lanes::set1(6.0)), Lanes::set1(15.0)), t), Lanes::set1(10.0));
+        return Lanes::mul(cube, inner);
+    }
 
+    Lanes::Value lerpLanes(Lanes::Value t, Lanes::Value a, Lanes::Value b) {
+        return Lanes::add(a, Lanes::mul(t, Lanes::sub(b, a)));
+    }
+}
+
+PerlinNoise::PerlinNoise(unsigned int seed) {
     // Fill with values 0-255
     std::vector<int> p(256);
     std::iota(p.begin(), p.end(), 0);
@@ -14,7 +95,7 @@ PerlinNoise::PerlinNoise(unsigned int seed) {
 
     // Duplicate for wrapping
     for (int i = 0; i < 256; i++) {
-        permutation[i] = permutation[i + 256] = p[i];
+        permutation[i] = permutation[i + 256] = static_cast<uint8_t>(p[i]);
     }
 }
 
@@ -64,6 +145,160 @@ double PerlinNoise::fractalNoise(double x, double y, int octaves, double persist
     return value / maxValue; // Normalize to [-1, 1]
 }
 
+double PerlinNoise::noise3D(double x, double y, double z) {
+    // Find unit cube containing point
+    int X = (int)floor(x) & 255;
+    int Y = (int)floor(y) & 255;
+    int Z = (int)floor(z) & 255;
+
+    x -= floor(x);
+    y -= floor(y);
+    z -= floor(z);
+
+    double u = fade(x);
+    double v = fade(y);
+    double w = fade(z);
+
+    // Hash coordinates of the 8 cube corners
+    int A = permutation[X] + Y;
+    int AA = permutation[A] + Z;
+    int AB = permutation[A + 1] + Z;
+    int B = permutation[X + 1] + Y;
+    int BA = permutation[B] + Z;
+    int BB = permutation[B + 1] + Z;
+
+    return lerp(w,
+        lerp(v,
+            lerp(u, grad(permutation[AA], x, y, z), grad(permutation[BA], x - 1, y, z)),
+            lerp(u, grad(permutation[AB], x, y - 1, z), grad(permutation[BB], x - 1, y - 1, z))),
+        lerp(v,
+            lerp(u, grad(permutation[AA + 1], x, y, z - 1), grad(permutation[BA + 1], x - 1, y, z - 1)),
+            lerp(u, grad(permutation[AB + 1], x, y - 1, z - 1), grad(permutation[BB + 1], x - 1, y - 1, z - 1)))
+    );
+}
+
+double PerlinNoise::fractalNoise3D(double x, double y, double z, int octaves, double persistence, double scale) {
+    double value = 0.0;
+    double amplitude = 1.0;
+    double frequency = scale;
+    double maxValue = 0.0;
+
+    for (int i = 0; i < octaves; i++) {
+        value += noise3D(x * frequency, y * frequency, z * frequency) * amplitude;
+        maxValue += amplitude;
+        amplitude *= persistence;
+        frequency *= 2.0;
+    }
+
+    return value / maxValue;
+}
+
+void PerlinNoise::fractalNoiseGrid(double* out, int width, int height, double x0, double y0, double spacing,
+    int octaves, double persistence, double scale) {
+    const int lanes = Lanes::COUNT;
+    const int vectorWidth = width - width % lanes;
+
+    double maxValue = 0.0;
+    double amplitude = 1.0;
+    for (int i = 0; i < octaves; i++) {
+        maxValue += amplitude;
+        amplitude *= persistence;
+    }
+
+    // Everything that depends on x alone is the same for every row, work it out once per octave:
+    // the position within the cell, its fade curve and the first permutation lookups
+    std::vector<double> cellX(octaves * vectorWidth), fadeX(octaves * vectorWidth);
+    std::vector<int> hashA(octaves * vectorWidth), hashB(octaves * vectorWidth);
+    std::vector<double> floorX(lanes);
+    double frequency = scale;
+    for (int i = 0; i < octaves; i++) {
+        for (int col = 0; col < vectorWidth; col += lanes) {
+            double columns[lanes];
+            for (int lane = 0; lane < lanes; lane++) {
+                columns[lane] = (x0 + col + lane) * spacing;
+            }
+            Lanes::Value x = Lanes::mul(Lanes::load(columns), Lanes::set1(frequency));
+            Lanes::Value cellFloor = Lanes::floor(x);
+            x = Lanes::sub(x, cellFloor);
+            Lanes::store(&cellX[i * vectorWidth + col], x);
+            Lanes::store(&fadeX[i * vectorWidth + col], fadeLanes(x));
+            Lanes::store(&floorX[0], cellFloor);
+            for (int lane = 0; lane < lanes; lane++) {
+                int X = (int)floorX[lane] & 255;
+                hashA[i * vectorWidth + col + lane] = permutation[X];
+                hashB[i * vectorWidth + col + lane] = permutation[X + 1];
+            }
+        }
+        frequency *= 2.0;
+    }
+
+    for (int row = 0; row < height; row++) {
+        double* values = out + row * width;
+        double rowY = (y0 + row) * spacing;
+
+        for (int col = 0; col < vectorWidth; col += lanes) {
+            Lanes::Value value = Lanes::set1(0.0);
+            amplitude = 1.0;
+            frequency = scale;
+
+            for (int i = 0; i < octaves; i++) {
+                // y is the same across the row, only x needs lanes
+                double y = rowY * frequency;
+                double floorY = std::floor(y);
+                int Y = (int)floorY & 255;
+                y -= floorY;
+                Lanes::Value v = Lanes::set1(fade(y));
+                Lanes::Value yLanes = Lanes::set1(y);
+                Lanes::Value yMinusOne = Lanes::set1(y - 1);
+
+                int offset = i * vectorWidth + col;
+                Lanes::Value x = Lanes::load(&cellX[offset]);
+                Lanes::Value u = Lanes::load(&fadeX[offset]);
+                Lanes::Value xMinusOne = Lanes::sub(x, Lanes::set1(1.0));
+
+                // Byte table lookups don't vectorize, the hash chain runs per lane
+                int corners[4][lanes];
+                for (int lane = 0; lane < lanes; lane++) {
+                    int A = hashA[offset + lane] + Y;
+                    int B = hashB[offset + lane] + Y;
+                    corners[0][lane] = permutation[permutation[A]] & 3;
+                    corners[1][lane] = permutation[permutation[B]] & 3;
+                    corners[2][lane] = permutation[permutation[A + 1]] & 3;
+                    corners[3][lane] = permutation[permutation[B + 1]] & 3;
+                }
+
+                Lanes::Value gradAA = Lanes::add(Lanes::flipSign(x, Lanes::lookup(gradSignX, corners[0])),
+                    Lanes::flipSign(yLanes, Lanes::lookup(gradSignY, corners[0])));
+                Lanes::Value gradBA = Lanes::add(Lanes::flipSign(xMinusOne, Lanes::lookup(gradSignX, corners[1])),
+                    Lanes::flipSign(yLanes, Lanes::lookup(gradSignY, corners[1])));
+                Lanes::Value gradAB = Lanes::add(Lanes::flipSign(x, Lanes::lookup(gradSignX, corners[2])),
+                    Lanes::flipSign(yMinusOne, Lanes::lookup(gradSignY, corners[2])));
+                Lanes::Value gradBB = Lanes::add(Lanes::flipSign(xMinusOne, Lanes::lookup(gradSignX, corners[3])),
+                    Lanes::flipSign(yMinusOne, Lanes::lookup(gradSignY, corners[3])));
+                Lanes::Value noise = lerpLanes(v, lerpLanes(u, gradAA, gradBA), lerpLanes(u, gradAB, gradBB));
+
+                value = Lanes::add(value, Lanes::mul(noise, Lanes::set1(amplitude)));
+                amplitude *= persistence;
+                frequency *= 2.0;
+            }
+
+            Lanes::store(values + col, Lanes::div(value, Lanes::set1(maxValue)));
+        }
+
+        for (int col = vectorWidth; col < width; col++) {
+            values[col] = fractalNoise((x0 + col) * spacing, rowY, octaves, persistence, scale);
+        }
+    }
+}
+
+const char* PerlinNoise::gridInstructionSet() {
+    return instructionSet;
+}
+
+int PerlinNoise::gridLanes() {
+    return Lanes::COUNT;
+}
+
 double PerlinNoise::fade(double t) {
     // Smoothstep function: 6t^5 - 15t^4 + 10t^3
     return t * t * t * (t * (t * 6 - 15) + 10);
@@ -79,4 +314,12 @@ double PerlinNoise::grad(int hash, double x, double y) {
     double u = h < 2 ? x : y;
     double v = h < 2 ? y : x;
     return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+}
+
+double PerlinNoise::grad(int hash, double x, double y, double z) {
+    // One of 12 gradient directions, the edges of a cube
+    int h = hash & 15;
+    double u = h < 8 ? x : y;
+    double v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 }
\ No newline at end of file
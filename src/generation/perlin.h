@@ -6,6 +6,7 @@
 #include <cmath>
 #include <algorithm>
 #include <numeric>
+#include <cstdint>
 
 class PerlinNoise {
 public:
@@ -18,13 +19,29 @@ public:
     // Get fractal noise (multiple octaves combined)
     double fractalNoise(double x, double y, int octaves = 4, double persistence = 0.5, double scale = 1.0);
 
+    // 3D noise and its fractal sum, for density fields
+    double noise3D(double x, double y, double z);
+    double fractalNoise3D(double x, double y, double z, int octaves = 4, double persistence = 0.5, double scale = 1.0);
+
+    // Fractal noise for a whole width x height grid at once, several columns per SIMD instruction.
+    // out[row * width + col] gets fractalNoise((x0 + col) * spacing, (y0 + row) * spacing, ...),
+    // bit for bit the same as the scalar call.
+    void fractalNoiseGrid(double* out, int width, int height, double x0, double y0, double spacing,
+        int octaves = 4, double persistence = 0.5, double scale = 1.0);
+
+    // Instruction set fractalNoiseGrid was compiled for, and how many doubles it works on at once
+    static const char* gridInstructionSet();
+    static int gridLanes();
+
 private:
-    std::vector<int> permutation;
+    // 256 shuffled values twice over, so permutation[i + 1] never needs wrapping
+    uint8_t permutation[512];
 
     // Helper functions
     double fade(double t);
     double lerp(double t, double a, double b);
     double grad(int hash, double x, double y);
+    double grad(int hash, double x, double y, double z);
 };
 
 #endif
\ No newline at end of file
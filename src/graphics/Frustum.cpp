@@ -0,0 +1,98 @@
+#include "Frustum.h"
+
+void AabbList::clear() {
+	minX.clear(); minY.clear(); minZ.clear();
+	maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+void AabbList::push(const glm::vec3& min, const glm::vec3& max) {
+	minX.push_back(min.x); minY.push_back(min.y); minZ.push_back(min.z);
+	maxX.push_back(max.x); maxY.push_back(max.y); maxZ.push_back(max.z);
+}
+
+Frustum::Frustum() {
+	for (int i = 0; i < NO_PLANES; i++) {
+		nx[i] = ny[i] = nz[i] = 0.0f;
+		d[i] = 1.0f;
+	}
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+	update(viewProjection);
+}
+
+void Frustum::update(const glm::mat4& viewProjection) {
+	// Gribb/Hartmann: each plane is the last row of the matrix plus or minus one of the others.
+	// glm is column major, so row r is (m[0][r], m[1][r], m[2][r], m[3][r]).
+	const glm::mat4& m = viewProjection;
+	glm::vec4 row[4];
+	for (int r = 0; r < 4; r++) {
+		row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+	}
+
+	glm::vec4 planes[NO_PLANES] = {
+		row[3] + row[0],	// left
+		row[3] - row[0],	// right
+		row[3] + row[1],	// bottom
+		row[3] - row[1],	// top
+		row[3] + row[2],	// near
+		row[3] - row[2]		// far
+	};
+
+	for (int i = 0; i < NO_PLANES; i++) {
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f) {
+			planes[i] /= length;
+		}
+		nx[i] = planes[i].x;
+		ny[i] = planes[i].y;
+		nz[i] = planes[i].z;
+		d[i] = planes[i].w;
+	}
+}
+
+bool Frustum::intersects(const glm::vec3& min, const glm::vec3& max) const {
+	for (int i = 0; i < NO_PLANES; i++) {
+		// the box corner furthest along the plane normal
+		float px = nx[i] >= 0.0f ? max.x : min.x;
+		float py = ny[i] >= 0.0f ? max.y : min.y;
+		float pz = nz[i] >= 0.0f ? max.z : min.z;
+		if (nx[i] * px + ny[i] * py + nz[i] * pz + d[i] < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t Frustum::testBoxes(const AabbList& boxes, std::vector<uint8_t>& visible) const {
+	size_t count = boxes.size();
+	visible.assign(count, 1);
+
+	const float* minX = boxes.minX.data();
+	const float* minY = boxes.minY.data();
+	const float* minZ = boxes.minZ.data();
+	const float* maxX = boxes.maxX.data();
+	const float* maxY = boxes.maxY.data();
+	const float* maxZ = boxes.maxZ.data();
+	uint8_t* out = visible.data();
+
+	// Planes on the outside so the inner loop is branch free over consecutive boxes
+	// and the compiler can vectorise it
+	for (int p = 0; p < NO_PLANES; p++) {
+		const float a = nx[p], b = ny[p], c = nz[p], w = d[p];
+		const bool posX = a >= 0.0f, posY = b >= 0.0f, posZ = c >= 0.0f;
+		const float* px = posX ? maxX : minX;
+		const float* py = posY ? maxY : minY;
+		const float* pz = posZ ? maxZ : minZ;
+		for (size_t i = 0; i < count; i++) {
+			float dist = a * px[i] + b * py[i] + c * pz[i] + w;
+			out[i] &= static_cast<uint8_t>(dist >= 0.0f);
+		}
+	}
+
+	size_t noVisible = 0;
+	for (size_t i = 0; i < count; i++) {
+		noVisible += out[i];
+	}
+	return noVisible;
+}
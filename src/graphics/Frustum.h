@@ -0,0 +1,39 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Axis aligned boxes in structure of arrays layout, so the frustum test can run
+// over consecutive boxes in vector registers
+struct AabbList {
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	void clear();
+	void push(const glm::vec3& min, const glm::vec3& max);
+	size_t size() const { return minX.size(); }
+};
+
+// The six planes of a view-projection matrix, also stored as structure of arrays.
+// Plane normals point into the frustum.
+class Frustum {
+public:
+	static const int NO_PLANES = 6;
+
+	Frustum();
+	Frustum(const glm::mat4& viewProjection);
+
+	void update(const glm::mat4& viewProjection);
+
+	// False only if the box is completely outside one of the planes
+	bool intersects(const glm::vec3& min, const glm::vec3& max) const;
+	// visible[i] = 1 if box i intersects, returns the number of visible boxes
+	size_t testBoxes(const AabbList& boxes, std::vector<uint8_t>& visible) const;
+
+private:
+	float nx[NO_PLANES], ny[NO_PLANES], nz[NO_PLANES], d[NO_PLANES];
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "Model.h"
 #include "../physics/Environment.h"
+#include "TextureCache.h"
 
 //Model::Model() {}
 
@@ -33,6 +34,10 @@ void Model::cleanup() {
 	for (Mesh mesh : meshes) {
 		mesh.clearnup();
 	}
+	for (Texture& texture : textures_loaded) {
+		TextureCache::release(texture);
+	}
+	textures_loaded.clear();
 }
 
 void Model::loadModel(std::string path) {
@@ -135,8 +140,7 @@ std::vector<Texture> Model::loadTextures(aiMaterial* mat, aiTextureType type) {
 			}
 		}
 		if (!skip) {
-			Texture texture(directory, str.C_Str(), type);
-			texture.load();
+			Texture texture = TextureCache::acquire(directory, str.C_Str(), type);
 			textures.push_back(texture);
 			textures_loaded.push_back(texture);
 		}
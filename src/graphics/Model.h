@@ -37,6 +37,7 @@ protected:
 	std::vector<Mesh> meshes;
 	std::string directory;
 
+	// One TextureCache reference per distinct texture, released in cleanup()
 	std::vector<Texture> textures_loaded;
 
 	void processNode(aiNode* node, const aiScene* scene);
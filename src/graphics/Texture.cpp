@@ -14,7 +14,7 @@ void Texture::generate() {
 }
 void Texture::load(bool flip) {
     stbi_set_flip_vertically_on_load(true);
-    int width, height, nChannels;
+    int nChannels;
 
 
     unsigned char* data = stbi_load((dir + "/" + path).c_str(), &width, &height, &nChannels, 3);
@@ -32,6 +32,7 @@ void Texture::load(bool flip) {
     }
     else {
         std::cout << "Image not loaded at " << path << std::endl;
+        width = height = 0;
     }
 
     stbi_image_free(data);
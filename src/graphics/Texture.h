@@ -20,6 +20,9 @@ public:
 	aiTextureType type;
 	std::string path;
 	std::string dir;
+	// size of the loaded image, 0 until load() succeeds
+	int width = 0;
+	int height = 0;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "TextureArray.h"
+
+#include <iostream>
+
+TextureArray::TextureArray() : id(0), width(0), height(0), layers(0) {}
+
+bool TextureArray::load(const std::string& dir, const std::vector<std::string>& paths) {
+	stbi_set_flip_vertically_on_load(true);
+
+	// decode everything first so a bad image doesn't leave a half filled array
+	std::vector<unsigned char*> images;
+	bool ok = !paths.empty();
+	for (size_t i = 0; i < paths.size() && ok; i++) {
+		int w, h, nChannels;
+		unsigned char* data = stbi_load((dir + "/" + paths[i]).c_str(), &w, &h, &nChannels, 3);
+		if (!data) {
+			std::cout << "Image not loaded at " << paths[i] << std::endl;
+			ok = false;
+			break;
+		}
+		if (i == 0) {
+			width = w;
+			height = h;
+		}
+		else if (w != width || h != height) {
+			std::cout << "Texture array layer " << paths[i] << " is " << w << "x" << h
+				<< ", expected " << width << "x" << height << std::endl;
+			ok = false;
+		}
+		images.push_back(data);
+	}
+
+	if (ok) {
+		layers = static_cast<int>(paths.size());
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, width, height, layers, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+		for (int i = 0; i < layers; i++) {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, images[i]);
+		}
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	else {
+		width = height = layers = 0;
+	}
+
+	for (unsigned char* data : images) {
+		stbi_image_free(data);
+	}
+	return ok;
+}
+
+void TextureArray::bind() {
+	glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+}
+
+void TextureArray::cleanup() {
+	if (id != 0) {
+		glDeleteTextures(1, &id);
+		id = 0;
+	}
+	width = height = layers = 0;
+}
+
+size_t TextureArray::memoryUsage() const {
+	size_t base = static_cast<size_t>(width) * height * layers * 4;
+	return base + base / 3;
+}
@@ -0,0 +1,31 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stb/stb_image.h>
+
+#include <string>
+#include <vector>
+
+// GL_TEXTURE_2D_ARRAY with one image per layer, sampled in shaders with
+// sampler2DArray and a layer index. Every image has to be the size of the first.
+class TextureArray {
+public:
+	TextureArray();
+
+	// Returns false and leaves the array empty if an image is missing or has the wrong size
+	bool load(const std::string& dir, const std::vector<std::string>& paths);
+	void bind();
+	void cleanup();
+
+	// Approximate GPU bytes, RGBA8 with a full mip chain
+	size_t memoryUsage() const;
+
+	unsigned int id;
+	int width;
+	int height;
+	int layers;
+};
+
+#endif
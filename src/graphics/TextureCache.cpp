@@ -0,0 +1,63 @@
+#include "TextureCache.h"
+
+#include <iostream>
+
+std::unordered_map<std::string, TextureCache::Entry> TextureCache::entries;
+size_t TextureCache::loads = 0;
+size_t TextureCache::hits = 0;
+
+std::string TextureCache::keyOf(const std::string& dir, const std::string& path) {
+	return dir + "/" + path;
+}
+
+Texture TextureCache::acquire(const std::string& dir, const std::string& path, aiTextureType type) {
+	std::string key = keyOf(dir, path);
+	auto it = entries.find(key);
+	if (it != entries.end()) {
+		it->second.refCount++;
+		hits++;
+		return it->second.texture;
+	}
+
+	Texture texture(dir, path, type);
+	texture.load();
+	loads++;
+
+	entries[key] = { texture, 1 };
+	return texture;
+}
+
+void TextureCache::release(const Texture& texture) {
+	auto it = entries.find(keyOf(texture.dir, texture.path));
+	if (it == entries.end()) {
+		std::cout << "Released texture that was not acquired: " << texture.path << std::endl;
+		return;
+	}
+
+	if (--it->second.refCount == 0) {
+		glDeleteTextures(1, &it->second.texture.id);
+		entries.erase(it);
+	}
+}
+
+size_t TextureCache::getTextureCount() {
+	return entries.size();
+}
+
+size_t TextureCache::getMemoryUsage() {
+	size_t bytes = 0;
+	for (const auto& pair : entries) {
+		size_t base = static_cast<size_t>(pair.second.texture.width) * pair.second.texture.height * 4;
+		// the mip chain adds a third on top of the base level
+		bytes += base + base / 3;
+	}
+	return bytes;
+}
+
+size_t TextureCache::getLoadCount() {
+	return loads;
+}
+
+size_t TextureCache::getHitCount() {
+	return hits;
+}
@@ -0,0 +1,40 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <string>
+#include <unordered_map>
+
+#include "Texture.h"
+
+// Process wide registry of loaded textures, keyed by dir + "/" + path.
+// acquire() decodes an image only the first time it is asked for and hands out
+// the same GL texture afterwards; every acquire must be paired with a release,
+// and the GL texture is deleted when the last reference goes.
+// Only call from the thread that owns the GL context.
+class TextureCache {
+public:
+	static Texture acquire(const std::string& dir, const std::string& path, aiTextureType type = aiTextureType_DIFFUSE);
+	static void release(const Texture& texture);
+
+	// Textures currently resident
+	static size_t getTextureCount();
+	// Approximate GPU bytes of the resident textures, RGBA8 with a full mip chain
+	static size_t getMemoryUsage();
+	// Image decodes done and acquires served without one, since startup
+	static size_t getLoadCount();
+	static size_t getHitCount();
+
+private:
+	struct Entry {
+		Texture texture;
+		int refCount;
+	};
+
+	static std::unordered_map<std::string, Entry> entries;
+	static size_t loads;
+	static size_t hits;
+
+	static std::string keyOf(const std::string& dir, const std::string& path);
+};
+
+#endif
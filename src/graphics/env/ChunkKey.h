@@ -0,0 +1,34 @@
+#ifndef CHUNKKEY_H
+#define CHUNKKEY_H
+
+#include <glm/glm.hpp>
+
+// Chunk coordinates packed into one 64 bit key, 21 bits per axis: enough for a
+// million chunks either way. Used by everything that maps or stores chunks by key.
+const int CHUNK_KEY_BITS = 21;
+const long long CHUNK_KEY_MASK = (1LL << CHUNK_KEY_BITS) - 1;
+
+inline long long packChunkKey(int chunkX, int chunkY, int chunkZ) {
+	return ((static_cast<long long>(chunkX) & CHUNK_KEY_MASK) << (2 * CHUNK_KEY_BITS)) |
+		((static_cast<long long>(chunkY) & CHUNK_KEY_MASK) << CHUNK_KEY_BITS) |
+		(static_cast<long long>(chunkZ) & CHUNK_KEY_MASK);
+}
+
+inline glm::ivec3 unpackChunkKey(long long key) {
+	// sign extends one field
+	auto field = [key](int shift) {
+		long long value = (key >> shift) & CHUNK_KEY_MASK;
+		if (value & (1LL << (CHUNK_KEY_BITS - 1))) {
+			value -= (1LL << CHUNK_KEY_BITS);
+		}
+		return static_cast<int>(value);
+	};
+	return glm::ivec3(field(2 * CHUNK_KEY_BITS), field(CHUNK_KEY_BITS), field(0));
+}
+
+// Division rounding towards negative infinity, for block to chunk or region coordinates
+inline int floorDiv(int value, int divisor) {
+	return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include "ChunkPipeline.h"
+#include "ChunkKey.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+	ChunkStage nextStage(ChunkStage stage) {
+		return static_cast<ChunkStage>(static_cast<int>(stage) + 1);
+	}
+
+	// Stage every neighbour in the pipeline must have finished before a chunk may start
+	// the given one. Features reach a couple of blocks sideways and a tree's height up,
+	// so they can land in any of the 26 chunks around their own. Sky light comes from
+	// above, so the chunk above has to be lit first.
+	struct NeighborRule {
+		ChunkStage stage;
+		bool diagonals;
+		// stage the chunk straight above must have finished, on top of the above
+		ChunkStage above;
+	};
+
+	NeighborRule ruleFor(ChunkStage stage) {
+		switch (stage) {
+		case ChunkStage::LIGHT: return { ChunkStage::FEATURES, true, ChunkStage::LIGHT };
+		case ChunkStage::MESH:  return { ChunkStage::LIGHT, false, ChunkStage::LIGHT };
+		default:                return { ChunkStage::QUEUED, false, ChunkStage::QUEUED };
+		}
+	}
+
+	// Stages that start by themselves as soon as they're allowed to
+	bool startsWhenReady(ChunkStage stage) {
+		return stage == ChunkStage::FEATURES || stage == ChunkStage::LIGHT || stage == ChunkStage::MESH;
+	}
+}
+
+ChunkPipeline::ChunkPipeline()
+	: m_uploaded(0),
+	m_totalLatencyMs(0.0) {
+}
+
+const char* ChunkPipeline::stageName(ChunkStage stage) {
+	switch (stage) {
+	case ChunkStage::QUEUED:   return "queued";
+	case ChunkStage::TERRAIN:  return "terrain";
+	case ChunkStage::FEATURES: return "features";
+	case ChunkStage::LIGHT:    return "light";
+	case ChunkStage::MESH:     return "mesh";
+	case ChunkStage::UPLOAD:   return "upload";
+	default:                   return "?";
+	}
+}
+
+bool ChunkPipeline::add(long long key, std::shared_ptr<ChunkJob> job) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_entries.count(key)) {
+		return false;
+	}
+	Entry& entry = m_entries[key];
+	entry.job = std::move(job);
+	entry.added = std::chrono::steady_clock::now();
+	addWaiting(ChunkStage::TERRAIN);
+	return true;
+}
+
+bool ChunkPipeline::contains(long long key) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.count(key) > 0;
+}
+
+std::shared_ptr<ChunkJob> ChunkPipeline::start(long long key, ChunkStage stage) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end() || it->second.running || nextStage(it->second.done) != stage) {
+		return nullptr;
+	}
+	it->second.running = true;
+	m_stages[static_cast<int>(stage)].waiting--;
+	m_stages[static_cast<int>(stage)].running++;
+	return it->second.job;
+}
+
+void ChunkPipeline::complete(long long key, ChunkStage stage, double ms, std::vector<Ready>& ready) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end()) {
+		return;
+	}
+
+	StageCounters& counters = m_stages[static_cast<int>(stage)];
+	counters.running--;
+	counters.completed++;
+	counters.totalMs += ms;
+	counters.lastMs = ms;
+
+	if (stage == ChunkStage::UPLOAD) {
+		m_totalLatencyMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - it->second.added).count();
+		m_uploaded++;
+		m_entries.erase(it);
+	}
+	else {
+		it->second.done = stage;
+		it->second.running = false;
+		addWaiting(nextStage(stage));
+	}
+	collectReady(unpackChunkKey(key), ready);
+}
+
+void ChunkPipeline::remove(long long key, std::vector<Ready>& ready) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end()) {
+		return;
+	}
+	StageCounters& counters = m_stages[static_cast<int>(nextStage(it->second.done))];
+	if (it->second.running) {
+		counters.running--;
+	}
+	else {
+		counters.waiting--;
+	}
+	m_entries.erase(it);
+	collectReady(unpackChunkKey(key), ready);
+}
+
+void ChunkPipeline::clear() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.clear();
+	for (StageCounters& counters : m_stages) {
+		counters.waiting = 0;
+		counters.running = 0;
+	}
+}
+
+size_t ChunkPipeline::size() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
+
+ChunkStageStats ChunkPipeline::getStats(ChunkStage stage) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const StageCounters& counters = m_stages[static_cast<int>(stage)];
+	ChunkStageStats stats;
+	stats.waiting = counters.waiting;
+	stats.peakWaiting = counters.peakWaiting;
+	stats.running = counters.running;
+	stats.completed = counters.completed;
+	stats.averageMs = counters.completed > 0 ? counters.totalMs / counters.completed : 0.0;
+	stats.lastMs = counters.lastMs;
+	return stats;
+}
+
+double ChunkPipeline::getAverageLatencyMs() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_uploaded > 0 ? m_totalLatencyMs / m_uploaded : 0.0;
+}
+
+void ChunkPipeline::addWaiting(ChunkStage stage) {
+	StageCounters& counters = m_stages[static_cast<int>(stage)];
+	counters.waiting++;
+	counters.peakWaiting = std::max(counters.peakWaiting, counters.waiting);
+}
+
+bool ChunkPipeline::neighborsReady(glm::ivec3 coords, ChunkStage stage) const {
+	NeighborRule rule = ruleFor(stage);
+	if (rule.stage == ChunkStage::QUEUED) {
+		return true;
+	}
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				int steps = std::abs(dx) + std::abs(dy) + std::abs(dz);
+				if (steps == 0 || (!rule.diagonals && steps > 1)) continue;
+				auto it = m_entries.find(packChunkKey(coords.x + dx, coords.y + dy, coords.z + dz));
+				ChunkStage needed = (dx == 0 && dy == 1 && dz == 0) ? std::max(rule.stage, rule.above) : rule.stage;
+				if (it != m_entries.end() && it->second.done < needed) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void ChunkPipeline::collectReady(glm::ivec3 coords, std::vector<Ready>& ready) {
+	// a finished stage only ever unblocks the chunk itself and the ones around it
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dz = -1; dz <= 1; dz++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				glm::ivec3 candidate = coords + glm::ivec3(dx, dy, dz);
+				auto it = m_entries.find(packChunkKey(candidate.x, candidate.y, candidate.z));
+				if (it == m_entries.end() || it->second.running) continue;
+
+				ChunkStage stage = nextStage(it->second.done);
+				if (!startsWhenReady(stage) || !neighborsReady(candidate, stage)) continue;
+
+				it->second.running = true;
+				m_stages[static_cast<int>(stage)].waiting--;
+				m_stages[static_cast<int>(stage)].running++;
+				ready.push_back(Ready{ stage, it->second.job });
+			}
+		}
+	}
+}
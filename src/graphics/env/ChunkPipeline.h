@@ -0,0 +1,113 @@
+#ifndef CHUNKPIPELINE_H
+#define CHUNKPIPELINE_H
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// Defined by World, whatever a chunk's stages build
+struct ChunkJob;
+
+// Stages a chunk goes through between being requested and being drawn, in order
+enum class ChunkStage : uint8_t {
+	QUEUED,		// requested, waiting in the load queue
+	TERRAIN,	// generated, or loaded from a region file
+	FEATURES,	// its own features grown, what they place in other chunks queued
+	LIGHT,		// the features of the chunks around it and the player's edits merged in, voxels final and lit
+	MESH,
+	UPLOAD		// on the GPU, the chunk is loaded and leaves the pipeline
+};
+
+const int CHUNK_STAGE_COUNT = 6;
+
+struct ChunkStageStats {
+	// Finished with the stage before and not started: waiting on neighbours, the load
+	// queue or the upload budget
+	size_t waiting = 0;
+	size_t peakWaiting = 0;
+	size_t running = 0;
+	size_t completed = 0;
+	double averageMs = 0.0;
+	double lastMs = 0.0;
+};
+
+// Per-chunk state machine for the chunks on their way to being loaded.
+//
+// A chunk runs one stage at a time. TERRAIN starts in load queue order and UPLOAD
+// within the frame's upload budget; the stages in between start as soon as the chunk
+// and its neighbours are far enough along: LIGHT once every neighbour in the pipeline,
+// diagonals included, has its features out, so nothing more will be written into the
+// chunk, and the chunk above is lit, so sky light comes down from the top of the world
+// in one pass; MESH once the six face neighbours have final voxels, light and borders.
+// Chunks that aren't in the pipeline are either loaded or not wanted and never hold
+// anyone up.
+//
+// Thread safe. complete() and remove() hand back the stages their change made ready,
+// already marked running, for the caller to submit.
+class ChunkPipeline {
+public:
+	struct Ready {
+		ChunkStage stage;
+		std::shared_ptr<ChunkJob> job;
+	};
+
+	ChunkPipeline();
+
+	// Starts tracking a chunk at QUEUED, false if it already is
+	bool add(long long key, std::shared_ptr<ChunkJob> job);
+	bool contains(long long key);
+	// For the stages that don't start on their own: marks the chunk's next stage running,
+	// null if the chunk was dropped or isn't at the stage before
+	std::shared_ptr<ChunkJob> start(long long key, ChunkStage stage);
+	// The stage ran in ms; after UPLOAD the chunk leaves the pipeline
+	void complete(long long key, ChunkStage stage, double ms, std::vector<Ready>& ready);
+	// Drops a chunk that went stale, its neighbours may not have to wait for it any more
+	void remove(long long key, std::vector<Ready>& ready);
+	void clear();
+
+	size_t size();
+	ChunkStageStats getStats(ChunkStage stage);
+	// From add to the end of UPLOAD
+	double getAverageLatencyMs();
+
+	static const char* stageName(ChunkStage stage);
+
+private:
+	struct Entry {
+		std::shared_ptr<ChunkJob> job;
+		// Last stage finished
+		ChunkStage done = ChunkStage::QUEUED;
+		bool running = false;
+		std::chrono::steady_clock::time_point added;
+	};
+
+	struct StageCounters {
+		size_t waiting = 0;
+		size_t peakWaiting = 0;
+		size_t running = 0;
+		size_t completed = 0;
+		double totalMs = 0.0;
+		double lastMs = 0.0;
+	};
+
+	std::mutex m_mutex;
+	std::unordered_map<long long, Entry> m_entries;
+	std::array<StageCounters, CHUNK_STAGE_COUNT> m_stages;
+	size_t m_uploaded;
+	double m_totalLatencyMs;
+
+	// Called with the lock held
+	void addWaiting(ChunkStage stage);
+	bool neighborsReady(glm::ivec3 coords, ChunkStage stage) const;
+	// Starts the next stage of the chunk and its neighbours wherever that became possible
+	void collectReady(glm::ivec3 coords, std::vector<Ready>& ready);
+};
+
+#endif
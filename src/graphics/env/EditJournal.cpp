@@ -0,0 +1,207 @@
+#include "EditJournal.h"
+#include "ChunkKey.h"
+#include "RegionFile.h"
+
+#include <iostream>
+#include <vector>
+
+namespace {
+	// Compact once the file is this many records long and at least twice the live deltas
+	const size_t compactMinRecords = 4096;
+	const size_t compactRatio = 2;
+
+	std::string parentDirectory(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash);
+	}
+}
+
+EditJournal::EditJournal(const std::string& path)
+	: m_path(path),
+	m_deltaCount(0),
+	m_file(nullptr),
+	m_unflushed(false),
+	m_recordsInFile(0),
+	m_compactions(0) {
+	replay();
+}
+
+EditJournal::~EditJournal() {
+	if (m_file) {
+		std::fclose(m_file);
+	}
+}
+
+void EditJournal::replay() {
+	FILE* file = std::fopen(m_path.c_str(), "rb");
+	// a compaction that got as far as writing the new journal but not moving it into place
+	if (!file && RegionFile::replaceFile(m_path + ".tmp", m_path)) {
+		std::cout << "Recovered " << m_path << " from an interrupted compaction" << std::endl;
+		file = std::fopen(m_path.c_str(), "rb");
+	}
+	if (!file) {
+		return;
+	}
+
+	std::vector<uint8_t> bytes;
+	uint8_t buffer[4096 * RECORD_BYTES];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		bytes.insert(bytes.end(), buffer, buffer + read);
+	}
+	std::fclose(file);
+
+	size_t records = bytes.size() / RECORD_BYTES;
+	for (size_t r = 0; r < records; r++) {
+		const uint8_t* p = &bytes[r * RECORD_BYTES];
+		long long key = 0;
+		for (int b = 0; b < 8; b++) {
+			key |= static_cast<long long>(p[b]) << (8 * b);
+		}
+		uint16_t index = static_cast<uint16_t>(p[8] | (p[9] << 8));
+		uint8_t type = p[10];
+		if (index >= ChunkStorage::VOLUME || type >= VOXEL_TYPE_COUNT) {
+			continue;
+		}
+		std::unordered_map<uint16_t, uint8_t>& chunk = m_deltas[key];
+		if (chunk.find(index) == chunk.end()) m_deltaCount++;
+		chunk[index] = type;
+	}
+	m_recordsInFile = records;
+
+	// a torn record at the end would shift every record appended after it
+	if (bytes.size() % RECORD_BYTES != 0) {
+		std::cout << "Dropping a partial record at the end of " << m_path << std::endl;
+		compact();
+	}
+}
+
+bool EditJournal::openForAppend() {
+	if (m_file) return true;
+	std::string directory = parentDirectory(m_path);
+	if (!directory.empty()) {
+		RegionFile::createDirectories(directory);
+	}
+	m_file = std::fopen(m_path.c_str(), "ab");
+	if (!m_file) {
+		std::cout << "Could not open " << m_path << " for writing" << std::endl;
+	}
+	return m_file != nullptr;
+}
+
+void EditJournal::writeRecord(FILE* file, long long key, uint16_t index, uint8_t type) {
+	uint8_t record[RECORD_BYTES];
+	for (int b = 0; b < 8; b++) {
+		record[b] = static_cast<uint8_t>(key >> (8 * b));
+	}
+	record[8] = static_cast<uint8_t>(index);
+	record[9] = static_cast<uint8_t>(index >> 8);
+	record[10] = type;
+	std::fwrite(record, 1, RECORD_BYTES, file);
+}
+
+void EditJournal::record(glm::ivec3 coords, glm::ivec3 local, VoxelType type) {
+	long long key = packChunkKey(coords.x, coords.y, coords.z);
+	uint16_t index = static_cast<uint16_t>(ChunkStorage::index(local.x, local.y, local.z));
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::unordered_map<uint16_t, uint8_t>& chunk = m_deltas[key];
+	if (chunk.find(index) == chunk.end()) m_deltaCount++;
+	chunk[index] = static_cast<uint8_t>(type);
+
+	if (openForAppend()) {
+		writeRecord(m_file, key, index, static_cast<uint8_t>(type));
+		m_recordsInFile++;
+		m_unflushed = true;
+	}
+}
+
+int EditJournal::apply(glm::ivec3 coords, ChunkStorage& voxels) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_deltas.find(packChunkKey(coords.x, coords.y, coords.z));
+	if (it == m_deltas.end()) {
+		return 0;
+	}
+	for (const auto& delta : it->second) {
+		int index = delta.first;
+		voxels.set(index % CHUNK_SIZE, index / (CHUNK_SIZE * CHUNK_SIZE), (index / CHUNK_SIZE) % CHUNK_SIZE,
+			static_cast<VoxelType>(delta.second));
+	}
+	return static_cast<int>(it->second.size());
+}
+
+bool EditJournal::hasEdits(glm::ivec3 coords) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_deltas.find(packChunkKey(coords.x, coords.y, coords.z)) != m_deltas.end();
+}
+
+bool EditJournal::hasEdit(glm::ivec3 coords, glm::ivec3 local) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_deltas.find(packChunkKey(coords.x, coords.y, coords.z));
+	return it != m_deltas.end() && it->second.count(static_cast<uint16_t>(ChunkStorage::index(local.x, local.y, local.z))) > 0;
+}
+
+void EditJournal::flush() {
+	bool bloated;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		bloated = m_recordsInFile >= compactMinRecords && m_recordsInFile > compactRatio * m_deltaCount;
+		if (!bloated && m_unflushed && m_file) {
+			std::fflush(m_file);
+			m_unflushed = false;
+		}
+	}
+	if (bloated) {
+		compact();
+	}
+}
+
+void EditJournal::compact() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_file) {
+		std::fclose(m_file);
+		m_file = nullptr;
+	}
+
+	std::string directory = parentDirectory(m_path);
+	if (!directory.empty()) {
+		RegionFile::createDirectories(directory);
+	}
+	std::string temporary = m_path + ".tmp";
+	FILE* file = std::fopen(temporary.c_str(), "wb");
+	if (!file) {
+		std::cout << "Could not compact " << m_path << std::endl;
+		return;
+	}
+	size_t records = 0;
+	for (const auto& chunk : m_deltas) {
+		for (const auto& delta : chunk.second) {
+			writeRecord(file, chunk.first, delta.first, delta.second);
+			records++;
+		}
+	}
+	if (std::fclose(file) != 0) {
+		std::cout << "Could not compact " << m_path << std::endl;
+		std::remove(temporary.c_str());
+		return;
+	}
+
+	// the old journal stays whole until the new one replaces it in one step
+	if (!RegionFile::replaceFile(temporary, m_path)) {
+		std::cout << "Could not replace " << m_path << std::endl;
+		std::remove(temporary.c_str());
+		return;
+	}
+	m_recordsInFile = records;
+	m_unflushed = false;
+	m_compactions++;
+}
+
+size_t EditJournal::getDeltaCount() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_deltaCount;
+}
+
+size_t EditJournal::getFileBytes() const {
+	return m_recordsInFile * RECORD_BYTES;
+}
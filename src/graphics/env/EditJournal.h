@@ -0,0 +1,72 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "../models/chunkstorage.hpp"
+
+// Block edits of one world stored as deltas over what the generator produces.
+//
+// Every record() appends { int64 chunk key, uint16 voxel index, uint8 type } to an
+// append-only journal file; the live deltas (latest type per voxel) are kept in
+// memory and applied on top of freshly generated chunks. A voxel edited many times
+// leaves many records behind, so once the file holds far more records than live
+// deltas it is compacted: rewritten with one record per delta.
+//
+// Records are buffered by stdio and reach the file on flush(). A record cut short
+// by a crash is ignored on the next start.
+class EditJournal {
+public:
+	// Replays the journal at path if there is one
+	explicit EditJournal(const std::string& path);
+	// Flushes and closes the journal
+	~EditJournal();
+
+	EditJournal(const EditJournal&) = delete;
+	EditJournal& operator=(const EditJournal&) = delete;
+
+	// Main thread. local is the voxel within the chunk at coords.
+	void record(glm::ivec3 coords, glm::ivec3 local, VoxelType type);
+	// Any thread: writes this chunk's deltas into freshly generated voxels, returns how many
+	int apply(glm::ivec3 coords, ChunkStorage& voxels);
+	bool hasEdits(glm::ivec3 coords);
+	bool hasEdit(glm::ivec3 coords, glm::ivec3 local);
+
+	// Main thread: pushes buffered records to the file, compacting it first if it got bloated
+	void flush();
+	// Rewrites the journal with only the live deltas
+	void compact();
+
+	size_t getDeltaCount();
+	size_t getRecordCount() const { return m_recordsInFile; }
+	size_t getFileBytes() const;
+	size_t getCompactions() const { return m_compactions; }
+
+	static const size_t RECORD_BYTES = 11;
+
+private:
+	std::string m_path;
+	std::mutex m_mutex;
+
+	// chunk key -> voxel index -> VoxelType
+	std::unordered_map<long long, std::unordered_map<uint16_t, uint8_t>> m_deltas;
+	size_t m_deltaCount;
+
+	FILE* m_file;
+	bool m_unflushed;
+	size_t m_recordsInFile;
+	size_t m_compactions;
+
+	void replay();
+	bool openForAppend();
+	static void writeRecord(FILE* file, long long key, uint16_t index, uint8_t type);
+};
+
+#endif
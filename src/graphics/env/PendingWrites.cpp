@@ -0,0 +1,98 @@
+#include "PendingWrites.h"
+#include "../../generation/FeaturePlacer.h"
+
+PendingWrites::PendingWrites()
+	: m_pushedWrites(0),
+	m_lateBatches(0) {
+}
+
+PendingWrites::Shard& PendingWrites::shardOf(long long key) {
+	// neighbouring chunks differ in the low bits of every packed coordinate, mix them all in
+	uint64_t h = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+	return m_shards[(h >> 32) % SHARDS];
+}
+
+void PendingWrites::push(long long source, long long target, std::vector<Write> writes) {
+	m_pushedWrites += writes.size();
+	Shard& shard = shardOf(target);
+	std::unique_lock<std::mutex> lock(shard.mutex);
+	Entry& entry = shard.entries[target];
+	if (!shard.claimed.count(target)) {
+		entry.sources[source] = std::move(writes);
+		return;
+	}
+
+	// Too late for the target's generation; keep a copy for when it's built again
+	Batch batch;
+	batch.target = target;
+	batch.writes = writes;
+	entry.sources[source] = std::move(writes);
+	lock.unlock();
+
+	std::lock_guard<std::mutex> lateLock(m_lateMutex);
+	m_late.push_back(std::move(batch));
+	m_lateBatches++;
+}
+
+int PendingWrites::claim(long long target, ChunkStorage& voxels) {
+	Shard& shard = shardOf(target);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	shard.claimed.insert(target);
+	auto it = shard.entries.find(target);
+	if (it == shard.entries.end()) {
+		return 0;
+	}
+	int changed = 0;
+	for (const auto& source : it->second.sources) {
+		changed += apply(source.second, voxels);
+	}
+	return changed;
+}
+
+void PendingWrites::markSaved(long long target) {
+	Shard& shard = shardOf(target);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	shard.claimed.erase(target);
+}
+
+void PendingWrites::takeLate(std::vector<Batch>& out) {
+	std::lock_guard<std::mutex> lock(m_lateMutex);
+	for (Batch& batch : m_late) {
+		out.push_back(std::move(batch));
+	}
+	m_late.clear();
+}
+
+void PendingWrites::clear() {
+	for (Shard& shard : m_shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		shard.entries.clear();
+		shard.claimed.clear();
+	}
+	std::lock_guard<std::mutex> lock(m_lateMutex);
+	m_late.clear();
+}
+
+int PendingWrites::apply(const std::vector<Write>& writes, ChunkStorage& voxels) {
+	int changed = 0;
+	for (const Write& write : writes) {
+		int x = write.index % CHUNK_SIZE;
+		int z = (write.index / CHUNK_SIZE) % CHUNK_SIZE;
+		int y = write.index / (CHUNK_SIZE * CHUNK_SIZE);
+		VoxelType type = static_cast<VoxelType>(write.type);
+		if (FeaturePlacer::replaces(voxels.get(x, y, z), type)) {
+			voxels.set(x, y, z, type);
+			changed++;
+		}
+	}
+	return changed;
+}
+
+size_t PendingWrites::getTargetCount() {
+	size_t count = 0;
+	for (Shard& shard : m_shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		count += shard.entries.size();
+	}
+	return count;
+}
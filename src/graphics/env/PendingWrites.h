@@ -0,0 +1,115 @@
+#ifndef PENDINGWRITES_H
+#define PENDINGWRITES_H
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "../models/chunkstorage.hpp"
+
+// Voxels that the features of one chunk place in the chunks around it, queued per
+// target chunk.
+//
+// A target keeps what each source chunk wrote into it, so it gets the same features
+// when it is built again after unloading, and a source that is decorated again
+// replaces its earlier writes instead of adding to them. Targets are spread over
+// SHARDS separately locked maps, so jobs decorating different chunks rarely wait on
+// each other.
+//
+// Generating a target claims it: it takes everything queued for it so far. Writes
+// that arrive after that are also handed to the main thread, which merges them into
+// the chunk once it is loaded. Once a target and every chunk around it are far from
+// the player, removeTargetsIf() drops it; generating the sources again queues the
+// same writes.
+class PendingWrites {
+public:
+	struct Write {
+		uint16_t index;
+		uint8_t type;
+	};
+
+	struct Batch {
+		long long target = 0;
+		std::vector<Write> writes;
+	};
+
+	PendingWrites();
+
+	// Any thread
+	void push(long long source, long long target, std::vector<Write> writes);
+	// Any thread, when the target is generated: applies what's queued for it, returns the voxels changed
+	int claim(long long target, ChunkStorage& voxels);
+	// Any thread: the target was loaded from a save that already holds its features, nothing
+	// queued for it later is merged
+	void markSaved(long long target);
+	// Main thread: writes whose target was claimed before they arrived
+	void takeLate(std::vector<Batch>& out);
+	// Forgets every target matching pred, with what was queued for it; returns how many
+	template <typename Predicate>
+	size_t removeTargetsIf(Predicate pred) {
+		size_t removed = 0;
+		for (Shard& shard : m_shards) {
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+				if (pred(it->first)) {
+					it = shard.entries.erase(it);
+					removed++;
+				}
+				else {
+					++it;
+				}
+			}
+			for (auto it = shard.claimed.begin(); it != shard.claimed.end();) {
+				if (pred(*it)) {
+					it = shard.claimed.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+		}
+		return removed;
+	}
+	void clear();
+
+	// Feature voxels of writes that FeaturePlacer::replaces lets through, returns how many changed
+	static int apply(const std::vector<Write>& writes, ChunkStorage& voxels);
+
+	size_t getTargetCount();
+	size_t getPushedWrites() const { return m_pushedWrites; }
+	size_t getLateBatches() const { return m_lateBatches; }
+
+private:
+	static const int SHARDS = 16;
+
+	struct Entry {
+		// source chunk key -> what it wrote here
+		std::unordered_map<long long, std::vector<Write>> sources;
+	};
+
+	struct Shard {
+		std::mutex mutex;
+		// only targets something was queued for
+		std::unordered_map<long long, Entry> entries;
+		// generated targets that later writes go to the main thread for, whether or not
+		// anything was queued for them
+		std::unordered_set<long long> claimed;
+	};
+
+	std::array<Shard, SHARDS> m_shards;
+
+	std::mutex m_lateMutex;
+	std::vector<Batch> m_late;
+
+	std::atomic<size_t> m_pushedWrites;
+	std::atomic<size_t> m_lateBatches;
+
+	Shard& shardOf(long long key);
+};
+
+#endif
@@ -0,0 +1,326 @@
+#include "RegionFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	const char magic[4] = { 'V', 'X', 'R', '1' };
+
+	uint32_t readU32(const uint8_t* p) {
+		return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+			(static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	void putU32(uint8_t* p, uint32_t value) {
+		p[0] = static_cast<uint8_t>(value);
+		p[1] = static_cast<uint8_t>(value >> 8);
+		p[2] = static_cast<uint8_t>(value >> 16);
+		p[3] = static_cast<uint8_t>(value >> 24);
+	}
+}
+
+RegionFile::RegionFile(const std::string& path)
+	: m_path(path),
+	m_view(nullptr),
+	m_viewSize(0),
+	m_missing(false),
+	m_bad(false) {
+}
+
+RegionFile::~RegionFile() {
+	unmap();
+}
+
+int RegionFile::slotOf(int chunkX, int chunkZ) {
+	return (chunkZ & (REGION_SIZE - 1)) * REGION_SIZE + (chunkX & (REGION_SIZE - 1));
+}
+
+bool RegionFile::map() {
+	if (m_view) return true;
+	if (m_missing || m_bad) return false;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		m_missing = true;
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	HANDLE mapping = size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	// the view keeps the file mapped after both handles are closed
+	void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (mapping) CloseHandle(mapping);
+	CloseHandle(file);
+	if (!view) return false;
+	m_viewSize = static_cast<size_t>(size.QuadPart);
+#else
+	int fd = open(m_path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		m_missing = true;
+		return false;
+	}
+	struct stat info;
+	void* view = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0) {
+		view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (view == MAP_FAILED) return false;
+	m_viewSize = static_cast<size_t>(info.st_size);
+#endif
+
+	m_view = static_cast<const uint8_t*>(view);
+	if (m_viewSize < HEADER_BYTES || std::memcmp(m_view, magic, sizeof(magic)) != 0) {
+		std::cout << "Not a region file: " << m_path << std::endl;
+		m_bad = true;
+		unmap();
+		return false;
+	}
+	return true;
+}
+
+void RegionFile::unmap() {
+	if (!m_view) return;
+#ifdef _WIN32
+	UnmapViewOfFile(m_view);
+#else
+	munmap(const_cast<uint8_t*>(m_view), m_viewSize);
+#endif
+	m_view = nullptr;
+	m_viewSize = 0;
+}
+
+bool RegionFile::read(int slot, ChunkStorage& voxels) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!map()) {
+		return false;
+	}
+
+	const uint8_t* entry = m_view + sizeof(magic) + slot * 8;
+	uint32_t offset = readU32(entry);
+	uint32_t length = readU32(entry + 4);
+	if (length == 0 || static_cast<size_t>(offset) + length > m_viewSize) {
+		return false;
+	}
+	return decode(m_view + offset, length, voxels);
+}
+
+bool RegionFile::write(int slot, const ChunkStorage& voxels) {
+	std::vector<uint8_t> payload;
+	encode(voxels, payload);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	unmap();
+
+	FILE* file = std::fopen(m_path.c_str(), "r+b");
+	uint8_t header[HEADER_BYTES];
+	if (file && std::fread(header, 1, HEADER_BYTES, file) == HEADER_BYTES && std::memcmp(header, magic, sizeof(magic)) == 0) {
+		// existing region
+	}
+	else {
+		if (file) {
+			// keep whatever is there, it may be another version's region
+			std::fclose(file);
+			std::string aside = m_path + ".bad";
+			if (!replaceFile(m_path, aside)) {
+				std::cout << "Could not move " << m_path << " aside, not writing to it" << std::endl;
+				return false;
+			}
+			std::cout << "Moved unreadable region file to " << aside << std::endl;
+		}
+		file = std::fopen(m_path.c_str(), "w+b");
+		if (!file) {
+			std::cout << "Could not open " << m_path << " for writing" << std::endl;
+			return false;
+		}
+		std::memset(header, 0, HEADER_BYTES);
+		std::memcpy(header, magic, sizeof(magic));
+		std::fwrite(header, 1, HEADER_BYTES, file);
+	}
+	m_missing = false;
+	m_bad = false;
+
+	uint8_t* entry = header + sizeof(magic) + slot * 8;
+	uint32_t offset = readU32(entry);
+	uint32_t length = readU32(entry + 4);
+	// reuse the old payload's bytes if the new one fits
+	if (length == 0 || payload.size() > length) {
+		std::fseek(file, 0, SEEK_END);
+		offset = static_cast<uint32_t>(std::ftell(file));
+	}
+	else {
+		std::fseek(file, static_cast<long>(offset), SEEK_SET);
+	}
+	bool ok = std::fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+
+	// the table entry goes last, a failed payload write leaves the old chunk readable
+	if (ok) {
+		putU32(entry, offset);
+		putU32(entry + 4, static_cast<uint32_t>(payload.size()));
+		std::fseek(file, static_cast<long>(sizeof(magic) + slot * 8), SEEK_SET);
+		ok = std::fwrite(entry, 1, 8, file) == 8;
+	}
+	std::fseek(file, 0, SEEK_END);
+	size_t fileSize = static_cast<size_t>(std::ftell(file));
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok) {
+		std::cout << "Failed writing chunk to " << m_path << std::endl;
+		return false;
+	}
+
+	size_t live = 0;
+	for (int i = 0; i < SLOT_COUNT; i++) {
+		live += readU32(header + sizeof(magic) + i * 8 + 4);
+	}
+	// dead bytes are whatever the table doesn't point at
+	if (fileSize > HEADER_BYTES + 2 * live) {
+		// the chunk itself is safely written, a failed compaction only costs space
+		compact();
+	}
+	return true;
+}
+
+bool RegionFile::compact() {
+	FILE* file = std::fopen(m_path.c_str(), "rb");
+	if (!file) return false;
+	std::fseek(file, 0, SEEK_END);
+	std::vector<uint8_t> old(static_cast<size_t>(std::ftell(file)));
+	std::fseek(file, 0, SEEK_SET);
+	bool ok = std::fread(old.data(), 1, old.size(), file) == old.size();
+	std::fclose(file);
+	if (!ok || old.size() < HEADER_BYTES) return false;
+
+	std::vector<uint8_t> packed(old.begin(), old.begin() + HEADER_BYTES);
+	for (int i = 0; i < SLOT_COUNT; i++) {
+		uint8_t* entry = packed.data() + sizeof(magic) + i * 8;
+		uint32_t offset = readU32(entry);
+		uint32_t length = readU32(entry + 4);
+		if (length == 0 || static_cast<size_t>(offset) + length > old.size()) {
+			putU32(entry, 0);
+			putU32(entry + 4, 0);
+			continue;
+		}
+		// entry points into packed, set it before the insert can move it
+		putU32(entry, static_cast<uint32_t>(packed.size()));
+		packed.insert(packed.end(), old.begin() + offset, old.begin() + offset + length);
+	}
+
+	// written beside the region and swapped in, a crash keeps one of the two whole
+	std::string temporary = m_path + ".tmp";
+	file = std::fopen(temporary.c_str(), "wb");
+	if (!file) return false;
+	ok = std::fwrite(packed.data(), 1, packed.size(), file) == packed.size();
+	ok = std::fclose(file) == 0 && ok;
+	if (!ok || !replaceFile(temporary, m_path)) {
+		std::remove(temporary.c_str());
+		std::cout << "Could not compact " << m_path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool RegionFile::evictFromPageCache(const std::string& path) {
+#ifdef _WIN32
+	// opening a file unbuffered makes the cache manager purge what it holds of it
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+		OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	CloseHandle(file);
+	return true;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	fdatasync(fd);
+	bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(fd);
+	return ok;
+#endif
+}
+
+void RegionFile::createDirectories(const std::string& directory) {
+	for (size_t i = 0; i <= directory.size(); i++) {
+		if (i < directory.size() && directory[i] != '/' && directory[i] != '\\') continue;
+		std::string part = directory.substr(0, i);
+		if (part.empty()) continue;
+#ifdef _WIN32
+		_mkdir(part.c_str());
+#else
+		mkdir(part.c_str(), 0755);
+#endif
+	}
+}
+
+bool RegionFile::replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+	// rename refuses to replace an existing file on Windows
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+void RegionFile::encode(const ChunkStorage& voxels, std::vector<uint8_t>& out) {
+	std::vector<VoxelType> dense;
+	voxels.unpack(dense);
+
+	out.clear();
+	int i = 0;
+	while (i < ChunkStorage::VOLUME) {
+		VoxelType type = dense[i];
+		int run = 1;
+		while (i + run < ChunkStorage::VOLUME && run < 0xFFFF && dense[i + run] == type) {
+			run++;
+		}
+		out.push_back(static_cast<uint8_t>(type));
+		out.push_back(static_cast<uint8_t>(run));
+		out.push_back(static_cast<uint8_t>(run >> 8));
+		i += run;
+	}
+}
+
+bool RegionFile::decode(const uint8_t* data, size_t length, ChunkStorage& voxels) {
+	if (length % 3 != 0) {
+		return false;
+	}
+
+	ChunkStorage decoded;
+	int i = 0;
+	for (size_t p = 0; p < length; p += 3) {
+		int type = data[p];
+		int run = data[p + 1] | (data[p + 2] << 8);
+		if (type >= VOXEL_TYPE_COUNT || run == 0 || i + run > ChunkStorage::VOLUME) {
+			return false;
+		}
+		// a fresh ChunkStorage is all air already
+		if (static_cast<VoxelType>(type) != VoxelType::AIR) {
+			for (int k = i; k < i + run; k++) {
+				int x = k % CHUNK_SIZE;
+				int z = (k / CHUNK_SIZE) % CHUNK_SIZE;
+				int y = k / (CHUNK_SIZE * CHUNK_SIZE);
+				decoded.set(x, y, z, static_cast<VoxelType>(type));
+			}
+		}
+		i += run;
+	}
+	if (i != ChunkStorage::VOLUME) {
+		return false;
+	}
+
+	voxels = std::move(decoded);
+	return true;
+}
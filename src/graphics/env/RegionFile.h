@@ -0,0 +1,81 @@
+#ifndef REGIONFILE_H
+#define REGIONFILE_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#include "../models/chunkstorage.hpp"
+
+// One region file on disk: REGION_SIZE x REGION_SIZE chunks of one chunk layer.
+//
+// Layout, all integers little endian:
+//   magic "VXR1"
+//   offset table, one { uint32 offset, uint32 length } per chunk slot, length 0 for none
+//   chunk payloads, run length encoded (see encode)
+// A chunk that grew past its old payload is appended at the end and its old bytes are
+// left behind. Once those dead bytes outgrow the live payloads the file is rewritten
+// packed.
+//
+// A file at the path that isn't a region file is never overwritten: the first write
+// moves it aside to <path>.bad and starts a new region.
+//
+// Reads go through a read-only mapping of the whole file, made on first use. Writes
+// drop the mapping and patch the file with plain stdio, the next read maps it again.
+// Both may come from any thread.
+class RegionFile {
+public:
+	static const int REGION_SIZE = 32;
+	static const int SLOT_COUNT = REGION_SIZE * REGION_SIZE;
+	static const size_t HEADER_BYTES = 4 + SLOT_COUNT * 8;
+
+	explicit RegionFile(const std::string& path);
+	~RegionFile();
+
+	RegionFile(const RegionFile&) = delete;
+	RegionFile& operator=(const RegionFile&) = delete;
+
+	// Slot of a chunk within its region, from the chunk's x and z
+	static int slotOf(int chunkX, int chunkZ);
+
+	// False if the slot is empty, the file doesn't exist or the payload is damaged
+	bool read(int slot, ChunkStorage& voxels);
+	// False if the file couldn't be written
+	bool write(int slot, const ChunkStorage& voxels);
+
+	// Run length encoding of the voxels in ChunkStorage::index() order,
+	// as { uint8 type, uint16 run } triples
+	static void encode(const ChunkStorage& voxels, std::vector<uint8_t>& out);
+	static bool decode(const uint8_t* data, size_t length, ChunkStorage& voxels);
+
+	// Asks the OS to drop the file's cached pages so the next read has to hit the disk,
+	// for measuring cold loads. False where that isn't possible.
+	static bool evictFromPageCache(const std::string& path);
+	// mkdir for the directory and every parent missing, without std::filesystem
+	static void createDirectories(const std::string& directory);
+	// Moves from over to, replacing to in one step if it exists; false if it couldn't
+	static bool replaceFile(const std::string& from, const std::string& to);
+
+	const std::string& getPath() const { return m_path; }
+
+private:
+	std::string m_path;
+	std::mutex m_mutex;
+
+	// The mapping, or nothing before the first read and after a write
+	const uint8_t* m_view;
+	size_t m_viewSize;
+	// Set once a read found no file, until a write creates it
+	bool m_missing;
+	// Set once a read found something else at the path, until a write moves it aside
+	bool m_bad;
+
+	bool map();
+	void unmap();
+	// Rewrites the file with the payloads packed after the header, dropping dead bytes
+	bool compact();
+};
+
+#endif
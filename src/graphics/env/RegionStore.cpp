@@ -0,0 +1,141 @@
+#include "RegionStore.h"
+#include "ChunkKey.h"
+
+#include <chrono>
+#include <iostream>
+
+RegionStore::RegionStore(const std::string& directory)
+	: m_directory(directory),
+	m_directoryCreated(false),
+	m_chunksLoaded(0),
+	m_chunksWritten(0),
+	m_loadNanoseconds(0) {
+	m_writer = std::thread(&RegionStore::writerLoop, this);
+}
+
+RegionStore::~RegionStore() {
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		retryFailed();
+	}
+	m_writeQueue.stop();
+	if (m_writer.joinable()) {
+		m_writer.join();
+	}
+	if (!m_failed.empty()) {
+		std::cout << "RegionStore: " << m_failed.size() << " chunks could not be saved to " << m_directory << std::endl;
+	}
+}
+
+std::shared_ptr<RegionFile> RegionStore::regionFor(glm::ivec3 coords) {
+	int regionX = floorDiv(coords.x, RegionFile::REGION_SIZE);
+	int regionZ = floorDiv(coords.z, RegionFile::REGION_SIZE);
+	long long key = packChunkKey(regionX, coords.y, regionZ);
+
+	std::lock_guard<std::mutex> lock(m_regionsMutex);
+	std::shared_ptr<RegionFile>& region = m_regions[key];
+	if (!region) {
+		region = std::make_shared<RegionFile>(m_directory + "/r." + std::to_string(regionX) + "." +
+			std::to_string(coords.y) + "." + std::to_string(regionZ) + ".vxr");
+	}
+	return region;
+}
+
+bool RegionStore::load(glm::ivec3 coords, ChunkStorage& voxels) {
+	auto start = std::chrono::steady_clock::now();
+	bool found = false;
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		auto it = m_pending.find(packChunkKey(coords.x, coords.y, coords.z));
+		if (it != m_pending.end()) {
+			voxels = *it->second;
+			found = true;
+		}
+	}
+
+	if (!found && !regionFor(coords)->read(RegionFile::slotOf(coords.x, coords.z), voxels)) {
+		return false;
+	}
+	m_chunksLoaded++;
+	m_loadNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+void RegionStore::save(glm::ivec3 coords, const ChunkStorage& voxels) {
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		long long key = packChunkKey(coords.x, coords.y, coords.z);
+		m_pending[key] = std::make_shared<const ChunkStorage>(voxels);
+		m_failed.erase(key);
+	}
+	m_writeQueue.push(coords);
+}
+
+bool RegionStore::flush() {
+	std::unique_lock<std::mutex> lock(m_pendingMutex);
+	retryFailed();
+	m_flushed.wait(lock, [this] { return m_pending.size() == m_failed.size(); });
+	return m_failed.empty();
+}
+
+size_t RegionStore::getPendingWrites() {
+	std::lock_guard<std::mutex> lock(m_pendingMutex);
+	return m_pending.size();
+}
+
+size_t RegionStore::getFailedWrites() {
+	std::lock_guard<std::mutex> lock(m_pendingMutex);
+	return m_failed.size();
+}
+
+void RegionStore::retryFailed() {
+	for (long long key : m_failed) {
+		m_writeQueue.push(unpackChunkKey(key));
+	}
+	m_failed.clear();
+}
+
+double RegionStore::getAverageLoadMs() const {
+	size_t loaded = m_chunksLoaded;
+	return loaded > 0 ? m_loadNanoseconds / 1e6 / loaded : 0.0;
+}
+
+void RegionStore::writerLoop() {
+	glm::ivec3 coords;
+	while (m_writeQueue.wait_and_pop(coords)) {
+		long long key = packChunkKey(coords.x, coords.y, coords.z);
+		std::shared_ptr<const ChunkStorage> voxels;
+		{
+			std::lock_guard<std::mutex> lock(m_pendingMutex);
+			auto it = m_pending.find(key);
+			// saved twice before we got to it, the first pop already wrote the latest copy
+			if (it == m_pending.end()) continue;
+			voxels = it->second;
+		}
+
+		if (!m_directoryCreated) {
+			RegionFile::createDirectories(m_directory);
+			m_directoryCreated = true;
+		}
+		bool written = regionFor(coords)->write(RegionFile::slotOf(coords.x, coords.z), *voxels);
+		if (written) {
+			m_chunksWritten++;
+		}
+
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		auto it = m_pending.find(key);
+		// a newer save() queued the key again and keeps its copy
+		if (it != m_pending.end() && it->second == voxels) {
+			if (written) {
+				m_pending.erase(it);
+				m_failed.erase(key);
+			}
+			else {
+				// keep it for load() and the next flush(), the edits are nowhere else
+				std::cout << "RegionStore: failed to write chunk " << coords.x << ", " << coords.y << ", " << coords.z << std::endl;
+				m_failed.insert(key);
+			}
+		}
+		m_flushed.notify_all();
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef REGIONSTORE_H
+#define REGIONSTORE_H
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+#include <glm/glm.hpp>
+
+#include "RegionFile.h"
+#include "../models/ThreadSafeQueue.hpp"
+
+// Saved chunks of one world, as region files in one directory.
+//
+// save() only queues a copy of the chunk; a background thread writes it so unloading
+// never waits on the disk. load() sees queued chunks before they reach the file, so a
+// chunk that comes back straight after being unloaded still has its edits. A chunk
+// the writer couldn't write stays queued in memory until a later attempt succeeds.
+// load() is safe from any thread, save() from the thread that owns the chunks.
+class RegionStore {
+public:
+	explicit RegionStore(const std::string& directory);
+	// Writes everything still queued, trying the failed writes once more
+	~RegionStore();
+
+	RegionStore(const RegionStore&) = delete;
+	RegionStore& operator=(const RegionStore&) = delete;
+
+	// False if the chunk was never saved
+	bool load(glm::ivec3 coords, ChunkStorage& voxels);
+	void save(glm::ivec3 coords, const ChunkStorage& voxels);
+	// Blocks until the writer has caught up with every save() so far, retrying the
+	// writes that failed before. False if some chunks still couldn't be written.
+	bool flush();
+
+	const std::string& getDirectory() const { return m_directory; }
+
+	size_t getChunksLoaded() const { return m_chunksLoaded; }
+	size_t getChunksWritten() const { return m_chunksWritten; }
+	size_t getPendingWrites();
+	size_t getFailedWrites();
+	double getAverageLoadMs() const;
+
+private:
+	std::string m_directory;
+	bool m_directoryCreated;
+
+	// Region files by region key, opened on first use and kept
+	std::mutex m_regionsMutex;
+	std::unordered_map<long long, std::shared_ptr<RegionFile>> m_regions;
+
+	// Latest copy of every chunk not written yet, by chunk key
+	std::mutex m_pendingMutex;
+	std::condition_variable m_flushed;
+	std::unordered_map<long long, std::shared_ptr<const ChunkStorage>> m_pending;
+	// Keys in m_pending whose last write failed, they aren't in the write queue
+	std::unordered_set<long long> m_failed;
+
+	ThreadSafeQueue<glm::ivec3> m_writeQueue;
+	std::thread m_writer;
+
+	std::atomic<size_t> m_chunksLoaded;
+	std::atomic<size_t> m_chunksWritten;
+	std::atomic<long long> m_loadNanoseconds;
+
+	std::shared_ptr<RegionFile> regionFor(glm::ivec3 coords);
+	// Queues the failed chunks again, called with m_pendingMutex held
+	void retryFailed();
+	void writerLoop();
+};
+
+#endif
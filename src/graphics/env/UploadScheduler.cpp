@@ -0,0 +1,55 @@
+#include "UploadScheduler.h"
+
+#include <algorithm>
+
+namespace {
+	// Never plan with less than this, so a slow frame doesn't stop streaming altogether
+	const double minFrameBudgetMs = 0.25;
+	// Weight of the newest measurement in the running costs
+	const double costSmoothing = 0.2;
+}
+
+UploadScheduler::UploadScheduler(double budgetMs, double targetFrameMs)
+	: budgetMs(budgetMs),
+	targetFrameMs(targetFrameMs),
+	frameBudgetMs(budgetMs),
+	msPerByte(1.0 / (1024.0 * 1024.0)),	// 1 ms per MB until the first upload is measured
+	msPerChunk(0.0),
+	uploads(0),
+	uploadMs(0.0),
+	uploadBytes(0),
+	lastUploads(0),
+	lastUploadMs(0.0),
+	lastUploadBytes(0) {}
+
+void UploadScheduler::beginFrame(double frameMs) {
+	lastUploads = uploads;
+	lastUploadMs = uploadMs;
+	lastUploadBytes = uploadBytes;
+	uploads = 0;
+	uploadMs = 0.0;
+	uploadBytes = 0;
+
+	// time the rest of the frame took, assuming it costs about the same again
+	double otherWorkMs = std::max(0.0, frameMs - lastUploadMs);
+	double headroomMs = targetFrameMs - otherWorkMs;
+	frameBudgetMs = std::max(minFrameBudgetMs, std::min(budgetMs, headroomMs));
+}
+
+bool UploadScheduler::canUpload(size_t bytes) const {
+	if (uploads == 0) {
+		return true;
+	}
+	return uploadMs + bytes * msPerByte + msPerChunk <= frameBudgetMs;
+}
+
+void UploadScheduler::recordUpload(size_t bytes, double ms, double chunkMs) {
+	uploads++;
+	uploadMs += ms + chunkMs;
+	uploadBytes += bytes;
+	msPerChunk += costSmoothing * (chunkMs - msPerChunk);
+
+	if (bytes > 0) {
+		msPerByte += costSmoothing * (ms / bytes - msPerByte);
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef UPLOADSCHEDULER_H
+#define UPLOADSCHEDULER_H
+
+#include <cstddef>
+
+// Decides how many finished chunk meshes World::update uploads per frame.
+// Every upload is timed and folds into a running cost per byte, so the next
+// upload's cost can be predicted from its size. The main thread work a new chunk
+// brings whatever its size (settling the light across its seams) is averaged per
+// chunk and added on top. A frame keeps uploading while the
+// prediction fits the budget, which is the smaller of the configured upload budget
+// and whatever the target frame time leaves after last frame's other work.
+// At least one mesh goes up per frame so streaming can't stall completely.
+class UploadScheduler {
+public:
+	UploadScheduler(double budgetMs = 2.0, double targetFrameMs = 16.7);
+
+	// frameMs is the full duration of the previous frame
+	void beginFrame(double frameMs);
+	bool canUpload(size_t bytes) const;
+	// ms is the GL upload, chunkMs the rest of the work the upload brought with it
+	void recordUpload(size_t bytes, double ms, double chunkMs = 0.0);
+
+	void setBudgetMs(double ms) { budgetMs = ms; }
+	double getBudgetMs() const { return budgetMs; }
+	void setTargetFrameMs(double ms) { targetFrameMs = ms; }
+	double getTargetFrameMs() const { return targetFrameMs; }
+
+	// Budget the current frame runs with
+	double getFrameBudgetMs() const { return frameBudgetMs; }
+	double getMsPerMegabyte() const { return msPerByte * 1024.0 * 1024.0; }
+	double getMsPerChunk() const { return msPerChunk; }
+
+	// Totals of the previous frame
+	int getLastUploads() const { return lastUploads; }
+	double getLastUploadMs() const { return lastUploadMs; }
+	size_t getLastUploadBytes() const { return lastUploadBytes; }
+
+private:
+	double budgetMs;
+	double targetFrameMs;
+
+	double frameBudgetMs;
+	double msPerByte;
+	double msPerChunk;
+
+	int uploads;
+	double uploadMs;
+	size_t uploadBytes;
+
+	int lastUploads;
+	double lastUploadMs;
+	size_t lastUploadBytes;
+};
+
+#endif
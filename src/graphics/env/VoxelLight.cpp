@@ -0,0 +1,365 @@
+#include "VoxelLight.h"
+#include "ChunkKey.h"
+
+namespace {
+	// Indexed by Face
+	const glm::ivec3 directions[6] = {
+		glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1),
+		glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),
+		glm::ivec3(0, 1, 0), glm::ivec3(0, -1, 0)
+	};
+	const int UP = static_cast<int>(Face::TOP);
+	const int DOWN = static_cast<int>(Face::BOTTOM);
+
+	int opposite(int face) {
+		// FRONT/BACK, LEFT/RIGHT and TOP/BOTTOM are pairs of consecutive values
+		return face ^ 1;
+	}
+
+	// Light a voxel passes to its neighbour in the given direction
+	int nextLevel(LightChannel channel, int level, int direction) {
+		if (channel == LightChannel::SKY && direction == DOWN && level == MAX_LIGHT) {
+			return MAX_LIGHT;
+		}
+		return level - 1;
+	}
+
+	int channelOf(uint8_t packed, LightChannel channel) {
+		return channel == LightChannel::SKY ? packed >> 4 : packed & 0xF;
+	}
+
+	// Light the neighbours' border slices pass into the voxels along the chunk's sides
+	void seedFromBorders(const std::vector<VoxelType>& dense, const ChunkNeighbors& neighbors, bool openSky,
+		LightChannel channel, ChunkLight& light, std::vector<int>& queue) {
+		for (int face = 0; face < 6; face++) {
+			const ChunkEdge* edge = neighbors.edges[face].get();
+			bool lit = edge && edge->hasLight();
+			bool skyAbove = face == UP && !lit && openSky && channel == LightChannel::SKY;
+			if (!lit && !skyAbove) continue;
+
+			for (int b = 0; b < CHUNK_SIZE; b++) {
+				for (int a = 0; a < CHUNK_SIZE; a++) {
+					glm::ivec3 cell = VoxelChunk::borderCell(static_cast<Face>(face), a, b);
+					int index = ChunkStorage::index(cell.x, cell.y, cell.z);
+					if (isOpaque(dense[index])) continue;
+
+					int incoming = lit ? channelOf(edge->lightAt(a, b), channel) : MAX_LIGHT;
+					int level = nextLevel(channel, incoming, opposite(face));
+					if (level > light.get(index, channel)) {
+						light.set(index, channel, level);
+						queue.push_back(index);
+					}
+				}
+			}
+		}
+	}
+
+	// Flood fill within the chunk from the queued voxels
+	void spreadInChunk(const std::vector<VoxelType>& dense, LightChannel channel, ChunkLight& light, std::vector<int>& queue) {
+		for (size_t head = 0; head < queue.size(); head++) {
+			int index = queue[head];
+			int x = index % CHUNK_SIZE;
+			int z = (index / CHUNK_SIZE) % CHUNK_SIZE;
+			int y = index / (CHUNK_SIZE * CHUNK_SIZE);
+			int level = light.get(index, channel);
+			for (int d = 0; d < 6; d++) {
+				int next = nextLevel(channel, level, d);
+				int nx = x + directions[d].x, ny = y + directions[d].y, nz = z + directions[d].z;
+				if (next <= 0 || !ChunkStorage::inBounds(nx, ny, nz)) continue;
+
+				int neighbor = ChunkStorage::index(nx, ny, nz);
+				if (isOpaque(dense[neighbor]) || light.get(neighbor, channel) >= next) continue;
+				light.set(neighbor, channel, next);
+				queue.push_back(neighbor);
+			}
+		}
+		queue.clear();
+	}
+}
+
+VoxelLight::VoxelLight(const ChunkMap& chunks, OpenSkyTest openSky)
+	: m_chunks(chunks),
+	m_openSky(std::move(openSky)),
+	m_cachedKey(-1),
+	m_cachedChunk(nullptr),
+	m_changed(nullptr),
+	m_voxelsChanged(0) {
+}
+
+void VoxelLight::lightChunk(const ChunkStorage& voxels, const ChunkNeighbors& neighbors, bool openSky, ChunkLight& light) {
+	light.reset(0);
+
+	// Open air with the sky straight above every column is all full sky light, which is
+	// most of the chunks above the ground
+	const ChunkEdge* top = neighbors.edges[UP].get();
+	bool skyEverywhere = voxels.isEmpty();
+	if (skyEverywhere && top && top->hasLight()) {
+		for (uint8_t value : top->light) {
+			skyEverywhere = skyEverywhere && (value >> 4) == MAX_LIGHT;
+		}
+	}
+	else if (skyEverywhere) {
+		skyEverywhere = openSky;
+	}
+
+	std::vector<VoxelType> dense;
+	voxels.unpack(dense);
+	std::vector<int> queue;
+	queue.reserve(ChunkStorage::VOLUME);
+
+	if (skyEverywhere) {
+		light.reset(ChunkLight::pack(MAX_LIGHT, 0));
+	}
+	else {
+		seedFromBorders(dense, neighbors, openSky, LightChannel::SKY, light, queue);
+		spreadInChunk(dense, LightChannel::SKY, light, queue);
+	}
+
+	for (int i = 0; i < ChunkStorage::VOLUME; i++) {
+		int emission = lightEmission(dense[i]);
+		if (emission > 0) {
+			light.set(i, LightChannel::BLOCK, emission);
+			queue.push_back(i);
+		}
+	}
+	seedFromBorders(dense, neighbors, openSky, LightChannel::BLOCK, light, queue);
+	spreadInChunk(dense, LightChannel::BLOCK, light, queue);
+
+	light.compact();
+}
+
+bool VoxelLight::absorbNeighbors(const ChunkStorage& voxels, const ChunkNeighbors& neighbors, ChunkLight& light) {
+	if (voxels.isFull()) {
+		return false;
+	}
+	std::vector<VoxelType> dense;
+	voxels.unpack(dense);
+	std::vector<int> queue;
+
+	bool brighter = false;
+	for (LightChannel channel : { LightChannel::SKY, LightChannel::BLOCK }) {
+		// the sky above was settled when the chunk was lit, only actual borders count now
+		seedFromBorders(dense, neighbors, false, channel, light, queue);
+		brighter = brighter || !queue.empty();
+		spreadInChunk(dense, channel, light, queue);
+	}
+	return brighter;
+}
+
+void VoxelLight::relight(glm::ivec3 worldPos, ChangedChunks& changed) {
+	begin(changed);
+	Cell cell = find(worldPos);
+	if (!cell.chunk) {
+		return;
+	}
+	VoxelType type = cell.chunk->voxels.get(cell.local.x, cell.local.y, cell.local.z);
+
+	for (LightChannel channel : { LightChannel::SKY, LightChannel::BLOCK }) {
+		int old = cell.chunk->light.get(cell.index, channel);
+		int level = channel == LightChannel::BLOCK ? lightEmission(type) : 0;
+		if (old != level) {
+			setLevel(cell, channel, level);
+		}
+		if (old > level) {
+			m_darken.push_back(Darkened{ worldPos, old });
+		}
+		darken(channel);
+
+		if (level > 0) {
+			m_spread.push_back(worldPos);
+		}
+		if (!isOpaque(type)) {
+			// an opened voxel takes in whatever its neighbours have
+			if (channel == LightChannel::SKY && underOpenSky(cell)) {
+				setLevel(cell, channel, MAX_LIGHT);
+				m_spread.push_back(worldPos);
+			}
+			for (int d = 0; d < 6; d++) {
+				m_spread.push_back(worldPos + directions[d]);
+			}
+		}
+		spread(channel);
+	}
+}
+
+void VoxelLight::settleSeams(glm::ivec3 coords, ChangedChunks& changed) {
+	begin(changed);
+	auto self = m_chunks.find(packChunkKey(coords.x, coords.y, coords.z));
+	if (self == m_chunks.end()) {
+		return;
+	}
+
+	// Every seam cell pairs a voxel of this chunk with one of the same neighbour, so look
+	// the six up once instead of per cell
+	VoxelChunk* neighbors[6];
+	for (int face = 0; face < 6; face++) {
+		glm::ivec3 next = coords + directions[face];
+		auto it = m_chunks.find(packChunkKey(next.x, next.y, next.z));
+		neighbors[face] = it != m_chunks.end() ? it->second.get() : nullptr;
+	}
+	auto seamCell = [&](int face, int a, int b, bool outside) {
+		Face side = static_cast<Face>(outside ? opposite(face) : face);
+		return cellIn(outside ? neighbors[face] : self->second.get(), outside ? coords + directions[face] : coords,
+			VoxelChunk::borderCell(side, a, b));
+	};
+
+	for (LightChannel channel : { LightChannel::SKY, LightChannel::BLOCK }) {
+		// Full sky light in the top layer of a chunk means it had the open sky above it
+		// when it was lit; where the chunk that turned up above lets less through, that
+		// light was never there
+		if (channel == LightChannel::SKY) {
+			for (int face : { UP, DOWN }) {
+				if (!neighbors[face]) continue;
+				for (int b = 0; b < CHUNK_SIZE; b++) {
+					for (int a = 0; a < CHUNK_SIZE; a++) {
+						Cell inside = seamCell(face, a, b, false);
+						Cell outside = seamCell(face, a, b, true);
+						const Cell& upper = face == UP ? outside : inside;
+						const Cell& lower = face == UP ? inside : outside;
+						if (lower.chunk->light.get(lower.index, channel) == MAX_LIGHT &&
+							upper.chunk->light.get(upper.index, channel) < MAX_LIGHT) {
+							setLevel(lower, channel, 0);
+							m_darken.push_back(Darkened{ lower.position, MAX_LIGHT });
+						}
+					}
+				}
+			}
+			darken(channel);
+		}
+
+		for (int face = 0; face < 6; face++) {
+			if (!neighbors[face]) continue;
+			for (int b = 0; b < CHUNK_SIZE; b++) {
+				for (int a = 0; a < CHUNK_SIZE; a++) {
+					Cell inside = seamCell(face, a, b, false);
+					Cell outside = seamCell(face, a, b, true);
+					int insideLevel = inside.chunk->light.get(inside.index, channel);
+					int outsideLevel = outside.chunk->light.get(outside.index, channel);
+
+					int into = nextLevel(channel, outsideLevel, opposite(face));
+					if (into > insideLevel && !isOpaque(inside.chunk->voxels.get(inside.local.x, inside.local.y, inside.local.z))) {
+						setLevel(inside, channel, into);
+						m_spread.push_back(inside.position);
+					}
+					int out = nextLevel(channel, insideLevel, face);
+					if (out > outsideLevel && !isOpaque(outside.chunk->voxels.get(outside.local.x, outside.local.y, outside.local.z))) {
+						setLevel(outside, channel, out);
+						m_spread.push_back(outside.position);
+					}
+				}
+			}
+		}
+		spread(channel);
+	}
+}
+
+void VoxelLight::begin(ChangedChunks& changed) {
+	m_changed = &changed;
+	m_voxelsChanged = 0;
+	// chunks may have come and gone since the last call
+	m_cachedKey = -1;
+	m_cachedChunk = nullptr;
+	m_darken.clear();
+	m_spread.clear();
+}
+
+VoxelLight::Cell VoxelLight::find(glm::ivec3 position) {
+	glm::ivec3 coords(floorDiv(position.x, CHUNK_SIZE), floorDiv(position.y, CHUNK_HEIGHT), floorDiv(position.z, CHUNK_SIZE));
+	long long key = packChunkKey(coords.x, coords.y, coords.z);
+	if (key != m_cachedKey) {
+		auto it = m_chunks.find(key);
+		m_cachedKey = key;
+		m_cachedChunk = it != m_chunks.end() ? it->second.get() : nullptr;
+	}
+
+	Cell cell;
+	cell.chunk = m_cachedChunk;
+	cell.position = position;
+	cell.local = position - glm::ivec3(coords.x * CHUNK_SIZE, coords.y * CHUNK_HEIGHT, coords.z * CHUNK_SIZE);
+	cell.index = ChunkStorage::index(cell.local.x, cell.local.y, cell.local.z);
+	return cell;
+}
+
+VoxelLight::Cell VoxelLight::cellIn(VoxelChunk* chunk, glm::ivec3 coords, glm::ivec3 local) {
+	Cell cell;
+	cell.chunk = chunk;
+	cell.position = coords * CHUNK_SIZE + local;
+	cell.local = local;
+	cell.index = ChunkStorage::index(local.x, local.y, local.z);
+	return cell;
+}
+
+void VoxelLight::setLevel(const Cell& cell, LightChannel channel, int level) {
+	cell.chunk->light.set(cell.index, channel, level);
+	m_voxelsChanged++;
+
+	glm::ivec3 coords = (cell.position - cell.local) / CHUNK_SIZE;
+	m_changed->insert(packChunkKey(coords.x, coords.y, coords.z));
+
+	// The faces of the blocks across a border are part of the neighbour's mesh
+	for (int face = 0; face < 6; face++) {
+		glm::ivec3 across = cell.local + directions[face];
+		if (ChunkStorage::inBounds(across.x, across.y, across.z)) continue;
+
+		glm::ivec3 next = coords + directions[face];
+		long long key = packChunkKey(next.x, next.y, next.z);
+		if (m_chunks.count(key)) {
+			m_changed->insert(key);
+		}
+	}
+}
+
+bool VoxelLight::underOpenSky(const Cell& cell) const {
+	if (cell.local.y != CHUNK_HEIGHT - 1) {
+		return false;
+	}
+	glm::ivec3 coords = (cell.position - cell.local) / CHUNK_SIZE;
+	return !m_chunks.count(packChunkKey(coords.x, coords.y + 1, coords.z)) && m_openSky(coords.y);
+}
+
+void VoxelLight::darken(LightChannel channel) {
+	for (size_t head = 0; head < m_darken.size(); head++) {
+		Darkened node = m_darken[head];
+		for (int d = 0; d < 6; d++) {
+			Cell neighbor = find(node.position + directions[d]);
+			if (!neighbor.chunk) continue;
+			int level = neighbor.chunk->light.get(neighbor.index, channel);
+			if (level == 0) continue;
+
+			// Anything dimmer may have been lit through the darkened voxel, and so may the
+			// sky light straight below it. The rest is lit from elsewhere.
+			bool passedOn = level < node.level || nextLevel(channel, node.level, d) == level;
+			VoxelType type = neighbor.chunk->voxels.get(neighbor.local.x, neighbor.local.y, neighbor.local.z);
+			int emission = channel == LightChannel::BLOCK ? lightEmission(type) : 0;
+			if (passedOn && level > emission) {
+				setLevel(neighbor, channel, emission);
+				m_darken.push_back(Darkened{ neighbor.position, level });
+				if (emission > 0) {
+					m_spread.push_back(neighbor.position);
+				}
+			}
+			else {
+				m_spread.push_back(neighbor.position);
+			}
+		}
+	}
+	m_darken.clear();
+}
+
+void VoxelLight::spread(LightChannel channel) {
+	for (size_t head = 0; head < m_spread.size(); head++) {
+		Cell cell = find(m_spread[head]);
+		if (!cell.chunk) continue;
+		int level = cell.chunk->light.get(cell.index, channel);
+		for (int d = 0; d < 6; d++) {
+			int next = nextLevel(channel, level, d);
+			if (next <= 0) continue;
+			Cell neighbor = find(cell.position + directions[d]);
+			if (!neighbor.chunk || isOpaque(neighbor.chunk->voxels.get(neighbor.local.x, neighbor.local.y, neighbor.local.z)) ||
+				neighbor.chunk->light.get(neighbor.index, channel) >= next) continue;
+			setLevel(neighbor, channel, next);
+			m_spread.push_back(neighbor.position);
+		}
+	}
+	m_spread.clear();
+}
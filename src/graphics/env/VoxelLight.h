@@ -0,0 +1,93 @@
+#ifndef VOXELLIGHT_H
+#define VOXELLIGHT_H
+
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "../models/voxelchunk.hpp"
+#include "../models/chunklight.hpp"
+
+// Sky and block light of the voxels.
+//
+// Sky light enters the top of the world at MAX_LIGHT and keeps that level straight down
+// through air; a step sideways or up, or down once it's below MAX_LIGHT, costs one level.
+// Block light spreads from emitting blocks the same way, without the free fall. Only
+// air lets either through.
+//
+// lightChunk() lights a chunk while it is being built, from its own voxels and whatever
+// light borders its neighbours have published. Once chunks are loaded, the main thread
+// keeps the light right across all of them: relight() after a voxel changes and
+// settleSeams() when a chunk joins the loaded ones. Both only visit the voxels whose
+// light changes, flood filling the light a change took away back out first and then
+// refilling it from what is left.
+class VoxelLight {
+public:
+	typedef std::unordered_map<long long, std::unique_ptr<VoxelChunk>> ChunkMap;
+	// Whether the sky shines into the top of a chunk layer with nothing loaded above it
+	typedef std::function<bool(int chunkY)> OpenSkyTest;
+	// Chunks whose mesh the changed light shows on
+	typedef std::unordered_set<long long> ChangedChunks;
+
+	VoxelLight(const ChunkMap& chunks, OpenSkyTest openSky);
+
+	// Light of a chunk on its own, plus what comes in through the neighbours' borders.
+	// A chunk without a lit neighbour above gets full sky light from the top if openSky.
+	static void lightChunk(const ChunkStorage& voxels, const ChunkNeighbors& neighbors, bool openSky, ChunkLight& light);
+	// Lets in the light of borders published since the chunk was lit, true if any voxel
+	// got brighter
+	static bool absorbNeighbors(const ChunkStorage& voxels, const ChunkNeighbors& neighbors, ChunkLight& light);
+
+	// Call after the voxel at worldPos changed in a loaded chunk
+	void relight(glm::ivec3 worldPos, ChangedChunks& changed);
+	// Call once a chunk is loaded: evens out the light across its six sides both ways
+	void settleSeams(glm::ivec3 coords, ChangedChunks& changed);
+
+	// Voxels the last relight() or settleSeams() changed the light of
+	int getLastVoxelsChanged() const { return m_voxelsChanged; }
+
+private:
+	// A voxel of a loaded chunk, chunk is null if the voxel's chunk isn't loaded
+	struct Cell {
+		VoxelChunk* chunk = nullptr;
+		glm::ivec3 position;
+		glm::ivec3 local;
+		int index = 0;
+	};
+
+	struct Darkened {
+		glm::ivec3 position;
+		// Light it had before
+		int level;
+	};
+
+	const ChunkMap& m_chunks;
+	OpenSkyTest m_openSky;
+	// Runs of lookups mostly stay in one chunk
+	long long m_cachedKey;
+	VoxelChunk* m_cachedChunk;
+	ChangedChunks* m_changed;
+	int m_voxelsChanged;
+	std::vector<Darkened> m_darken;
+	std::vector<glm::ivec3> m_spread;
+
+	void begin(ChangedChunks& changed);
+	Cell find(glm::ivec3 position);
+	// The voxel at local in the chunk at coords, without looking the chunk up
+	static Cell cellIn(VoxelChunk* chunk, glm::ivec3 coords, glm::ivec3 local);
+	void setLevel(const Cell& cell, LightChannel channel, int level);
+	// Only for a cell in the top layer of its chunk
+	bool underOpenSky(const Cell& cell) const;
+	// Takes away the light the queued voxels passed on, queueing the voxels lit from
+	// elsewhere at the edge of the darkened area for spread()
+	void darken(LightChannel channel);
+	// Floods light out from the queued voxels
+	void spread(LightChannel channel);
+};
+
+#endif
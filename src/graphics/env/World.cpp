@@ -4,276 +4,1072 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstdio>
 #include <thread>
 
-World::World(int renderDist, unsigned int seed)
+namespace {
+	const Face allFaces[] = { Face::FRONT, Face::BACK, Face::LEFT, Face::RIGHT, Face::TOP, Face::BOTTOM };
+
+	// Surface height is baseTerrainHeight +- terrainVariation, each biome scales and shifts
+	// the noise within that range; below sea level the surface is the biome's shore block
+	const int baseTerrainHeight = 32;
+	const int terrainVariation = 16;
+	const int seaLevel = 34;
+	// Noise coordinates per block of the density field; the height noise comes from the terrain graph
+	const double densityScale = 0.025;
+	// The 3D noise outweighs the height gradient over a few blocks, which is what makes
+	// overhangs. Density terrain stays within densityReach of baseTerrainHeight.
+	const double densityNoiseWeight = 3.0;
+	const int densityReach = static_cast<int>(densityNoiseWeight * terrainVariation);
+	// Density is sampled every densityCellWidth x densityCellHeight x densityCellWidth voxels
+	// and trilinearly interpolated in between
+	const int densityCellWidth = 4;
+	const int densityCellHeight = 8;
+	// Density columns look this far past the top of a chunk, deep enough for any biome's soil
+	const int soilDepth = BiomeMap::MAX_SOIL_DEPTH;
+
+	// FNV-1a, tells terrain graphs apart in save directory names
+	uint32_t hashText(const std::string& text) {
+		uint32_t hash = 2166136261u;
+		for (char c : text) {
+			hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+		}
+		return hash;
+	}
+
+	float heightFromNoise(double noiseValue, const BiomeColumn& biome) {
+		return static_cast<float>(baseTerrainHeight + static_cast<int>(biome.heightOffset + noiseValue * terrainVariation * biome.variationScale));
+	}
+
+	// Chunk coordinate step towards the neighbour on the given side
+	glm::ivec3 chunkOffset(Face face) {
+		switch (face) {
+		case Face::LEFT:   return glm::ivec3(-1, 0, 0);
+		case Face::RIGHT:  return glm::ivec3(1, 0, 0);
+		case Face::BACK:   return glm::ivec3(0, 0, -1);
+		case Face::FRONT:  return glm::ivec3(0, 0, 1);
+		case Face::BOTTOM: return glm::ivec3(0, -1, 0);
+		case Face::TOP:    return glm::ivec3(0, 1, 0);
+		default:           return glm::ivec3(0);
+		}
+	}
+}
+
+World::World(int renderDist, unsigned int seed, SaveMode saveMode)
 	: renderDistance(renderDist),
+	verticalRenderDistance(3),
 	worldSeed(seed),
 	lastPlayerPos(0.0f),
 	worldNoise(seed),
-	m_isRunning(true) {
+	m_biomes(seed),
+	m_terrainGraph(seed),
+	m_features(seed),
+	m_featuresPlaced(0),
+	m_lateFeatureMerges(0),
+	m_isRunning(true),
+	m_chunkJobsInFlight(0),
+	m_saveMode(saveMode),
+	m_focusChunk(0),
+	m_focusDirection(0.0f),
+	m_loadCenter(0),
+	m_loadRadius(renderDist + 2),
+	m_loadHeight(verticalRenderDistance + 1),
+	m_cancelledQueued(0),
+	m_cancelledBeforeGeneration(0),
+	m_cancelledBeforeMeshing(0),
+	m_cancelledBeforeUpload(0),
+	m_meshingMode(MeshingMode::NAIVE),
+	m_terrainMode(TerrainMode::HEIGHTMAP),
+	m_totalMeshingMs(0.0),
+	m_meshedChunks(0),
+	m_totalEditMicroseconds(0.0),
+	m_totalRelightMicroseconds(0.0),
+	m_seamRelights(0),
+	m_frame(0),
+	m_remeshedQueue(256),
+	m_lastUpdateTime(std::chrono::steady_clock::now()),
+	m_hasPendingUpload(false),
+	m_drawCalls(0),
+	m_materialDrawCalls(0),
+	m_frustumCulling(true),
+	m_visibleChunks(0),
+	m_culledChunks(0),
+	m_light(chunks, [this](int chunkY) { return isOpenSky(chunkY); }) {
 	std::cout << "Created world with render distance: " << renderDistance << std::endl;
-
-	unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
-	std::cout << "Starting " << numThreads << " chunk worker threads." << std::endl;
-	for (unsigned int i = 0; i < numThreads; ++i) {
-		m_chunkWorkers.emplace_back(&World::chunkWorkerLoop, this);
+	std::cout << "Building chunks on " << JobSystem::get().getWorkerCount() << " job worker threads." << std::endl;
+	if (!loadTerrainGraph("assets/terrain.graph")) {
+		std::cout << "Using the default terrain graph" << std::endl;
 	}
 }
 
 World::~World() {
-	std::cout << "Stopping worker threads..." << std::endl;
+	std::cout << "Waiting for chunk jobs..." << std::endl;
 	m_isRunning = false;
-	m_chunksToLoadQueue.stop();
-	for (auto& worker : m_chunkWorkers) {
-		if (worker.joinable()) {
-			worker.join();
-		}
-	}
-	std::cout << "Worker threads stopped." << std::endl;
+	// the jobs still submitted find the queue empty and finish straight away
+	std::vector<glm::ivec3> dropped;
+	m_chunksToLoadQueue.removeIf([](glm::ivec3) { return true; }, dropped);
+	JobSystem::get().waitUntil([this] { return m_chunkJobsInFlight == 0; });
+	std::cout << "Chunk jobs finished." << std::endl;
 	cleanup();
 }
 
-long long World::getChunkKey(int chunkX, int chunkZ) {
-	return (static_cast<long long>(chunkX) << 32) | (static_cast<long long>(chunkZ) & 0xFFFFFFFF);
+long long World::getChunkKey(int chunkX, int chunkY, int chunkZ) {
+	return packChunkKey(chunkX, chunkY, chunkZ);
+}
+
+glm::ivec3 World::getChunkCoords(long long key) {
+	return unpackChunkKey(key);
 }
 
-void World::getChunkCoords(glm::vec3 worldPos, int& chunkX, int& chunkZ) {
-	chunkX = static_cast<int>(std::floor(worldPos.x / CHUNK_SIZE));
-	chunkZ = static_cast<int>(std::floor(worldPos.z / CHUNK_SIZE));
+glm::ivec3 World::getChunkCoords(glm::vec3 worldPos) const {
+	return glm::ivec3(glm::floor(worldPos / static_cast<float>(CHUNK_SIZE)));
 }
 
 float World::getTerrainHeight(float worldX, float worldZ) {
-	double noiseValue = worldNoise.fractalNoise(worldX * 0.01, worldZ * 0.01, 4, 0.5, 1.0);
-	int baseHeight = CHUNK_HEIGHT;
-	int variation = CHUNK_SIZE;
-	int height = baseHeight + static_cast<int>(noiseValue * variation);
-	return std::max(0.0f, std::min(static_cast<float>(height), 63.0f));
+	return static_cast<float>(getColumnTop(static_cast<int>(std::floor(worldX)), static_cast<int>(std::floor(worldZ))));
+}
+
+int World::getColumnTop(int worldX, int worldZ) {
+	glm::ivec3 coords = getChunkCoords(glm::vec3(worldX, 0.0f, worldZ));
+	int localX = worldX - coords.x * CHUNK_SIZE;
+	int localZ = worldZ - coords.z * CHUNK_SIZE;
+
+	// From the top of the loaded layers down. Heightmap terrain is solid all the way down
+	// from its surface, so an unloaded chunk the surface reaches ends the search.
+	glm::ivec3 center = getChunkCoords(static_cast<long long>(m_loadCenter));
+	int ceiling = baseTerrainHeight + (m_terrainMode == TerrainMode::DENSITY ? densityReach : terrainVariation);
+	int topLayer = std::max(center.y + m_loadHeight, ceiling / CHUNK_HEIGHT);
+	int generatedTop = 0;
+	bool generatedKnown = false;
+	for (int chunkY = topLayer; ; chunkY--) {
+		int bottom = chunkY * CHUNK_HEIGHT;
+		VoxelChunk* chunk = getChunk(coords.x, chunkY, coords.z);
+		if (chunk) {
+			int8_t top = chunk->getHeightmap().get(localX, localZ);
+			if (top != ChunkHeightmap::EMPTY) {
+				return bottom + top;
+			}
+			continue;
+		}
+		if (bottom > ceiling) {
+			continue;
+		}
+		if (m_terrainMode == TerrainMode::DENSITY) {
+			// the density field has no closed form top, generate the chunk it would be in
+			ChunkStorage generated;
+			generateDensityTerrain(coords.x, chunkY, coords.z, generated);
+			for (int y = CHUNK_HEIGHT - 1; y >= 0; y--) {
+				if (generated.isSolid(localX, y, localZ)) return bottom + y;
+			}
+			continue;
+		}
+		if (!generatedKnown) {
+			generatedTop = static_cast<int>(getGeneratedHeight(static_cast<float>(worldX), static_cast<float>(worldZ)));
+			generatedKnown = true;
+		}
+		if (bottom <= generatedTop) {
+			return std::min(generatedTop, bottom + CHUNK_HEIGHT - 1);
+		}
+	}
 }
 
-VoxelType World::getBlockType(float worldX, float worldY, float worldZ, float terrainHeight) {
-	int seaLevel = 34;
-	int y = static_cast<int>(worldY);
+float World::getGeneratedHeight(float worldX, float worldZ) {
+	int x = static_cast<int>(std::floor(worldX));
+	int z = static_cast<int>(std::floor(worldZ));
+	glm::ivec3 coords = getChunkCoords(glm::vec3(x, 0.0f, z));
+	const BiomeColumn& biome = m_biomes.regionFor(coords.x, coords.z)->at(x, z);
+	return heightFromNoise(m_terrainGraph.evaluate(worldX, worldZ), biome);
+}
+
+bool World::loadTerrainGraph(const std::string& path) {
+	if (!m_terrainGraph.load(path)) {
+		return false;
+	}
+	std::cout << "Terrain graph " << path << ": " << m_terrainGraph.getNodeCount() << " nodes compiled to "
+		<< m_terrainGraph.getStepCount() << " steps" << std::endl;
+	return true;
+}
+
+VoxelType World::getBlockType(float worldX, float worldY, float worldZ, float terrainHeight, Biome biome) {
+	int y = static_cast<int>(std::floor(worldY));
 
 	if (y > terrainHeight) return VoxelType::AIR;
 
-	if (terrainHeight < seaLevel && y <= terrainHeight) {
-		return VoxelType::SAND;
+	int surfaceY = static_cast<int>(terrainHeight);
+	return BiomeMap::blockAt(biome, surfaceY - y, surfaceY, seaLevel);
+}
+
+Biome World::getBiomeAt(int worldX, int worldZ) {
+	glm::ivec3 coords = getChunkCoords(glm::vec3(worldX, 0.0f, worldZ));
+	return m_biomes.regionFor(coords.x, coords.z)->at(worldX, worldZ).biome;
+}
+
+void World::generateTerrain(int chunkX, int chunkY, int chunkZ, ChunkStorage& voxels) {
+	if (m_terrainMode == TerrainMode::DENSITY) {
+		generateDensityTerrain(chunkX, chunkY, chunkZ, voxels);
+	}
+	else {
+		generateHeightmapTerrain(chunkX, chunkY, chunkZ, voxels);
 	}
+}
 
-	if (y == static_cast<int>(terrainHeight)) {
-		return VoxelType::GRASS;
+void World::generateHeightmapTerrain(int chunkX, int chunkY, int chunkZ, ChunkStorage& voxels) {
+	int bottom = chunkY * CHUNK_HEIGHT;
+	// fractalNoise stays within [-1, 1], nothing reaches this high
+	if (bottom > baseTerrainHeight + terrainVariation) {
+		return;
 	}
-	else if (y >= static_cast<int>(terrainHeight) - 3) {
-		return VoxelType::DIRT;
+
+	// every column's height in one batch, the same values getGeneratedHeight gives
+	double heights[CHUNK_SIZE * CHUNK_SIZE];
+	m_terrainGraph.evaluateGrid(heights, CHUNK_SIZE, CHUNK_SIZE, chunkX * CHUNK_SIZE, chunkZ * CHUNK_SIZE);
+	std::shared_ptr<const BiomeRegion> biomes = m_biomes.regionFor(chunkX, chunkZ);
+
+	for (int localX = 0; localX < CHUNK_SIZE; localX++) {
+		for (int localZ = 0; localZ < CHUNK_SIZE; localZ++) {
+			int worldX = chunkX * CHUNK_SIZE + localX;
+			int worldZ = chunkZ * CHUNK_SIZE + localZ;
+			const BiomeColumn& biome = biomes->at(worldX, worldZ);
+			float terrainHeight = heightFromNoise(heights[localZ * CHUNK_SIZE + localX], biome);
+			int top = std::min(CHUNK_HEIGHT - 1, static_cast<int>(terrainHeight) - bottom);
+			for (int y = 0; y <= top; y++) {
+				voxels.set(localX, y, localZ, getBlockType(static_cast<float>(worldX), static_cast<float>(bottom + y), static_cast<float>(worldZ), terrainHeight, biome.biome));
+			}
+		}
 	}
-	else {
-		return VoxelType::COBBLESTONE;
+}
+
+void World::decorateChunk(glm::ivec3 coords, ChunkStorage& voxels) {
+	std::vector<FeaturePlacer::Write> outside;
+	m_featuresPlaced += m_features.decorate(coords, voxels, m_biomes, outside);
+
+	long long key = getChunkKey(coords.x, coords.y, coords.z);
+	std::unordered_map<long long, std::vector<PendingWrites::Write>> targets;
+	for (const FeaturePlacer::Write& write : outside) {
+		glm::ivec3 target = getChunkCoords(glm::vec3(write.position));
+		glm::ivec3 local = write.position - target * CHUNK_SIZE;
+		PendingWrites::Write pending;
+		pending.index = static_cast<uint16_t>(ChunkStorage::index(local.x, local.y, local.z));
+		pending.type = static_cast<uint8_t>(write.type);
+		targets[getChunkKey(target.x, target.y, target.z)].push_back(pending);
+	}
+	for (auto& target : targets) {
+		m_pendingWrites.push(key, target.first, std::move(target.second));
+	}
+}
+
+void World::applyFeatureWrites(glm::ivec3 coords, ChunkStorage& voxels) {
+	// after this chunk's own features, which only look at bare terrain for their roots
+	m_pendingWrites.claim(getChunkKey(coords.x, coords.y, coords.z), voxels);
+}
+
+double World::sampleDensity(int worldX, int worldY, int worldZ) {
+	// falls off with height, one unit per terrainVariation blocks
+	double gradient = static_cast<double>(baseTerrainHeight - worldY) / terrainVariation;
+	return gradient + densityNoiseWeight * worldNoise.fractalNoise3D(worldX * densityScale, worldY * densityScale, worldZ * densityScale, 4, 0.5, 1.0);
+}
+
+void World::generateDensityTerrain(int chunkX, int chunkY, int chunkZ, ChunkStorage& voxels) {
+	int bottom = chunkY * CHUNK_HEIGHT;
+	if (bottom > baseTerrainHeight + densityReach) {
+		return;
+	}
+	// far enough down that the gradient outweighs any noise
+	if (bottom + CHUNK_HEIGHT + soilDepth < baseTerrainHeight - densityReach) {
+		for (int y = 0; y < CHUNK_HEIGHT; y++) {
+			for (int z = 0; z < CHUNK_SIZE; z++) {
+				for (int x = 0; x < CHUNK_SIZE; x++) {
+					voxels.set(x, y, z, VoxelType::COBBLESTONE);
+				}
+			}
+		}
+		return;
+	}
+
+	// The lattice reaches soilDepth voxels past the top so the top layers know what's above them
+	const int pointsXZ = CHUNK_SIZE / densityCellWidth + 1;
+	const int cellsY = (CHUNK_HEIGHT + soilDepth + densityCellHeight - 1) / densityCellHeight;
+	const int pointsY = cellsY + 1;
+	const int columnHeight = cellsY * densityCellHeight;
+	int originX = chunkX * CHUNK_SIZE;
+	int originZ = chunkZ * CHUNK_SIZE;
+
+	double lattice[pointsXZ][pointsY][pointsXZ];
+	for (int i = 0; i < pointsXZ; i++) {
+		for (int j = 0; j < pointsY; j++) {
+			for (int k = 0; k < pointsXZ; k++) {
+				lattice[i][j][k] = sampleDensity(originX + i * densityCellWidth, bottom + j * densityCellHeight, originZ + k * densityCellWidth);
+			}
+		}
+	}
+
+	std::shared_ptr<const BiomeRegion> biomes = m_biomes.regionFor(chunkX, chunkZ);
+	double levels[pointsY];
+	double density[columnHeight];
+	for (int localX = 0; localX < CHUNK_SIZE; localX++) {
+		for (int localZ = 0; localZ < CHUNK_SIZE; localZ++) {
+			Biome biome = biomes->at(originX + localX, originZ + localZ).biome;
+			int i = localX / densityCellWidth;
+			int k = localZ / densityCellWidth;
+			double tx = static_cast<double>(localX % densityCellWidth) / densityCellWidth;
+			double tz = static_cast<double>(localZ % densityCellWidth) / densityCellWidth;
+
+			// bilinear in x and z at every lattice height, then linear in y between them
+			for (int j = 0; j < pointsY; j++) {
+				double front = lattice[i][j][k] + tx * (lattice[i + 1][j][k] - lattice[i][j][k]);
+				double back = lattice[i][j][k + 1] + tx * (lattice[i + 1][j][k + 1] - lattice[i][j][k + 1]);
+				levels[j] = front + tz * (back - front);
+			}
+			for (int y = 0; y < columnHeight; y++) {
+				int j = y / densityCellHeight;
+				double ty = static_cast<double>(y % densityCellHeight) / densityCellHeight;
+				density[y] = levels[j] + ty * (levels[j + 1] - levels[j]);
+			}
+
+			// Top down, counting the solid voxels since the last air gap
+			int depth = -1;
+			int surfaceY = 0;
+			for (int y = columnHeight - 1; y >= 0; y--) {
+				if (density[y] <= 0.0) {
+					depth = -1;
+					continue;
+				}
+				depth++;
+				if (depth == 0) {
+					surfaceY = bottom + y;
+				}
+				if (y >= CHUNK_HEIGHT) {
+					continue;
+				}
+
+				voxels.set(localX, y, localZ, BiomeMap::blockAt(biome, depth, surfaceY, seaLevel));
+			}
+		}
 	}
 }
 
-void World::update(glm::vec3 playerPos) {
+void World::update(glm::vec3 playerPos, glm::vec3 viewDirection) {
+	if (!m_regions && !m_journal) {
+		openSave();
+	}
+
+	// Re-sort the pending chunks when the player enters another chunk or turns more than ~15 degrees
+	glm::ivec3 playerChunk = getChunkCoords(playerPos);
+	glm::vec3 direction = glm::length(viewDirection) > 0.0f ? glm::normalize(viewDirection) : viewDirection;
+	if (playerChunk != m_focusChunk || glm::dot(direction, m_focusDirection) < 0.966f) {
+		m_chunksToLoadQueue.setFocus(playerPos, direction);
+		m_focusChunk = playerChunk;
+		m_focusDirection = direction;
+	}
+
 	float distanceMoved = glm::length(playerPos - lastPlayerPos);
 	if (distanceMoved > 8.0f || glm::length(lastPlayerPos) == 0.0f) {
+		m_loadCenter = getChunkKey(playerChunk.x, playerChunk.y, playerChunk.z);
+		m_loadRadius = renderDistance + 2;
+		m_loadHeight = verticalRenderDistance + 1;
+		cancelStaleRequests();
 		generateChunksAroundPosition(playerPos);
 		unloadDistantChunks(playerPos);
 		lastPlayerPos = playerPos;
 	}
 
-	int uploadsThisFrame = 0;
-	const int maxUploadsPerFrame = 2;
-	ChunkMeshData meshData;
-	while (uploadsThisFrame < maxUploadsPerFrame && m_meshesToUploadQueue.try_pop(meshData)) {
+	auto now = std::chrono::steady_clock::now();
+	m_uploadScheduler.beginFrame(std::chrono::duration<double, std::milli>(now - m_lastUpdateTime).count());
+	m_lastUpdateTime = now;
+
+	// Edits first, the player is waiting on those
+	m_frame++;
+	applyEditRemeshes();
+	mergeLateWrites();
+	if (m_journal) {
+		m_journal->flush();
+	}
+
+	while (m_hasPendingUpload || m_meshesToUploadQueue.try_pop(m_pendingUpload)) {
+		m_hasPendingUpload = true;
+		ChunkMeshData& meshData = m_pendingUpload;
 		long long key = meshData.chunkKey;
 
+		// unloadDistantChunks would drop it again straight away, skip the GL upload
+		if (isStale(getChunkCoords(key))) {
+			cancelChunk(key);
+			m_cancelledBeforeUpload++;
+			m_hasPendingUpload = false;
+			continue;
+		}
+
+		// keep it for next frame if it's predicted to overrun this one
+		size_t bytes = meshData.memoryUsage();
+		if (!m_uploadScheduler.canUpload(bytes)) {
+			break;
+		}
+		m_hasPendingUpload = false;
+		if (!m_pipeline.start(key, ChunkStage::UPLOAD)) {
+			continue;
+		}
+
 		auto newChunk = std::make_unique<VoxelChunk>(meshData.chunkPosition, worldSeed);
 
-		// This now works because both are unordered_maps
 		newChunk->voxels = std::move(meshData.voxels);
+		newChunk->light = std::move(meshData.light);
+		newChunk->setHeightmap(meshData.heightmap);
+		m_totalMeshingMs += meshData.meshingTimeMs;
+
+		auto uploadStart = std::chrono::steady_clock::now();
+		newChunk->uploadMesh(std::make_shared<const ChunkMeshData>(std::move(meshData)));
+		auto seamStart = std::chrono::steady_clock::now();
+		double uploadMs = std::chrono::duration<double, std::milli>(seamStart - uploadStart).count();
 
-		newChunk->uploadMesh(meshData);
+		m_meshedChunks++;
+		queueSeamReculls(getChunkCoords(key), newChunk.get());
 		chunks[key] = std::move(newChunk);
 
-		{
-			std::lock_guard<std::mutex> lock(m_worldMutex);
-			m_generatingChunks.erase(key);
+		// Light the neighbours got to first, or that the chunk's stages ran ahead of
+		VoxelLight::ChangedChunks relit;
+		m_light.settleSeams(getChunkCoords(key), relit);
+		remeshRelit(relit, now);
+		m_seamRelights += relit.size();
+		double seamMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - seamStart).count();
+		m_uploadScheduler.recordUpload(bytes, uploadMs, seamMs);
+
+		std::vector<ChunkPipeline::Ready> ready;
+		m_pipeline.complete(key, ChunkStage::UPLOAD, uploadMs + seamMs, ready);
+		submitStages(ready);
+	}
+
+	// Only a snapshot each on this thread now, the meshing runs on a job and the upload
+	// waits for the budget. Still a few per frame, so a chunk whose neighbours arrive over
+	// the next frames tends to be remeshed once for all of them.
+	int recullsThisFrame = 0;
+	const int maxRecullsPerFrame = 8;
+	while (recullsThisFrame < maxRecullsPerFrame && !m_chunksToRecull.empty()) {
+		long long key = *m_chunksToRecull.begin();
+		m_chunksToRecull.erase(m_chunksToRecull.begin());
+
+		auto it = chunks.find(key);
+		if (it != chunks.end()) {
+			queueEditRemesh(getChunkCoords(key), it->second.get(), now, true);
+			recullsThisFrame++;
+		}
+	}
+}
+
+bool World::isOpenSky(int chunkY) const {
+	int ceiling = baseTerrainHeight + (m_terrainMode == TerrainMode::DENSITY ? densityReach : terrainVariation) + FeaturePlacer::MAX_HEIGHT;
+	return (chunkY + 1) * CHUNK_HEIGHT > ceiling;
+}
+
+bool World::isStale(glm::ivec3 coords) const {
+	glm::ivec3 center = getChunkCoords(static_cast<long long>(m_loadCenter));
+	int radius = m_loadRadius;
+	int dx = coords.x - center.x;
+	int dz = coords.z - center.z;
+	return dx * dx + dz * dz > radius * radius || std::abs(coords.y - center.y) > m_loadHeight;
+}
+
+void World::cancelChunk(long long key) {
+	std::vector<ChunkPipeline::Ready> ready;
+	m_pipeline.remove(key, ready);
+	{
+		std::lock_guard<std::mutex> lock(m_bordersMutex);
+		m_chunkBorders.erase(key);
+	}
+	// neighbours that were waiting on it go ahead without it
+	submitStages(ready);
+}
+
+void World::cancelStaleRequests() {
+	std::vector<glm::ivec3> removed;
+	m_chunksToLoadQueue.removeIf([this](glm::ivec3 coords) { return isStale(coords); }, removed);
+	for (const glm::ivec3& coords : removed) {
+		cancelChunk(getChunkKey(coords.x, coords.y, coords.z));
+	}
+	m_cancelledQueued += removed.size();
+}
+
+ChunkCancelStats World::getCancelStats() const {
+	ChunkCancelStats stats;
+	stats.queued = m_cancelledQueued;
+	stats.beforeGeneration = m_cancelledBeforeGeneration;
+	stats.beforeMeshing = m_cancelledBeforeMeshing;
+	stats.beforeUpload = m_cancelledBeforeUpload;
+	return stats;
+}
+
+void World::publishBorders(long long key, const ChunkBorders& borders) {
+	std::lock_guard<std::mutex> lock(m_bordersMutex);
+	m_chunkBorders[key] = borders;
+}
+
+ChunkNeighbors World::gatherNeighbors(glm::ivec3 coords) {
+	ChunkNeighbors neighbors;
+	std::lock_guard<std::mutex> lock(m_bordersMutex);
+	for (Face face : allFaces) {
+		glm::ivec3 next = coords + chunkOffset(face);
+		auto it = m_chunkBorders.find(getChunkKey(next.x, next.y, next.z));
+		if (it != m_chunkBorders.end()) {
+			neighbors.edges[static_cast<int>(face)] = it->second[static_cast<int>(VoxelChunk::oppositeFace(face))];
+		}
+	}
+	return neighbors;
+}
+
+void World::queueSeamReculls(glm::ivec3 coords, VoxelChunk* chunk) {
+	const ChunkBorders* borders = nullptr;
+	std::lock_guard<std::mutex> lock(m_bordersMutex);
+	auto own = m_chunkBorders.find(getChunkKey(coords.x, coords.y, coords.z));
+	if (own != m_chunkBorders.end()) {
+		borders = &own->second;
+	}
+
+	for (Face face : allFaces) {
+		glm::ivec3 next = coords + chunkOffset(face);
+		VoxelChunk* neighbor = getChunk(next.x, next.y, next.z);
+		if (!neighbor) continue;
+
+		// Either side may have been meshed before the other's borders were published
+		if (!(chunk->getNeighborMask() & (1 << static_cast<int>(face)))) {
+			m_chunksToRecull.insert(getChunkKey(coords.x, coords.y, coords.z));
 		}
+		// A chunk without air took this missing one for solid, it needs faces where this side has air
+		bool opensNeighbor = borders && !(*borders)[static_cast<int>(face)]->full && neighbor->voxels.isFull();
+		if (!(neighbor->getNeighborMask() & (1 << static_cast<int>(VoxelChunk::oppositeFace(face)))) || opensNeighbor) {
+			m_chunksToRecull.insert(getChunkKey(next.x, next.y, next.z));
+		}
+	}
+}
+
+void World::onBlockChanged(glm::ivec3 coords, glm::ivec3 local) {
+	auto start = std::chrono::steady_clock::now();
+	long long key = getChunkKey(coords.x, coords.y, coords.z);
+
+	// Light first, the remeshes have to see it
+	VoxelLight::ChangedChunks remesh;
+	m_light.relight(coords * CHUNK_SIZE + local, remesh);
+	double relightMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	m_totalRelightMicroseconds += relightMicroseconds;
+	m_editStats.lastRelightMicroseconds = relightMicroseconds;
+	m_editStats.lastRelitVoxels = m_light.getLastVoxelsChanged();
+	m_editStats.lastRelitChunks = static_cast<int>(remesh.size());
+
+	bool onBorder = local.x == 0 || local.x == CHUNK_SIZE - 1 || local.y == 0 || local.y == CHUNK_HEIGHT - 1 ||
+		local.z == 0 || local.z == CHUNK_SIZE - 1;
+	remesh.insert(key);
+
+	// The neighbour's face towards this block may have appeared or disappeared
+	if (onBorder) {
+		for (Face face : allFaces) {
+			glm::ivec3 offset = chunkOffset(face);
+			glm::ivec3 across = local + offset;
+			if (ChunkStorage::inBounds(across.x, across.y, across.z)) continue;
+
+			glm::ivec3 next = coords + offset;
+			if (getChunk(next.x, next.y, next.z)) {
+				remesh.insert(getChunkKey(next.x, next.y, next.z));
+			}
+		}
+	}
+	remeshRelit(remesh, start);
+
+	double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	m_totalEditMicroseconds += microseconds;
+	m_editStats.edits++;
+	m_editStats.lastMicroseconds = microseconds;
+	m_editStats.averageMicroseconds = m_totalEditMicroseconds / m_editStats.edits;
+	m_editStats.averageRelightMicroseconds = m_totalRelightMicroseconds / m_editStats.edits;
+	m_editStats.lastRemeshes = static_cast<int>(remesh.size());
+}
+
+void World::remeshRelit(const VoxelLight::ChangedChunks& relit, std::chrono::steady_clock::time_point editTime) {
+	// every border first, so each remesh sees its neighbours' new light
+	for (long long key : relit) {
+		auto it = chunks.find(key);
+		if (it != chunks.end()) {
+			publishBorders(key, VoxelChunk::extractBorders(it->second->voxels, &it->second->light));
+		}
+	}
+	for (long long key : relit) {
+		auto it = chunks.find(key);
+		if (it != chunks.end()) {
+			queueEditRemesh(getChunkCoords(key), it->second.get(), editTime);
+		}
+	}
+}
+
+void World::queueEditRemesh(glm::ivec3 coords, VoxelChunk* chunk, std::chrono::steady_clock::time_point editTime, bool budgeted) {
+	uint32_t version = chunk->markEdited();
+	std::shared_ptr<const ChunkStorage> voxels = std::make_shared<ChunkStorage>(chunk->voxels);
+	std::shared_ptr<const ChunkLight> light = std::make_shared<ChunkLight>(chunk->light);
+	ChunkNeighbors neighbors = gatherNeighbors(coords);
+	neighbors.missingIsSolid = voxels->isFull();
+	MeshingMode mode = m_meshingMode;
+	long long key = getChunkKey(coords.x, coords.y, coords.z);
+	unsigned int frame = m_frame;
+
+	m_chunkJobsInFlight++;
+	JobSystem::get().submit([this, voxels, light, neighbors, mode, key, version, frame, editTime, budgeted] {
+		auto start = std::chrono::steady_clock::now();
+		std::shared_ptr<ChunkMeshData> fresh = std::make_shared<ChunkMeshData>();
+		VoxelChunk::buildMeshData(*voxels, neighbors, *fresh, mode, light.get());
+
+		EditRemesh result;
+		result.chunkKey = key;
+		result.version = version;
+		result.geometry = fresh;
+		result.meshingMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		result.editFrame = frame;
+		result.editTime = editTime;
+		result.budgeted = budgeted;
+		// more edits than the queue holds can land in one frame; once the world is shutting
+		// down nobody drains it any more, so give up instead of waiting for room
+		while (!m_remeshedQueue.try_push(result) && m_isRunning) {
+			std::this_thread::yield();
+		}
+		m_chunkJobsInFlight--;
+	}, {}, JobPriority::HIGH);
+}
+
+void World::applyEditRemeshes() {
+	// Drained completely every frame so the jobs never wait for room in the queue
+	EditRemesh result;
+	while (m_remeshedQueue.try_pop(result)) {
+		if (result.budgeted) {
+			m_budgetedRemeshes.push_back(std::move(result));
+			continue;
+		}
+		auto it = chunks.find(result.chunkKey);
+		size_t bytes = result.geometry->memoryUsage();
+		auto uploadStart = std::chrono::steady_clock::now();
+		if (it == chunks.end() || !it->second->applyRemesh(result.version, std::move(result.geometry))) {
+			m_editStats.staleRemeshes++;
+			continue;
+		}
+		auto uploadEnd = std::chrono::steady_clock::now();
+		m_uploadScheduler.recordUpload(bytes, std::chrono::duration<double, std::milli>(uploadEnd - uploadStart).count());
+		m_editStats.lastLatencyMs = std::chrono::duration<double, std::milli>(uploadEnd - result.editTime).count();
+		m_editStats.lastLatencyFrames = static_cast<int>(m_frame - result.editFrame);
+		m_editStats.lastRemeshMicroseconds = result.meshingMicroseconds;
+	}
+
+	while (!m_budgetedRemeshes.empty()) {
+		EditRemesh& next = m_budgetedRemeshes.front();
+		auto it = chunks.find(next.chunkKey);
+		// a stale one costs nothing, drop it without asking the budget
+		if (it == chunks.end() || it->second->getMeshVersion() != next.version) {
+			m_budgetedRemeshes.pop_front();
+			continue;
+		}
+		size_t bytes = next.geometry->memoryUsage();
+		if (!m_uploadScheduler.canUpload(bytes)) {
+			break;
+		}
+		auto uploadStart = std::chrono::steady_clock::now();
+		it->second->applyRemesh(next.version, std::move(next.geometry));
+		m_uploadScheduler.recordUpload(bytes, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count());
+		// whole chunk meshes like the pipeline's, they count towards the meshing average
+		m_totalMeshingMs += next.meshingMicroseconds / 1000.0;
+		m_meshedChunks++;
+		m_budgetedRemeshes.pop_front();
+	}
+}
 
-		uploadsThisFrame++;
+void World::mergeLateWrites() {
+	m_pendingWrites.takeLate(m_lateWrites);
+	if (m_lateWrites.empty()) {
+		return;
 	}
+
+	auto now = std::chrono::steady_clock::now();
+	std::vector<PendingWrites::Batch> waiting;
+	for (PendingWrites::Batch& batch : m_lateWrites) {
+		auto it = chunks.find(batch.target);
+		if (it == chunks.end()) {
+			// Still on its way through the pipeline, try again next frame. Anything else
+			// was dropped, and its next generation claims these writes with the rest.
+			if (m_pipeline.contains(batch.target)) {
+				waiting.push_back(std::move(batch));
+			}
+			continue;
+		}
+
+		// a changed chunk is saved whole in REGION_FILES mode, with whatever features it had
+		if (m_modifiedChunks.count(batch.target)) {
+			continue;
+		}
+		glm::ivec3 coords = getChunkCoords(batch.target);
+		VoxelChunk* chunk = it->second.get();
+		VoxelLight::ChangedChunks remesh;
+		for (const PendingWrites::Write& write : batch.writes) {
+			glm::ivec3 local(write.index % CHUNK_SIZE, write.index / (CHUNK_SIZE * CHUNK_SIZE), (write.index / CHUNK_SIZE) % CHUNK_SIZE);
+			VoxelType type = static_cast<VoxelType>(write.type);
+			// the player's edits win over features, like they do at generation
+			if (!FeaturePlacer::replaces(chunk->getBlockType(local.x, local.y, local.z), type) ||
+				(m_journal && m_journal->hasEdit(coords, local))) {
+				continue;
+			}
+			chunk->setBlock(local.x, local.y, local.z, type);
+			remesh.insert(batch.target);
+
+			VoxelLight::ChangedChunks relit;
+			m_light.relight(coords * CHUNK_SIZE + local, relit);
+			remesh.insert(relit.begin(), relit.end());
+		}
+		if (!remesh.empty()) {
+			remeshRelit(remesh, now);
+			m_lateFeatureMerges++;
+		}
+	}
+	m_lateWrites.swap(waiting);
 }
 
 void World::setBlock(int worldX, int worldY, int worldZ, VoxelType type) {
-	int chunkX, chunkZ;
-	getChunkCoords(glm::vec3(worldX, worldY, worldZ), chunkX, chunkZ);
-	VoxelChunk* chunk = getChunk(chunkX, chunkZ);
+	glm::ivec3 coords = getChunkCoords(glm::vec3(worldX, worldY, worldZ));
+	VoxelChunk* chunk = getChunk(coords.x, coords.y, coords.z);
 
 	if (chunk) {
-		int localX = worldX - (chunkX * CHUNK_SIZE);
-		int localZ = worldZ - (chunkZ * CHUNK_SIZE);
+		glm::ivec3 local = glm::ivec3(worldX, worldY, worldZ) - coords * CHUNK_SIZE;
 
-		chunk->setBlock(localX, worldY, localZ, type);
-		chunk->rebuildMesh();
+		chunk->setBlock(local.x, local.y, local.z, type);
+		recordEdit(coords, local, type);
+		onBlockChanged(coords, local);
 	}
 }
 
 void World::placeBlock(int worldX, int worldY, int worldZ, VoxelType type) {
-	int chunkX, chunkZ;
-	getChunkCoords(glm::vec3(worldX, worldY, worldZ), chunkX, chunkZ);
-	VoxelChunk* chunk = getChunk(chunkX, chunkZ);
+	glm::ivec3 coords = getChunkCoords(glm::vec3(worldX, worldY, worldZ));
+	VoxelChunk* chunk = getChunk(coords.x, coords.y, coords.z);
 
 	if (chunk) {
-		int localX = worldX - (chunkX * CHUNK_SIZE);
-		int localZ = worldZ - (chunkZ * CHUNK_SIZE);
-
-		chunk->voxels[localX][worldY][localZ] = type;
+		glm::ivec3 local = glm::ivec3(worldX, worldY, worldZ) - coords * CHUNK_SIZE;
 
-		//chunk->setBlock(localX, worldY, localZ, type);
-		chunk->rebuildMesh();
+		chunk->setBlock(local.x, local.y, local.z, type);
+		recordEdit(coords, local, type);
+		onBlockChanged(coords, local);
 	}
 	
 }
 
 VoxelType World::getBlockTypeAt(int worldX, int worldY, int worldZ) {
-	int chunkX, chunkZ;
-	getChunkCoords(glm::vec3(worldX, worldY, worldZ), chunkX, chunkZ);
-	VoxelChunk* chunk = getChunk(chunkX, chunkZ);
+	glm::ivec3 coords = getChunkCoords(glm::vec3(worldX, worldY, worldZ));
+	VoxelChunk* chunk = getChunk(coords.x, coords.y, coords.z);
 
 	if (chunk) {
-		int localX = worldX - (chunkX * CHUNK_SIZE);
-		int localZ = worldZ - (chunkZ * CHUNK_SIZE);
-		return chunk->getBlockType(localX, worldY, localZ);
+		glm::ivec3 local = glm::ivec3(worldX, worldY, worldZ) - coords * CHUNK_SIZE;
+		return chunk->getBlockType(local.x, local.y, local.z);
 	}
 	return VoxelType::AIR;
 }
 
 void World::generateChunksAroundPosition(glm::vec3 pos) {
-	int playerChunkX, playerChunkZ;
-	getChunkCoords(pos, playerChunkX, playerChunkZ);
-
-	for (int x = playerChunkX - renderDistance; x <= playerChunkX + renderDistance; x++) {
-		for (int z = playerChunkZ - renderDistance; z <= playerChunkZ + renderDistance; z++) {
-			if (shouldLoadChunk(x, z, playerChunkX, playerChunkZ)) {
-				long long key = getChunkKey(x, z);
-
-				std::lock_guard<std::mutex> lock(m_worldMutex);
-				if (chunks.find(key) == chunks.end() && m_generatingChunks.find(key) == m_generatingChunks.end()) {
-					m_generatingChunks.insert(key);
-					m_chunksToLoadQueue.push(glm::ivec2(x, z));
+	glm::ivec3 playerChunk = getChunkCoords(pos);
+
+	for (int x = playerChunk.x - renderDistance; x <= playerChunk.x + renderDistance; x++) {
+		for (int z = playerChunk.z - renderDistance; z <= playerChunk.z + renderDistance; z++) {
+			for (int y = playerChunk.y - verticalRenderDistance; y <= playerChunk.y + verticalRenderDistance; y++) {
+				glm::ivec3 coords(x, y, z);
+				if (!shouldLoadChunk(coords, playerChunk)) continue;
+				if (chunks.find(getChunkKey(x, y, z)) == chunks.end()) {
+					queueChunk(coords);
 				}
 			}
 		}
 	}
 }
 
-void World::chunkWorkerLoop() {
-	while (m_isRunning) {
-		glm::ivec2 chunkCoords;
-		if (!m_chunksToLoadQueue.wait_and_pop(chunkCoords)) {
-			continue;
-		}
+void World::queueChunk(glm::ivec3 coords) {
+	std::shared_ptr<ChunkJob> job = std::make_shared<ChunkJob>();
+	job->coords = coords;
+	job->meshData.chunkKey = getChunkKey(coords.x, coords.y, coords.z);
+	job->meshData.chunkPosition = glm::vec3(coords * CHUNK_SIZE);
+	if (!m_pipeline.add(job->meshData.chunkKey, job)) {
+		return;
+	}
+	m_chunksToLoadQueue.push(coords);
 
-		int chunkX = chunkCoords.x;
-		int chunkZ = chunkCoords.y;
+	m_chunkJobsInFlight++;
+	JobSystem::get().submit([this] {
+		runTerrainJob();
+		m_chunkJobsInFlight--;
+	});
+}
 
-		ChunkMeshData meshData;
-		meshData.chunkKey = getChunkKey(chunkX, chunkZ);
-		meshData.chunkPosition = glm::vec3(chunkX * 16.0f, 0.0f, chunkZ * 16.0f);
+void World::submitStages(const std::vector<ChunkPipeline::Ready>& ready) {
+	for (const ChunkPipeline::Ready& next : ready) {
+		ChunkStage stage = next.stage;
+		std::shared_ptr<ChunkJob> job = next.job;
+		m_chunkJobsInFlight++;
+		JobSystem::get().submit([this, stage, job] {
+			runStage(stage, *job);
+			m_chunkJobsInFlight--;
+		});
+	}
+}
 
-		for (int localX = 0; localX < 16; localX++) {
-			for (int localZ = 0; localZ < 16; localZ++) {
-				float worldX = chunkX * 16 + localX;
-				float worldZ = chunkZ * 16 + localZ;
-				float terrainHeight = getTerrainHeight(worldX, worldZ);
-				for (int y = 0; y < 64; y++) {
-					if (y <= terrainHeight) {
-						VoxelType blockType = getBlockType(worldX, y, worldZ, terrainHeight);
-						meshData.voxels[localX][y][localZ] = blockType;
-					}
-				}
-			}
+void World::runTerrainJob() {
+	// One job is submitted per push, so every queued chunk gets built
+	glm::ivec3 coords;
+	if (!m_isRunning || !m_chunksToLoadQueue.try_pop(coords)) {
+		return;
+	}
+	std::shared_ptr<ChunkJob> job = m_pipeline.start(getChunkKey(coords.x, coords.y, coords.z), ChunkStage::TERRAIN);
+	if (job) {
+		runStage(ChunkStage::TERRAIN, *job);
+	}
+}
+
+void World::runStage(ChunkStage stage, ChunkJob& job) {
+	if (!m_isRunning) {
+		return;
+	}
+	glm::ivec3 coords = job.coords;
+	ChunkMeshData& meshData = job.meshData;
+
+	// The player may have moved on while this waited for its turn or its neighbours
+	if (isStale(coords)) {
+		cancelChunk(meshData.chunkKey);
+		if (stage == ChunkStage::TERRAIN) {
+			m_cancelledBeforeGeneration++;
+		}
+		else {
+			m_cancelledBeforeMeshing++;
 		}
+		return;
+	}
 
-		auto hasVoxel = [&](int x, int y, int z) {
-			return meshData.voxels.count(x) && meshData.voxels.at(x).count(y) && meshData.voxels.at(x).at(y).count(z);
-			};
-
-		for (const auto& x_pair : meshData.voxels) {
-			int x = x_pair.first;
-			for (const auto& y_pair : x_pair.second) {
-				int y = y_pair.first;
-				for (const auto& z_pair : y_pair.second) {
-					int z = z_pair.first;
-					VoxelType currentType = z_pair.second;
-					glm::vec3 localVoxelPos(x, y, z);
-
-					if (currentType == VoxelType::GRASS) {
-						if (!hasVoxel(x, y + 1, z)) VoxelChunk::addFaceToMeshData(meshData.grassTopVertices, meshData.grassTopIndices, localVoxelPos, Face::TOP);
-						if (!hasVoxel(x, y - 1, z)) VoxelChunk::addFaceToMeshData(meshData.grassBottomVertices, meshData.grassBottomIndices, localVoxelPos, Face::BOTTOM);
-						if (!hasVoxel(x, y, z + 1)) VoxelChunk::addFaceToMeshData(meshData.grassSideVertices, meshData.grassSideIndices, localVoxelPos, Face::FRONT);
-						if (!hasVoxel(x, y, z - 1)) VoxelChunk::addFaceToMeshData(meshData.grassSideVertices, meshData.grassSideIndices, localVoxelPos, Face::BACK);
-						if (!hasVoxel(x - 1, y, z)) VoxelChunk::addFaceToMeshData(meshData.grassSideVertices, meshData.grassSideIndices, localVoxelPos, Face::LEFT);
-						if (!hasVoxel(x + 1, y, z)) VoxelChunk::addFaceToMeshData(meshData.grassSideVertices, meshData.grassSideIndices, localVoxelPos, Face::RIGHT);
-					}
-					else {
-						int typeIndex = static_cast<int>(currentType);
-						if (!hasVoxel(x, y, z + 1)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::FRONT);
-						if (!hasVoxel(x, y, z - 1)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::BACK);
-						if (!hasVoxel(x - 1, y, z)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::LEFT);
-						if (!hasVoxel(x + 1, y, z)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::RIGHT);
-						if (!hasVoxel(x, y + 1, z)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::TOP);
-						if (!hasVoxel(x, y - 1, z)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::BOTTOM);
-					}
-				}
+	auto start = std::chrono::steady_clock::now();
+	switch (stage) {
+	case ChunkStage::TERRAIN:
+		// chunks the player changed come back from disk, features and all, in REGION_FILES mode
+		job.fromSave = m_regions && m_regions->load(coords, meshData.voxels);
+		if (job.fromSave) {
+			m_pendingWrites.markSaved(meshData.chunkKey);
+		}
+		else {
+			generateTerrain(coords.x, coords.y, coords.z, meshData.voxels);
+		}
+		break;
+	case ChunkStage::FEATURES:
+		if (!job.fromSave) {
+			decorateChunk(coords, meshData.voxels);
+		}
+		else {
+			// The save has this chunk's own features, but what they reach into its neighbours
+			// still has to be queued. Grow them on the generated terrain and drop the rest.
+			ChunkStorage generated;
+			generateTerrain(coords.x, coords.y, coords.z, generated);
+			decorateChunk(coords, generated);
+		}
+		break;
+	case ChunkStage::LIGHT:
+		// every neighbour still being built has queued its features by now, and the
+		// player's edits go over all of them
+		if (!job.fromSave) {
+			applyFeatureWrites(coords, meshData.voxels);
+			if (m_journal) {
+				m_journal->apply(coords, meshData.voxels);
 			}
 		}
-		m_meshesToUploadQueue.push(std::move(meshData));
+		meshData.heightmap.build(meshData.voxels);
+		// the chunk above is lit already if it's being built, see ChunkPipeline
+		VoxelLight::lightChunk(meshData.voxels, gatherNeighbors(coords), isOpenSky(coords.y), meshData.light);
+		publishBorders(meshData.chunkKey, VoxelChunk::extractBorders(meshData.voxels, &meshData.light));
+		break;
+	case ChunkStage::MESH: {
+		ChunkNeighbors neighbors = gatherNeighbors(coords);
+		neighbors.missingIsSolid = meshData.voxels.isFull();
+		// the face neighbours lit after this chunk have their light out by now
+		if (VoxelLight::absorbNeighbors(meshData.voxels, neighbors, meshData.light)) {
+			publishBorders(meshData.chunkKey, VoxelChunk::extractBorders(meshData.voxels, &meshData.light));
+		}
+		VoxelChunk::buildMeshData(meshData.voxels, neighbors, meshData, m_meshingMode, &meshData.light);
+		break;
+	}
+	default:
+		break;
 	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<ChunkPipeline::Ready> ready;
+	m_pipeline.complete(meshData.chunkKey, stage, ms, ready);
+	// only once it's waiting for UPLOAD, so update() can start that stage. A render
+	// distance can have more chunks meshed at once than the queue holds; update() makes
+	// room every frame, but not once the world shuts down, so drop the mesh then
+	if (stage == ChunkStage::MESH) {
+		while (!m_meshesToUploadQueue.try_push(meshData) && m_isRunning) {
+			std::this_thread::yield();
+		}
+	}
+	submitStages(ready);
 }
 
 void World::unloadDistantChunks(glm::vec3 playerPos) {
-	int playerChunkX, playerChunkZ;
-	getChunkCoords(playerPos, playerChunkX, playerChunkZ);
+	glm::ivec3 playerChunk = getChunkCoords(playerPos);
 	std::vector<long long> chunksToRemove;
 	for (const auto& pair : chunks) {
 		long long key = pair.first;
-		int chunkX = static_cast<int>(key >> 32);
-		int chunkZ = static_cast<int>(key & 0xFFFFFFFF);
-		if (!shouldLoadChunk(chunkX, chunkZ, playerChunkX, playerChunkZ, renderDistance + 2)) {
+		if (!shouldLoadChunk(getChunkCoords(key), playerChunk, renderDistance + 2, verticalRenderDistance + 1)) {
 			chunksToRemove.push_back(key);
 		}
 	}
 	for (long long key : chunksToRemove) {
+		if (m_modifiedChunks.erase(key)) {
+			m_regions->save(getChunkCoords(key), chunks[key]->voxels);
+		}
 		chunks.erase(key);
+		m_chunksToRecull.erase(key);
+	}
+
+	// Features only reach the chunks next to their own; once none of those is near
+	// enough to load, whatever was queued for a target comes back with them
+	m_pendingWrites.removeTargetsIf([this, playerChunk](long long target) {
+		glm::ivec3 coords = getChunkCoords(target);
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dz = -1; dz <= 1; dz++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					if (shouldLoadChunk(coords + glm::ivec3(dx, dy, dz), playerChunk, renderDistance + 2, verticalRenderDistance + 1)) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	});
+
+	std::lock_guard<std::mutex> lock(m_bordersMutex);
+	for (long long key : chunksToRemove) {
+		m_chunkBorders.erase(key);
 	}
 }
 
-bool World::shouldLoadChunk(int chunkX, int chunkZ, int playerChunkX, int playerChunkZ, int maxDistance) {
+bool World::shouldLoadChunk(glm::ivec3 coords, glm::ivec3 playerChunk, int maxDistance, int maxHeight) {
 	if (maxDistance == -1) maxDistance = renderDistance;
-	int dx = chunkX - playerChunkX;
-	int dz = chunkZ - playerChunkZ;
-	return (dx * dx + dz * dz) <= (maxDistance * maxDistance);
+	if (maxHeight == -1) maxHeight = verticalRenderDistance;
+	int dx = coords.x - playerChunk.x;
+	int dz = coords.z - playerChunk.z;
+	return (dx * dx + dz * dz) <= (maxDistance * maxDistance) && std::abs(coords.y - playerChunk.y) <= maxHeight;
 }
 
-void World::render(Shader& shader) {
+void World::render(Shader& shader, const glm::mat4& viewProjection) {
+	VoxelChunk::bindBlockTextures(shader);
+
+	m_chunkBounds.clear();
+	m_boundedChunks.clear();
 	for (const auto& pair : chunks) {
 		VoxelChunk* chunk = pair.second.get();
-		if (chunk) {
-			chunk->render(shader);
+		if (chunk && chunk->hasGeometry()) {
+			m_chunkBounds.push(chunk->getBoundsMin(), chunk->getBoundsMax());
+			m_boundedChunks.push_back(chunk);
+		}
+	}
+
+	if (m_frustumCulling) {
+		Frustum frustum(viewProjection);
+		frustum.testBoxes(m_chunkBounds, m_chunkVisible);
+	}
+	else {
+		m_chunkVisible.assign(m_boundedChunks.size(), 1);
+	}
+
+	m_drawCalls = 0;
+	m_materialDrawCalls = 0;
+	m_visibleChunks = 0;
+	m_culledChunks = 0;
+	for (size_t i = 0; i < m_boundedChunks.size(); i++) {
+		if (!m_chunkVisible[i]) {
+			m_culledChunks++;
+			continue;
 		}
+		m_visibleChunks++;
+		m_drawCalls += m_boundedChunks[i]->render(shader);
+		m_materialDrawCalls += m_boundedChunks[i]->getMaterialBucketCount();
+	}
+}
+
+void World::setMeshingMode(MeshingMode mode) {
+	if (mode == m_meshingMode) return;
+	m_meshingMode = mode;
+
+	// on jobs, and uploaded within the budget; meshes still in flight in the old mode go stale
+	m_totalMeshingMs = 0.0;
+	m_meshedChunks = 0;
+	auto now = std::chrono::steady_clock::now();
+	for (auto& pair : chunks) {
+		queueEditRemesh(getChunkCoords(pair.first), pair.second.get(), now, true);
+	}
+}
+
+WorldMeshStats World::getMeshStats() const {
+	WorldMeshStats stats;
+	stats.chunks = chunks.size();
+	for (const auto& pair : chunks) {
+		stats.vertices += pair.second->getVertexCount();
+		stats.indices += pair.second->getIndexCount();
+		stats.seamFacesCulled += pair.second->getSeamFacesCulled();
+		stats.meshBytes += pair.second->getMeshBytes();
 	}
+	stats.avgMeshingMs = m_meshedChunks > 0 ? m_totalMeshingMs / m_meshedChunks : 0.0;
+	return stats;
 }
 
-VoxelChunk* World::getChunk(int chunkX, int chunkZ) {
-	long long key = getChunkKey(chunkX, chunkZ);
+VoxelChunk* World::getChunk(int chunkX, int chunkY, int chunkZ) {
+	long long key = getChunkKey(chunkX, chunkY, chunkZ);
 	auto it = chunks.find(key);
 	return (it != chunks.end()) ? it->second.get() : nullptr;
 }
 
 // CORRECTED: Removed the extra, conflicting getBlock implementation.
 
+void World::recordEdit(glm::ivec3 coords, glm::ivec3 local, VoxelType type) {
+	if (m_journal) {
+		m_journal->record(coords, local, type);
+	}
+	else if (m_regions) {
+		m_modifiedChunks.insert(getChunkKey(coords.x, coords.y, coords.z));
+	}
+}
+
+void World::openSave() {
+	// Both stores only make sense over the terrain they were made on, so each generator
+	// setup gets its own directory: density terrain, or heightmaps from one terrain graph
+	std::string directory = "saves/world_" + std::to_string(worldSeed);
+	if (m_terrainMode == TerrainMode::DENSITY) {
+		directory += "_density";
+	}
+	else {
+		char graph[9];
+		std::snprintf(graph, sizeof(graph), "%08x", hashText(m_terrainGraph.getText()));
+		directory += "_graph_" + std::string(graph);
+	}
+	if (m_saveMode == SaveMode::REGION_FILES) {
+		m_regions = std::make_unique<RegionStore>(directory);
+	}
+	else {
+		m_journal = std::make_unique<EditJournal>(directory + "/edits.journal");
+	}
+}
+
+void World::saveModifiedChunks() {
+	for (long long key : m_modifiedChunks) {
+		auto it = chunks.find(key);
+		if (it != chunks.end()) {
+			m_regions->save(getChunkCoords(key), it->second->voxels);
+		}
+	}
+	m_modifiedChunks.clear();
+}
+
 void World::cleanup() {
 	std::cout << "Cleaning up " << chunks.size() << " chunks" << std::endl;
+	saveModifiedChunks();
+	if (m_journal) {
+		m_journal->flush();
+	}
 	chunks.clear();
+	m_chunksToRecull.clear();
+	m_budgetedRemeshes.clear();
+	{
+		std::lock_guard<std::mutex> lock(m_bordersMutex);
+		m_chunkBorders.clear();
+	}
 	std::cout << "World cleanup complete" << std::endl;
 }
\ No newline at end of file
@@ -8,11 +8,26 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <chrono>
+#include <deque>
 
 #include <glm/glm.hpp>
 #include "../../generation/perlin.h"
-#include "../models/ThreadSafeQueue.hpp"
+#include "../../generation/BiomeMap.h"
+#include "../../generation/NoiseGraph.h"
+#include "../../generation/FeaturePlacer.h"
+#include "../models/LockFreeQueue.hpp"
+#include "../models/ChunkLoadQueue.hpp"
 #include "../models/voxelchunk.hpp"
+#include "../Frustum.h"
+#include "../../jobs/JobSystem.h"
+#include "UploadScheduler.h"
+#include "RegionStore.h"
+#include "EditJournal.h"
+#include "PendingWrites.h"
+#include "ChunkPipeline.h"
+#include "VoxelLight.h"
+#include "ChunkKey.h"
 
 // Forward declarations
 class Shader;
@@ -31,42 +46,198 @@ struct Block {
 struct ChunkMeshData {
 	long long chunkKey;
 	glm::vec3 chunkPosition;
-	std::unordered_map<int, std::unordered_map<int, std::unordered_map<int, VoxelType>>> voxels;
-
-	std::vector<Vertex> simpleVertices[4];
-	std::vector<unsigned int> simpleIndices[4];
-	std::vector<Vertex> grassTopVertices;
-	std::vector<unsigned int> grassTopIndices;
-	std::vector<Vertex> grassSideVertices;
-	std::vector<unsigned int> grassSideIndices;
-	std::vector<Vertex> grassBottomVertices;
-	std::vector<unsigned int> grassBottomIndices;
+	ChunkStorage voxels;
+	// Built from voxels by the generation job, handed to the VoxelChunk
+	ChunkHeightmap heightmap;
+	// Filled in at the LIGHT stage, also handed over
+	ChunkLight light;
+
+	std::vector<VoxelVertex> vertices;
+	std::vector<unsigned int> indices;
+
+	double meshingTimeMs = 0.0;
+	// Faces dropped because the adjacent chunk's border block is solid
+	size_t seamFacesCulled = 0;
+	uint8_t neighborMask = 0;
+	// Meshes the old per-material renderer drew: bits 0-2 DIRT..SAND, 3 LOG, bits 4-6 grass top/side/bottom,
+	// 7 LEAVES, 8 LAMP
+	uint16_t materialBuckets = 0;
+	// Solid voxel layers [solidMinY, solidMaxY), both 0 for an empty chunk
+	int solidMinY = 0;
+	int solidMaxY = 0;
+
+	size_t vertexCount() const {
+		return vertices.size();
+	}
+
+	size_t indexCount() const {
+		return indices.size();
+	}
+
+	// Bytes the mesh occupies once uploaded
+	size_t memoryUsage() const {
+		return vertexCount() * sizeof(VoxelVertex) + indexCount() * sizeof(unsigned int);
+	}
+};
+
+// One chunk on its way through the ChunkPipeline, only touched by the stage it is running
+struct ChunkJob {
+	glm::ivec3 coords;
+	ChunkMeshData meshData;
+	// Came from a region file with its features and edits, FEATURES and LIGHT leave it alone
+	bool fromSave = false;
+};
+
+// Chunk requests dropped because the player moved away before they were finished,
+// by the stage they were dropped at
+struct ChunkCancelStats {
+	size_t queued = 0;			// still waiting in the load queue
+	size_t beforeGeneration = 0;	// popped by a worker but not generated yet
+	size_t beforeMeshing = 0;		// generated, dropped at FEATURES, LIGHT or MESH
+	size_t beforeUpload = 0;		// meshed, waiting for the main thread
+};
+
+// Cost of block edits. The main thread relights around the block, snapshots the chunks
+// and queues remesh jobs; the finished meshes are swapped in by a later update().
+struct ChunkEditStats {
+	size_t edits = 0;
+	// Main thread time per edit
+	double lastMicroseconds = 0.0;
+	double averageMicroseconds = 0.0;
+	// Chunks queued for remeshing by the last edit
+	int lastRemeshes = 0;
+	// From the edit to its mesh being swapped in, for the last remesh applied
+	double lastLatencyMs = 0.0;
+	int lastLatencyFrames = 0;
+	// Meshing time of that remesh on its worker
+	double lastRemeshMicroseconds = 0.0;
+	// Remeshes dropped because a later edit of the same chunk overtook them
+	size_t staleRemeshes = 0;
+	// Relighting after the last edit, part of its main thread time: how long it took,
+	// how many voxels changed light and how many chunk meshes that showed on
+	double lastRelightMicroseconds = 0.0;
+	double averageRelightMicroseconds = 0.0;
+	int lastRelitVoxels = 0;
+	int lastRelitChunks = 0;
+};
+
+// Geometry totals over the loaded chunks, for comparing meshing modes
+struct WorldMeshStats {
+	size_t chunks = 0;
+	size_t vertices = 0;
+	size_t indices = 0;
+	double avgMeshingMs = 0.0;
+	size_t seamFacesCulled = 0;
+	size_t meshBytes = 0;
+};
+
+// How generateTerrain shapes the world
+enum class TerrainMode {
+	HEIGHTMAP,	// 2D noise surface height, solid below it
+	DENSITY		// 3D noise density field, which allows caves and overhangs
+};
+
+// How block edits survive their chunk unloading and the game restarting
+enum class SaveMode {
+	REGION_FILES,	// whole modified chunks, written when they unload (RegionStore)
+	EDIT_JOURNAL	// only the edited voxels, replayed over the generator's output (EditJournal)
 };
 
 class World {
 public:
-	World(int renderDist = 5, unsigned int seed = 12345);
+	World(int renderDist = 5, unsigned int seed = 12345, SaveMode saveMode = SaveMode::EDIT_JOURNAL);
 	~World();
 
-	const int CHUNK_SIZE = 16;
-	const int CHUNK_HEIGHT = 32;
-
-	void update(glm::vec3 playerPos);
-	void render(Shader& shader);
-	VoxelChunk* getChunk(int chunkX, int chunkZ);
+	// viewDirection orders the chunks still waiting to be generated, see ChunkLoadQueue
+	void update(glm::vec3 playerPos, glm::vec3 viewDirection);
+	// Draws the loaded chunks whose bounds intersect the view-projection frustum
+	void render(Shader& shader, const glm::mat4& viewProjection);
+	VoxelChunk* getChunk(int chunkX, int chunkY, int chunkZ);
 	void cleanup();
 
 	void setRenderDistance(int distance) { renderDistance = distance; }
 	int getRenderDistance() const { return renderDistance; }
+	// Chunk layers kept above and below the player's
+	void setVerticalRenderDistance(int distance) { verticalRenderDistance = distance; }
+	int getVerticalRenderDistance() const { return verticalRenderDistance; }
+	unsigned int getSeed() const { return worldSeed; }
 
+	// Height of the highest solid block in the column, edits included. Loaded chunks answer
+	// from their heightmaps; noise is only evaluated where the column isn't loaded.
 	float getTerrainHeight(float worldX, float worldZ);
-	VoxelType getBlockType(float worldX, float worldY, float worldZ, float terrainHeight);
+	int getColumnTop(int worldX, int worldZ);
+	// Surface height the generator builds the column to, from noise alone
+	float getGeneratedHeight(float worldX, float worldZ);
+	VoxelType getBlockType(float worldX, float worldY, float worldZ, float terrainHeight, Biome biome);
+	Biome getBiomeAt(int worldX, int worldZ);
+	// Climate and biome regions shared by every chunk job
+	BiomeMap& getBiomeMap() { return m_biomes; }
+	// Surface noise of heightmap terrain, loaded from assets/terrain.graph when the world is
+	// created. Only for chunks generated afterwards, so load another before the first update().
+	bool loadTerrainGraph(const std::string& path);
+	NoiseGraph& getTerrainGraph() { return m_terrainGraph; }
+	void generateTerrain(int chunkX, int chunkY, int chunkZ, ChunkStorage& voxels);
+	// The two TerrainModes; generateTerrain picks one
+	void generateHeightmapTerrain(int chunkX, int chunkY, int chunkZ, ChunkStorage& voxels);
+	void generateDensityTerrain(int chunkX, int chunkY, int chunkZ, ChunkStorage& voxels);
+	// Grows the features rooted in a freshly generated chunk and queues what they reach
+	// into other chunks
+	void decorateChunk(glm::ivec3 coords, ChunkStorage& voxels);
+	// Merges what the features of the chunks around it queued for this one so far; later
+	// writes are merged by update() once the chunk is loaded
+	void applyFeatureWrites(glm::ivec3 coords, ChunkStorage& voxels);
+	PendingWrites& getPendingWrites() { return m_pendingWrites; }
+	size_t getFeaturesPlaced() const { return m_featuresPlaced; }
+	// Late feature writes merged into chunks that were already loaded
+	size_t getLateFeatureMerges() const { return m_lateFeatureMerges; }
+	// Density at one voxel straight from the noise, solid where it's above 0.
+	// generateDensityTerrain only samples it on a coarse lattice.
+	double sampleDensity(int worldX, int worldY, int worldZ);
+	// Only for chunks generated afterwards, so set it before the first update()
+	void setTerrainMode(TerrainMode mode) { m_terrainMode = mode; }
+	TerrainMode getTerrainMode() const { return m_terrainMode; }
 
 	void setBlock(int worldX, int worldY, int worldZ, VoxelType type);
 	void placeBlock(int worldX, int worldY, int worldZ, VoxelType type);
 	VoxelType getBlockTypeAt(int worldX, int worldY, int worldZ);
 
-	void getChunkCoords(glm::vec3 worldPos, int& chunkX, int& chunkZ);
+	glm::ivec3 getChunkCoords(glm::vec3 worldPos) const;
+
+	// See ChunkKey.h
+	static long long getChunkKey(int chunkX, int chunkY, int chunkZ);
+	static glm::ivec3 getChunkCoords(long long key);
+
+	// Switching modes queues a remesh of every loaded chunk, so the stats compare like for
+	// like once those are swapped in over the next frames
+	void setMeshingMode(MeshingMode mode);
+	MeshingMode getMeshingMode() const { return m_meshingMode; }
+	WorldMeshStats getMeshStats() const;
+	ChunkCancelStats getCancelStats() const;
+	ChunkEditStats getEditStats() const { return m_editStats; }
+	// Loaded chunks remeshed because light came through the side of a chunk loaded next to them
+	size_t getSeamRelights() const { return m_seamRelights; }
+	// Chunks still being built, with their per-stage timing and queue depth
+	ChunkPipeline& getPipeline() { return m_pipeline; }
+
+	// Per-frame budget for uploading finished chunk meshes
+	UploadScheduler& getUploadScheduler() { return m_uploadScheduler; }
+
+	// Chunk draw calls of the last render(), and what one mesh per material would have needed
+	int getDrawCalls() const { return m_drawCalls; }
+	int getMaterialDrawCalls() const { return m_materialDrawCalls; }
+
+	// The first update() opens the save for this mode, so set it before that
+	void setSaveMode(SaveMode mode) { m_saveMode = mode; }
+	SaveMode getSaveMode() const { return m_saveMode; }
+	// Only the store of the save mode exists, the other is null; both are until the first update()
+	RegionStore* getRegionStore() { return m_regions.get(); }
+	EditJournal* getEditJournal() { return m_journal.get(); }
+
+	void setFrustumCulling(bool enabled) { m_frustumCulling = enabled; }
+	bool getFrustumCulling() const { return m_frustumCulling; }
+	// Chunks with geometry drawn and skipped by the last render()
+	int getVisibleChunks() const { return m_visibleChunks; }
+	int getCulledChunks() const { return m_culledChunks; }
 
 	size_t getLoadedChunkCount() const {
 		return chunks.size();
@@ -74,26 +245,142 @@ public:
 private:
 	std::unordered_map<long long, std::unique_ptr<VoxelChunk>> chunks;
 	int renderDistance;
+	int verticalRenderDistance;
 	unsigned int worldSeed;
 	PerlinNoise worldNoise;
+	BiomeMap m_biomes;
+	NoiseGraph m_terrainGraph;
+	FeaturePlacer m_features;
+	PendingWrites m_pendingWrites;
+	std::atomic<size_t> m_featuresPlaced;
+	size_t m_lateFeatureMerges;
+	// Late writes whose chunk is still being built, main thread only
+	std::vector<PendingWrites::Batch> m_lateWrites;
 	glm::vec3 lastPlayerPos;
 
-	std::vector<std::thread> m_chunkWorkers;
 	std::atomic<bool> m_isRunning;
+	// Chunk jobs submitted to the JobSystem and not finished yet; the destructor waits for 0
+	std::atomic<int> m_chunkJobsInFlight;
+
+	ChunkLoadQueue m_chunksToLoadQueue;
+	SaveMode m_saveMode;
+	std::unique_ptr<RegionStore> m_regions;
+	std::unique_ptr<EditJournal> m_journal;
+	// Keys of loaded chunks changed by setBlock or placeBlock, main thread only
+	std::unordered_set<long long> m_modifiedChunks;
+	// Meshing jobs push here from every worker, World::update drains it without taking a lock
+	LockFreeQueue<ChunkMeshData> m_meshesToUploadQueue;
+
+	// Player chunk and view direction the load queue was last sorted for
+	glm::ivec3 m_focusChunk;
+	glm::vec3 m_focusDirection;
+
+	// Every chunk requested and not loaded yet
+	ChunkPipeline m_pipeline;
+
+	// Chunk key around which chunks are kept and the radii past which unloadDistantChunks
+	// drops them; workers read these to skip requests that went stale
+	std::atomic<long long> m_loadCenter;
+	std::atomic<int> m_loadRadius;
+	std::atomic<int> m_loadHeight;
+
+	std::atomic<size_t> m_cancelledQueued;
+	std::atomic<size_t> m_cancelledBeforeGeneration;
+	std::atomic<size_t> m_cancelledBeforeMeshing;
+	std::atomic<size_t> m_cancelledBeforeUpload;
+
+	std::atomic<MeshingMode> m_meshingMode;
+	std::atomic<TerrainMode> m_terrainMode;
+	double m_totalMeshingMs;
+	size_t m_meshedChunks;
+	ChunkEditStats m_editStats;
+	double m_totalEditMicroseconds;
+	double m_totalRelightMicroseconds;
+	size_t m_seamRelights;
+	unsigned int m_frame;
+
+	// Result of an edit remesh job, uploaded by update() unless the chunk changed again
+	struct EditRemesh {
+		long long chunkKey = 0;
+		uint32_t version = 0;
+		std::shared_ptr<const ChunkMeshData> geometry;
+		double meshingMicroseconds = 0.0;
+		unsigned int editFrame = 0;
+		std::chrono::steady_clock::time_point editTime;
+		// Not for an edit: waits for room in the upload budget and stays out of the edit stats
+		bool budgeted = false;
+	};
+	LockFreeQueue<EditRemesh> m_remeshedQueue;
+	// Budgeted remeshes taken off the queue that didn't fit a frame yet, main thread only
+	std::deque<EditRemesh> m_budgetedRemeshes;
+	UploadScheduler m_uploadScheduler;
+	std::chrono::steady_clock::time_point m_lastUpdateTime;
+	// A mesh popped from the upload queue that didn't fit last frame's budget
+	ChunkMeshData m_pendingUpload;
+	bool m_hasPendingUpload;
+
+	int m_drawCalls;
+	int m_materialDrawCalls;
+
+	bool m_frustumCulling;
+	int m_visibleChunks;
+	int m_culledChunks;
+	// Reused every frame by render()
+	AabbList m_chunkBounds;
+	std::vector<VoxelChunk*> m_boundedChunks;
+	std::vector<uint8_t> m_chunkVisible;
+
+	// Adds the chunk to the pipeline and the load queue, and submits a TERRAIN job
+	void queueChunk(glm::ivec3 coords);
+	// Pops whichever chunk is most urgent by then, not necessarily the one it was submitted for
+	void runTerrainJob();
+	void runStage(ChunkStage stage, ChunkJob& job);
+	void submitStages(const std::vector<ChunkPipeline::Ready>& ready);
 
-	ThreadSafeQueue<glm::ivec2> m_chunksToLoadQueue;
-	ThreadSafeQueue<ChunkMeshData> m_meshesToUploadQueue;
+	// Border slices of every generated chunk; workers read them to cull faces across chunk seams
+	std::mutex m_bordersMutex;
+	std::unordered_map<long long, ChunkBorders> m_chunkBorders;
+	// Loaded chunks meshed before one of their neighbours existed, re-culled a few per frame
+	std::unordered_set<long long> m_chunksToRecull;
 
-	std::mutex m_worldMutex;
-	std::unordered_set<long long> m_generatingChunks;
+	// Light of the loaded chunks, main thread only
+	VoxelLight m_light;
+	// True if the sky shines straight into the top of this chunk layer when nothing is
+	// loaded above it: nothing generated reaches that high
+	bool isOpenSky(int chunkY) const;
+	// Republishes the borders of the chunks whose light changed and queues their remeshes
+	void remeshRelit(const VoxelLight::ChangedChunks& relit, std::chrono::steady_clock::time_point editTime);
 
-	void chunkWorkerLoop();
+	void publishBorders(long long key, const ChunkBorders& borders);
+	ChunkNeighbors gatherNeighbors(glm::ivec3 coords);
+	void queueSeamReculls(glm::ivec3 coords, VoxelChunk* chunk);
+	// Relights around the changed block and queues remeshes of its chunk, the chunks
+	// across a border it sits on and wherever the light changed
+	void onBlockChanged(glm::ivec3 coords, glm::ivec3 local);
+	// Snapshots the chunk and submits a high priority job remeshing it. Edit remeshes are
+	// swapped in as soon as they're done, budgeted ones as the upload budget allows.
+	void queueEditRemesh(glm::ivec3 coords, VoxelChunk* chunk, std::chrono::steady_clock::time_point editTime, bool budgeted = false);
+	// Uploads the finished remeshes, call after the upload budget's beginFrame
+	void applyEditRemeshes();
+	// Writes features made into chunks that had already been generated
+	void mergeLateWrites();
 
-	long long getChunkKey(int chunkX, int chunkZ);
+	// True if the chunk lies outside the cylinder kept around the current load center
+	bool isStale(glm::ivec3 coords) const;
+	// Forgets a request that was dropped so a later generateChunksAroundPosition can queue it again
+	void cancelChunk(long long key);
+	void cancelStaleRequests();
 
 	void generateChunksAroundPosition(glm::vec3 pos);
 	void unloadDistantChunks(glm::vec3 playerPos);
-	bool shouldLoadChunk(int chunkX, int chunkZ, int playerChunkX, int playerChunkZ, int maxDistance = -1);
+	// Hands a copy of every modified loaded chunk to the region store
+	void saveModifiedChunks();
+	// Remembers an edit for whichever SaveMode is in use
+	void recordEdit(glm::ivec3 coords, glm::ivec3 local, VoxelType type);
+	// Creates the store the save mode uses, on the first update()
+	void openSave();
+	// Chunks are kept in a cylinder: maxDistance around the player horizontally, maxHeight layers up and down
+	bool shouldLoadChunk(glm::ivec3 coords, glm::ivec3 playerChunk, int maxDistance = -1, int maxHeight = -1);
 };
 
 #endif
\ No newline at end of file
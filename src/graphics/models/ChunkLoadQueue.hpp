@@ -0,0 +1,139 @@
+#ifndef CHUNK_LOAD_QUEUE_HPP
+#define CHUNK_LOAD_QUEUE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "chunkstorage.hpp"
+
+// Chunk coordinates waiting to be generated, handed to the workers nearest and
+// most in view first. Same interface as ThreadSafeQueue<glm::ivec3>, but pop
+// returns the pending chunk with the lowest priority() for the current focus,
+// and setFocus() re-sorts everything still pending when the player moves or turns.
+class ChunkLoadQueue {
+public:
+	// How much more a chunk straight behind the player costs than one straight
+	// ahead at the same distance, as a fraction of its distance
+	static constexpr float ANGLE_WEIGHT = 2.0f;
+
+	ChunkLoadQueue() : m_focusPos(0.0f), m_focusDir(0.0f, -1.0f) {}
+	ChunkLoadQueue(const ChunkLoadQueue&) = delete;
+	ChunkLoadQueue& operator=(const ChunkLoadQueue&) = delete;
+
+	// Distance in chunks from the focus to the chunk centre, scaled up the further the
+	// chunk is from the view direction. The angle only looks at x/z, so looking straight
+	// up or down gives every direction the same weight and chunks above and below the
+	// player count by distance alone.
+	static float priority(glm::ivec3 coords, glm::vec3 focusPos, glm::vec2 focusDir) {
+		glm::vec3 center = (glm::vec3(coords) + 0.5f) * static_cast<float>(CHUNK_SIZE);
+		glm::vec3 toChunk = center - focusPos;
+		float distance = glm::length(toChunk) / CHUNK_SIZE;
+
+		// the chunk the player stands in and its neighbours go first whatever the angle
+		if (distance < 1.5f) {
+			return distance;
+		}
+		glm::vec2 across(toChunk.x, toChunk.z);
+		float acrossLength = glm::length(across);
+		float cosAngle = acrossLength > 1e-4f ? glm::dot(across / acrossLength, focusDir) : 1.0f;
+		return distance * (1.0f + ANGLE_WEIGHT * 0.5f * (1.0f - cosAngle));
+	}
+
+	void push(glm::ivec3 coords) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_heap.push_back({ priority(coords, m_focusPos, m_focusDir), coords });
+		std::push_heap(m_heap.begin(), m_heap.end());
+		m_cond.notify_one();
+	}
+
+	// Wait until a chunk is pending, then pop the most urgent one
+	// Returns false if the queue was notified to shut down
+	bool wait_and_pop(glm::ivec3& coords) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [this] { return !m_heap.empty() || m_stop; });
+		if (m_stop && m_heap.empty()) {
+			return false;
+		}
+		popFront(coords);
+		return true;
+	}
+
+	bool try_pop(glm::ivec3& coords) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_heap.empty()) {
+			return false;
+		}
+		popFront(coords);
+		return true;
+	}
+
+	// position and viewDirection in world space
+	void setFocus(glm::vec3 position, glm::vec3 viewDirection) {
+		glm::vec2 dir(viewDirection.x, viewDirection.z);
+		float length = glm::length(dir);
+		dir = length > 1e-4f ? dir / length : glm::vec2(0.0f);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_focusPos = position;
+		m_focusDir = dir;
+		for (Entry& entry : m_heap) {
+			entry.priority = priority(entry.coords, m_focusPos, m_focusDir);
+		}
+		std::make_heap(m_heap.begin(), m_heap.end());
+	}
+
+	// Drops every pending chunk matching pred and appends it to removed
+	template <typename Predicate>
+	void removeIf(Predicate pred, std::vector<glm::ivec3>& removed) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto kept = std::partition(m_heap.begin(), m_heap.end(), [&pred](const Entry& entry) { return !pred(entry.coords); });
+		for (auto it = kept; it != m_heap.end(); ++it) {
+			removed.push_back(it->coords);
+		}
+		m_heap.erase(kept, m_heap.end());
+		// partition reordered the survivors too
+		std::make_heap(m_heap.begin(), m_heap.end());
+	}
+
+	size_t size() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_heap.size();
+	}
+
+	void stop() {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_cond.notify_all();
+	}
+
+private:
+	struct Entry {
+		float priority;
+		glm::ivec3 coords;
+
+		// std heaps keep the largest element in front, so invert for the lowest priority
+		bool operator<(const Entry& other) const {
+			return priority > other.priority;
+		}
+	};
+
+	std::vector<Entry> m_heap;
+	glm::vec3 m_focusPos;
+	glm::vec2 m_focusDir;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_stop = false;
+
+	void popFront(glm::ivec3& coords) {
+		std::pop_heap(m_heap.begin(), m_heap.end());
+		coords = m_heap.back().coords;
+		m_heap.pop_back();
+	}
+};
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef LOCK_FREE_QUEUE_HPP
+#define LOCK_FREE_QUEUE_HPP
+
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded multi-producer/multi-consumer queue with the same interface as
+// ThreadSafeQueue, but push and try_pop never take a lock.
+//
+// It is the array queue by Dmitry Vyukov: every cell carries a sequence number
+// telling producers whether it is free and consumers whether it is filled for the
+// lap they are on, so each side only has to claim a position with one CAS.
+// Full queues make push wait (try_push fails instead). Only wait_and_pop sleeps,
+// and push touches the mutex only while someone is actually sleeping.
+template<typename T>
+class LockFreeQueue {
+public:
+	// capacity is rounded up to a power of two
+	explicit LockFreeQueue(size_t capacity = 1024)
+		: m_cells(roundUpToPowerOfTwo(capacity)),
+		m_mask(m_cells.size() - 1),
+		m_enqueuePos(0),
+		m_dequeuePos(0),
+		m_waiters(0),
+		m_stop(false) {
+		for (size_t i = 0; i < m_cells.size(); i++) {
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+	// Returns false if the queue is full
+	bool try_push(T& value) {
+		size_t pos;
+		if (claim(m_enqueuePos, 0, 1, pos) == 0) {
+			return false;
+		}
+		fill(pos, value);
+		wakeWaiter();
+		return true;
+	}
+
+	// Add an item to the back of the queue, waiting for room if it is full
+	void push(T value) {
+		while (!try_push(value)) {
+			std::this_thread::yield();
+		}
+	}
+
+	// Pushes every item of values in order, claiming as many cells per CAS as are free.
+	// values is left with moved-from items.
+	void push_n(std::vector<T>& values) {
+		size_t pushed = 0;
+		while (pushed < values.size()) {
+			size_t pos;
+			size_t count = claim(m_enqueuePos, 0, values.size() - pushed, pos);
+			if (count == 0) {
+				std::this_thread::yield();
+				continue;
+			}
+			for (size_t i = 0; i < count; i++) {
+				fill(pos + i, values[pushed + i]);
+			}
+			pushed += count;
+			wakeWaiter();
+		}
+	}
+
+	// Try to pop an item without blocking
+	// Returns true if an item was popped, false otherwise
+	bool try_pop(T& value) {
+		size_t pos;
+		if (claim(m_dequeuePos, 1, 1, pos) == 0) {
+			return false;
+		}
+		empty(pos, value);
+		return true;
+	}
+
+	// Pops up to maxCount items onto the back of out with one CAS, returns how many
+	size_t try_pop_n(std::vector<T>& out, size_t maxCount) {
+		size_t pos;
+		size_t count = claim(m_dequeuePos, 1, maxCount, pos);
+		for (size_t i = 0; i < count; i++) {
+			out.emplace_back();
+			empty(pos + i, out.back());
+		}
+		return count;
+	}
+
+	// Wait until an item is available, then pop it from the front
+	// Returns false if the queue was notified to shut down
+	bool wait_and_pop(T& value) {
+		// items usually follow quickly while workers are busy, spin a little before sleeping
+		for (int spin = 0; spin < 64; spin++) {
+			if (try_pop(value)) {
+				return true;
+			}
+			if (m_stop.load()) {
+				return false;
+			}
+		}
+
+		std::unique_lock<std::mutex> lock(m_waitMutex);
+		m_waiters++;
+		// pairs with the fence in wakeWaiter: either push sees the waiter or we see the item
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while (true) {
+			if (try_pop(value)) {
+				m_waiters--;
+				return true;
+			}
+			if (m_stop.load()) {
+				m_waiters--;
+				return false;
+			}
+			m_cond.wait(lock);
+		}
+	}
+
+	// Signal the queue to stop. This will wake up any waiting threads.
+	void stop() {
+		std::lock_guard<std::mutex> lock(m_waitMutex);
+		m_stop = true;
+		m_cond.notify_all();
+	}
+
+	size_t capacity() const {
+		return m_cells.size();
+	}
+
+	// Only a snapshot while other threads push or pop
+	size_t size() const {
+		size_t enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+		size_t dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+		return enqueued > dequeued ? enqueued - dequeued : 0;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	static size_t roundUpToPowerOfTwo(size_t n) {
+		size_t size = 2;
+		while (size < n) {
+			size <<= 1;
+		}
+		return size;
+	}
+
+	// Claims up to maxCount consecutive positions from index whose cells are ready, a
+	// cell at position pos being ready when its sequence is pos + lap (0 to fill, 1 to
+	// empty). Returns how many were claimed, starting at first.
+	size_t claim(std::atomic<size_t>& index, size_t lap, size_t maxCount, size_t& first) {
+		size_t pos = index.load(std::memory_order_relaxed);
+		while (true) {
+			size_t ready = 0;
+			bool behind = false;
+			while (ready < maxCount) {
+				size_t sequence = m_cells[(pos + ready) & m_mask].sequence.load(std::memory_order_acquire);
+				intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + ready + lap);
+				if (diff != 0) {
+					// another thread already claimed this position
+					behind = diff > 0;
+					break;
+				}
+				ready++;
+			}
+
+			if (ready == 0 && !behind) {
+				return 0;
+			}
+			if (ready > 0 && index.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed)) {
+				first = pos;
+				return ready;
+			}
+			if (behind) {
+				pos = index.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void fill(size_t pos, T& value) {
+		Cell& cell = m_cells[pos & m_mask];
+		cell.value = std::move(value);
+		cell.sequence.store(pos + 1, std::memory_order_release);
+	}
+
+	void empty(size_t pos, T& value) {
+		Cell& cell = m_cells[pos & m_mask];
+		value = std::move(cell.value);
+		// free the cell for the producer one lap ahead
+		cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+	}
+
+	void wakeWaiter() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_waiters.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lock(m_waitMutex);
+			m_cond.notify_one();
+		}
+	}
+
+	std::vector<Cell> m_cells;
+	const size_t m_mask;
+
+	// producers and consumers each hammer their own index, keep them on separate cache lines
+	alignas(64) std::atomic<size_t> m_enqueuePos;
+	alignas(64) std::atomic<size_t> m_dequeuePos;
+	alignas(64) std::atomic<int> m_waiters;
+	std::atomic<bool> m_stop;
+	std::mutex m_waitMutex;
+	std::condition_variable m_cond;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef CHUNKLIGHT_HPP
+#define CHUNKLIGHT_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "chunkstorage.hpp"
+
+// Light levels run from 0 (dark) to MAX_LIGHT
+const int MAX_LIGHT = 15;
+
+// The two kinds of light every voxel carries
+enum class LightChannel {
+	SKY,	// from the open sky above
+	BLOCK	// from emitting blocks
+};
+
+// Block light level a voxel of this type gives off
+inline int lightEmission(VoxelType type) {
+	return type == VoxelType::LAMP ? 14 : 0;
+}
+
+// Light only passes through air
+inline bool isOpaque(VoxelType type) {
+	return type != VoxelType::AIR;
+}
+
+// Light of every voxel of one chunk, sky level in the high nibble of a byte and block
+// level in the low one, in ChunkStorage::index() order. Solid voxels hold 0, emitters
+// their emission. Like ChunkStorage, a chunk where every voxel has the same light (all
+// open sky, or all dark underground) keeps one value instead of a byte per voxel.
+class ChunkLight {
+public:
+	ChunkLight() : fill(0) {}
+
+	static uint8_t pack(int sky, int block) {
+		return static_cast<uint8_t>((sky << 4) | block);
+	}
+
+	uint8_t get(int index) const {
+		return levels.empty() ? fill : levels[index];
+	}
+
+	int get(int index, LightChannel channel) const {
+		uint8_t value = get(index);
+		return channel == LightChannel::SKY ? value >> 4 : value & 0xF;
+	}
+
+	void set(int index, uint8_t value) {
+		if (levels.empty()) {
+			if (value == fill) return;
+			levels.assign(ChunkStorage::VOLUME, fill);
+		}
+		levels[index] = value;
+	}
+
+	void set(int index, LightChannel channel, int level) {
+		uint8_t value = get(index);
+		if (channel == LightChannel::SKY) {
+			set(index, static_cast<uint8_t>((value & 0x0F) | (level << 4)));
+		}
+		else {
+			set(index, static_cast<uint8_t>((value & 0xF0) | level));
+		}
+	}
+
+	// Every voxel to the same value, dropping the per-voxel bytes
+	void reset(uint8_t value) {
+		std::vector<uint8_t>().swap(levels);
+		fill = value;
+	}
+
+	// Goes back to a single value if every voxel ended up with the same light
+	void compact() {
+		if (levels.empty()) return;
+		for (uint8_t value : levels) {
+			if (value != levels[0]) return;
+		}
+		reset(levels[0]);
+	}
+
+	bool isUniform() const {
+		return levels.empty();
+	}
+
+	bool operator==(const ChunkLight& other) const {
+		for (int i = 0; i < ChunkStorage::VOLUME; i++) {
+			if (get(i) != other.get(i)) return false;
+		}
+		return true;
+	}
+
+	size_t memoryUsage() const {
+		return sizeof(ChunkLight) + levels.capacity();
+	}
+
+private:
+	std::vector<uint8_t> levels;
+	uint8_t fill;
+};
+
+#endif
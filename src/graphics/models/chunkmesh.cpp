@@ -0,0 +1,71 @@
+#include "chunkmesh.hpp"
+
+ChunkMesh::ChunkMesh() : VAO(0), VBO(0), EBO(0), noVertices(0), noIndices(0) {}
+
+ChunkMesh::ChunkMesh(const std::vector<VoxelVertex>& vertices, const std::vector<unsigned int>& indices)
+	: VAO(0), VBO(0), EBO(0), noVertices(vertices.size()), noIndices(indices.size()) {
+	setup(vertices, indices);
+}
+
+void ChunkMesh::render() {
+	glBindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(noIndices), GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+}
+
+void ChunkMesh::cleanup() {
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	VAO = VBO = EBO = 0;
+}
+
+void ChunkMesh::update(const std::vector<VoxelVertex>& vertices, const std::vector<unsigned int>& indices) {
+	if (VAO == 0) {
+		noVertices = vertices.size();
+		noIndices = indices.size();
+		setup(vertices, indices);
+		return;
+	}
+
+	noVertices = vertices.size();
+	noIndices = indices.size();
+
+	// New storage for the same buffer names, so frames still drawing the old data don't stall
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VoxelVertex), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the element buffer binding is vertex array state
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+}
+
+size_t ChunkMesh::memoryUsage() const {
+	return noVertices * sizeof(VoxelVertex) + noIndices * sizeof(unsigned int);
+}
+
+void ChunkMesh::setup(const std::vector<VoxelVertex>& vertices, const std::vector<unsigned int>& indices) {
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+
+	glBindVertexArray(VAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VoxelVertex), vertices.data(), GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+	// integer attributes, unpacked in the vertex shader
+	glEnableVertexAttribArray(0);
+	glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(VoxelVertex), (void*)offsetof(VoxelVertex, data0));
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(VoxelVertex), (void*)offsetof(VoxelVertex, data1));
+
+	glBindVertexArray(0);
+}
@@ -0,0 +1,81 @@
+#ifndef CHUNKMESH_HPP
+#define CHUNKMESH_HPP
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+#include "voxel.hpp"
+
+// Packed vertex of an axis aligned voxel face, decoded in assets/voxel.vs.
+//
+// data0:  bits  0-4   x corner within the chunk (0..CHUNK_SIZE)
+//         bits  5-11  y corner (0..CHUNK_HEIGHT)
+//         bits 12-16  z corner (0..CHUNK_SIZE)
+//         bits 17-19  Face, the normal is looked up from it
+//         bits 20-24  u texture coordinate in blocks (0..16)
+//         bits 25-31  v texture coordinate in blocks (0..16)
+// data1:  bits  0-7   texture layer
+//         bits  8-11  sky light of the face (0..15)
+//         bits 12-15  block light of the face
+//         bits 16-31  unused
+//
+// Quads never span more than one chunk, so u is at most CHUNK_SIZE and v at most
+// CHUNK_HEIGHT (v runs along y on side faces).
+struct VoxelVertex {
+	uint32_t data0;
+	uint32_t data1;
+
+	// Light as packed by ChunkLight: sky level in the high nibble, block level in the low one
+	static const uint8_t FULL_LIGHT = 0xF0;
+
+	static VoxelVertex pack(int x, int y, int z, Face face, int u, int v, int layer, uint8_t light = FULL_LIGHT) {
+		VoxelVertex vertex;
+		vertex.data0 = static_cast<uint32_t>(x) |
+			(static_cast<uint32_t>(y) << 5) |
+			(static_cast<uint32_t>(z) << 12) |
+			(static_cast<uint32_t>(face) << 17) |
+			(static_cast<uint32_t>(u) << 20) |
+			(static_cast<uint32_t>(v) << 25);
+		vertex.data1 = (static_cast<uint32_t>(layer) & 0xFF) |
+			(static_cast<uint32_t>(light >> 4) << 8) |
+			(static_cast<uint32_t>(light & 0xF) << 12);
+		return vertex;
+	}
+
+	int x() const { return data0 & 0x1F; }
+	int y() const { return (data0 >> 5) & 0x7F; }
+	int z() const { return (data0 >> 12) & 0x1F; }
+	Face face() const { return static_cast<Face>((data0 >> 17) & 0x7); }
+	int u() const { return (data0 >> 20) & 0x1F; }
+	int v() const { return (data0 >> 25) & 0x7F; }
+	int layer() const { return data1 & 0xFF; }
+	int skyLight() const { return (data1 >> 8) & 0xF; }
+	int blockLight() const { return (data1 >> 12) & 0xF; }
+};
+
+// GPU buffers of a chunk's whole mesh, drawn with one call. Textures come from the
+// block texture array bound once per frame, and unlike Mesh no CPU copy of the
+// vertices is kept once they are uploaded.
+class ChunkMesh {
+public:
+	ChunkMesh();
+	ChunkMesh(const std::vector<VoxelVertex>& vertices, const std::vector<unsigned int>& indices);
+
+	void render();
+	void cleanup();
+	// Replaces the contents of the existing buffers; the vertex array keeps its layout
+	void update(const std::vector<VoxelVertex>& vertices, const std::vector<unsigned int>& indices);
+
+	// Bytes of vertex and index data held in GPU buffers
+	size_t memoryUsage() const;
+
+private:
+	unsigned int VAO, VBO, EBO;
+	size_t noVertices;
+	size_t noIndices;
+
+	void setup(const std::vector<VoxelVertex>& vertices, const std::vector<unsigned int>& indices);
+};
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef CHUNKSTORAGE_HPP
+#define CHUNKSTORAGE_HPP
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+enum class VoxelType {
+	DIRT = 0,
+	COBBLESTONE = 1,
+	SAND = 2,
+	GRASS = 3,
+	AIR = 4,
+	// after AIR so the values already in save files keep their meaning
+	LOG = 5,
+	LEAVES = 6,
+	// gives off block light, see lightEmission()
+	LAMP = 7
+};
+
+const int VOXEL_TYPE_COUNT = 8;
+
+// Chunks are cubes, stacked vertically as far as the world goes
+const int CHUNK_SIZE = 16;
+const int CHUNK_HEIGHT = CHUNK_SIZE;
+
+// Flat voxel storage for one chunk.
+// Every voxel is a small index into a per-chunk palette of VoxelTypes, and the
+// indices are bit-packed into 64 bit words. A chunk that only holds one type
+// (e.g. all air) has no index data at all; the index width grows 1 -> 2 -> 4 -> 8
+// bits as more distinct types are written.
+class ChunkStorage {
+public:
+	static const int VOLUME = CHUNK_SIZE * CHUNK_HEIGHT * CHUNK_SIZE;
+
+	ChunkStorage() : palette(1, VoxelType::AIR), bitsPerEntry(0) {}
+
+	static bool inBounds(int x, int y, int z) {
+		return x >= 0 && x < CHUNK_SIZE &&
+			y >= 0 && y < CHUNK_HEIGHT &&
+			z >= 0 && z < CHUNK_SIZE;
+	}
+
+	// x runs fastest so a row along x sits in consecutive bits
+	static int index(int x, int y, int z) {
+		return (y * CHUNK_SIZE + z) * CHUNK_SIZE + x;
+	}
+
+	// Out of range reads are air, like a missing key in the old nested maps
+	VoxelType get(int x, int y, int z) const {
+		if (!inBounds(x, y, z)) {
+			return VoxelType::AIR;
+		}
+		return palette[readIndex(index(x, y, z))];
+	}
+
+	bool isSolid(int x, int y, int z) const {
+		return get(x, y, z) != VoxelType::AIR;
+	}
+
+	void set(int x, int y, int z, VoxelType type) {
+		if (!inBounds(x, y, z)) {
+			return;
+		}
+		unsigned int paletteIdx = paletteIndexOf(type);
+		if (bitsPerEntry > 0) {
+			writeIndex(index(x, y, z), paletteIdx);
+		}
+	}
+
+	// Expands the whole chunk to one VoxelType per voxel, in index() order
+	void unpack(std::vector<VoxelType>& out) const {
+		out.resize(VOLUME);
+		if (bitsPerEntry == 0) {
+			std::fill(out.begin(), out.end(), palette[0]);
+			return;
+		}
+		int perWord = 64 / bitsPerEntry;
+		uint64_t mask = (1ull << bitsPerEntry) - 1;
+		for (size_t w = 0; w < data.size(); w++) {
+			uint64_t word = data[w];
+			int base = static_cast<int>(w) * perWord;
+			for (int k = 0; k < perWord && base + k < VOLUME; k++) {
+				out[base + k] = palette[word & mask];
+				word >>= bitsPerEntry;
+			}
+		}
+	}
+
+	// Lowest layer holding a solid voxel and one past the highest, false for an all air chunk
+	bool solidHeightRange(int& minY, int& maxY) const {
+		if (isEmpty()) {
+			return false;
+		}
+		auto layerHasSolid = [this](int y) {
+			for (int z = 0; z < CHUNK_SIZE; z++) {
+				for (int x = 0; x < CHUNK_SIZE; x++) {
+					if (palette[readIndex(index(x, y, z))] != VoxelType::AIR) return true;
+				}
+			}
+			return false;
+		};
+		minY = 0;
+		while (minY < CHUNK_HEIGHT && !layerHasSolid(minY)) minY++;
+		if (minY == CHUNK_HEIGHT) {
+			return false;
+		}
+		maxY = CHUNK_HEIGHT;
+		while (maxY > minY && !layerHasSolid(maxY - 1)) maxY--;
+		return true;
+	}
+
+	// True if no voxel is air
+	bool isFull() const {
+		if (bitsPerEntry == 0) {
+			return palette[0] != VoxelType::AIR;
+		}
+		for (int i = 0; i < VOLUME; i++) {
+			if (palette[readIndex(i)] == VoxelType::AIR) return false;
+		}
+		return true;
+	}
+
+	bool isEmpty() const {
+		return palette.size() == 1 && palette[0] == VoxelType::AIR;
+	}
+
+	int getBitsPerEntry() const {
+		return bitsPerEntry;
+	}
+
+	size_t getPaletteSize() const {
+		return palette.size();
+	}
+
+	// Heap + object bytes used by this chunk's voxel data
+	size_t memoryUsage() const {
+		return sizeof(ChunkStorage) +
+			palette.capacity() * sizeof(VoxelType) +
+			data.capacity() * sizeof(uint64_t);
+	}
+
+private:
+	std::vector<VoxelType> palette;
+	std::vector<uint64_t> data;
+	int bitsPerEntry;
+
+	unsigned int readIndex(int i) const {
+		if (bitsPerEntry == 0) {
+			return 0;
+		}
+		int perWord = 64 / bitsPerEntry;
+		uint64_t word = data[i / perWord];
+		int shift = (i % perWord) * bitsPerEntry;
+		return static_cast<unsigned int>((word >> shift) & ((1ull << bitsPerEntry) - 1));
+	}
+
+	void writeIndex(int i, unsigned int value) {
+		int perWord = 64 / bitsPerEntry;
+		uint64_t& word = data[i / perWord];
+		int shift = (i % perWord) * bitsPerEntry;
+		uint64_t mask = ((1ull << bitsPerEntry) - 1) << shift;
+		word = (word & ~mask) | (static_cast<uint64_t>(value) << shift);
+	}
+
+	// Returns the palette slot for a type, adding it (and widening the indices) if needed
+	unsigned int paletteIndexOf(VoxelType type) {
+		for (size_t i = 0; i < palette.size(); i++) {
+			if (palette[i] == type) {
+				return static_cast<unsigned int>(i);
+			}
+		}
+
+		palette.push_back(type);
+		int needed = 1;
+		while ((1u << needed) < palette.size()) {
+			needed *= 2;
+		}
+		if (needed > bitsPerEntry) {
+			repack(needed);
+		}
+		return static_cast<unsigned int>(palette.size() - 1);
+	}
+
+	void repack(int newBits) {
+		std::vector<uint64_t> oldData;
+		oldData.swap(data);
+		int oldBits = bitsPerEntry;
+
+		bitsPerEntry = newBits;
+		int perWord = 64 / newBits;
+		data.assign((VOLUME + perWord - 1) / perWord, 0);
+
+		// with zero bits every voxel was palette slot 0, which is already what we have
+		if (oldBits == 0) {
+			return;
+		}
+
+		int oldPerWord = 64 / oldBits;
+		uint64_t oldMask = (1ull << oldBits) - 1;
+		for (int i = 0; i < VOLUME; i++) {
+			unsigned int value = static_cast<unsigned int>((oldData[i / oldPerWord] >> ((i % oldPerWord) * oldBits)) & oldMask);
+			if (value != 0) {
+				writeIndex(i, value);
+			}
+		}
+	}
+};
+
+// Local y of the highest solid voxel in every column of one chunk, so terrain height
+// queries answer without scanning voxels or evaluating noise
+struct ChunkHeightmap {
+	static const int8_t EMPTY = -1;
+
+	// Index x + z * CHUNK_SIZE, EMPTY for a column with no solid voxel in this chunk
+	std::array<int8_t, CHUNK_SIZE * CHUNK_SIZE> top;
+	// Highest entry of top
+	int8_t maxTop = EMPTY;
+
+	ChunkHeightmap() {
+		top.fill(EMPTY);
+	}
+
+	int8_t get(int x, int z) const {
+		return top[x + z * CHUNK_SIZE];
+	}
+
+	void build(const ChunkStorage& voxels) {
+		top.fill(EMPTY);
+		maxTop = EMPTY;
+		if (voxels.isEmpty()) {
+			return;
+		}
+		for (int z = 0; z < CHUNK_SIZE; z++) {
+			for (int x = 0; x < CHUNK_SIZE; x++) {
+				scanColumn(voxels, x, CHUNK_HEIGHT - 1, z);
+			}
+		}
+	}
+
+	// Call after the voxel at (x, y, z) changed
+	void update(const ChunkStorage& voxels, int x, int y, int z) {
+		int8_t& columnTop = top[x + z * CHUNK_SIZE];
+		if (voxels.isSolid(x, y, z)) {
+			columnTop = std::max(columnTop, static_cast<int8_t>(y));
+			maxTop = std::max(maxTop, columnTop);
+		}
+		else if (y == columnTop) {
+			// the top was removed, look further down this column only
+			bool wasMax = columnTop == maxTop;
+			columnTop = EMPTY;
+			scanColumn(voxels, x, y - 1, z);
+			if (wasMax) {
+				maxTop = *std::max_element(top.begin(), top.end());
+			}
+		}
+	}
+
+private:
+	void scanColumn(const ChunkStorage& voxels, int x, int fromY, int z) {
+		for (int y = fromY; y >= 0; y--) {
+			if (voxels.isSolid(x, y, z)) {
+				top[x + z * CHUNK_SIZE] = static_cast<int8_t>(y);
+				maxTop = std::max(maxTop, static_cast<int8_t>(y));
+				return;
+			}
+		}
+	}
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "../Model.h"
 #include "../Texture.h"
+#include "../TextureCache.h"
 #include "cube.hpp"
 #include "modelarray.hpp"
 #include <iostream>
@@ -45,8 +46,8 @@ public:
 		texName = fileTexName;
 		createMeshWithCulling();
 
-		Texture dirtTexture("assets/textures", fileTexName, aiTextureType_DIFFUSE);
-		dirtTexture.load();
+		Texture dirtTexture = TextureCache::acquire("assets/textures", fileTexName);
+		textures_loaded.push_back(dirtTexture);
 
 		if (!meshes.empty()) {
 			meshes[0].textures.push_back(dirtTexture);
@@ -62,9 +63,11 @@ public:
 			meshes.clear();
 			createMeshWithCulling();
 		}
-		Texture dirtTexture("assets/textures", texName, aiTextureType_DIFFUSE);
-		dirtTexture.load();
-		meshes[0].textures.push_back(dirtTexture);
+		// reuse the texture acquired in init(), or take a reference Model::cleanup() releases
+		if (textures_loaded.empty()) {
+			textures_loaded.push_back(TextureCache::acquire("assets/textures", texName));
+		}
+		meshes[0].textures.push_back(textures_loaded[0]);
 		meshes[0].setUseTexture(true);
 	}
 
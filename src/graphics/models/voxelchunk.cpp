@@ -1,158 +1,190 @@
-#include "voxelchunk.hpp"
+﻿#include "voxelchunk.hpp"
 #include "../Shader.h"
 #include "../env/World.h"// Needed for ChunkMeshData definition
+#include <chrono>
 
-void VoxelChunk::loadTextures() {
-	if (texturesLoaded) return;
+TextureArray VoxelChunk::blockTextures;
+bool VoxelChunk::blockTexturesLoaded = false;
 
-	// Load simple textures
-	voxelTextures[VoxelType::DIRT].diffuse = Texture("assets/textures", "dirt.png", aiTextureType_DIFFUSE);
-	voxelTextures[VoxelType::DIRT].diffuse.load();
-	voxelTextures[VoxelType::COBBLESTONE].diffuse = Texture("assets/textures", "cobblestone.png", aiTextureType_DIFFUSE);
-	voxelTextures[VoxelType::COBBLESTONE].diffuse.load();
-	voxelTextures[VoxelType::SAND].diffuse = Texture("assets/textures", "sand.png", aiTextureType_DIFFUSE);
-	voxelTextures[VoxelType::SAND].diffuse.load();
+void VoxelChunk::loadBlockTextures() {
+	if (blockTexturesLoaded) return;
 
-	// Load grass textures
-	voxelTextures[VoxelType::GRASS].top = Texture("assets/textures", "grass_block_top.png", aiTextureType_DIFFUSE);
-	voxelTextures[VoxelType::GRASS].top.load();
-	voxelTextures[VoxelType::GRASS].side = Texture("assets/textures", "grass_block_side.png", aiTextureType_DIFFUSE);
-	voxelTextures[VoxelType::GRASS].side.load();
-	voxelTextures[VoxelType::GRASS].bottom = Texture("assets/textures", "dirt.png", aiTextureType_DIFFUSE);
-	voxelTextures[VoxelType::GRASS].bottom.load();
-	voxelTextures[VoxelType::GRASS].hasMultipleTextures = true;
+	// One layer per entry, in the order textureLayer() hands them out
+	std::vector<std::string> layers = {
+		"dirt.png",
+		"cobblestone.png",
+		"sand.png",
+		"grass_block_top.png",
+		"grass_block_side.png",
+		"log.png",
+		"leaves.png",
+		"lamp.png"
+	};
+	blockTextures.load("assets/textures", layers);
 
-	texturesLoaded = true;
+	blockTexturesLoaded = true;
 }
 
-void VoxelChunk::uploadMesh(const ChunkMeshData& data) {
-	loadTextures();
+void VoxelChunk::releaseBlockTextures() {
+	if (!blockTexturesLoaded) return;
+
+	blockTextures.cleanup();
+	blockTexturesLoaded = false;
+}
+
+void VoxelChunk::bindBlockTextures(Shader& shader) {
+	loadBlockTextures();
+
+	glActiveTexture(GL_TEXTURE0 + BLOCK_TEXTURE_UNIT);
+	blockTextures.bind();
+	glActiveTexture(GL_TEXTURE0);
+	shader.setInt("blockTextures", BLOCK_TEXTURE_UNIT);
+	shader.setInt("grassTintLayer", GRASS_TOP_LAYER);
+	shader.set3Float("grassTintColor", 0.6f, 1.0f, 0.4f);
+}
+
+size_t VoxelChunk::getBlockTextureBytes() {
+	return blockTextures.memoryUsage();
+}
+
+VoxelChunk::~VoxelChunk() {
 	cleanup();
+}
 
-	// Create meshes for simple voxel types
-	for (int i = 0; i < 4; ++i) {
-		if (!data.simpleVertices[i].empty()) {
-			VoxelType type = static_cast<VoxelType>(i);
-			Mesh newMesh(data.simpleVertices[i], data.simpleIndices[i]);
-			newMesh.textures.push_back(voxelTextures.at(type).diffuse);
-			newMesh.setUseTexture(true);
-			chunkMeshes[type].push_back(newMesh);
-		}
-	}
+void VoxelChunk::uploadMesh(const ChunkMeshData& data) {
+	std::shared_ptr<ChunkMeshData> copy = std::make_shared<ChunkMeshData>();
+	copy->chunkKey = data.chunkKey;
+	copy->chunkPosition = data.chunkPosition;
+	copy->vertices = data.vertices;
+	copy->indices = data.indices;
+	copy->meshingTimeMs = data.meshingTimeMs;
+	copy->seamFacesCulled = data.seamFacesCulled;
+	copy->neighborMask = data.neighborMask;
+	copy->materialBuckets = data.materialBuckets;
+	copy->solidMinY = data.solidMinY;
+	copy->solidMaxY = data.solidMaxY;
+	uploadMesh(std::shared_ptr<const ChunkMeshData>(copy));
+}
+
+void VoxelChunk::uploadMesh(std::shared_ptr<const ChunkMeshData> data) {
+	loadBlockTextures();
+	geometry = std::move(data);
+	const ChunkMeshData& meshData = *geometry;
+
+	vertexCount = meshData.vertexCount();
+	indexCount = meshData.indexCount();
+	seamFacesCulled = meshData.seamFacesCulled;
+	neighborMask = meshData.neighborMask;
+	meshBytes = meshData.memoryUsage();
+	materialBuckets = meshData.materialBuckets;
 
-	// Create meshes for grass
-	if (!data.grassTopVertices.empty()) {
-		Mesh topMesh(data.grassTopVertices, data.grassTopIndices);
-		topMesh.textures.push_back(voxelTextures.at(VoxelType::GRASS).top);
-		topMesh.setUseTexture(true);
-		chunkMeshes[VoxelType::GRASS].push_back(topMesh);
+	if (meshData.indices.empty()) {
+		cleanup();
+		return;
 	}
-	if (!data.grassSideVertices.empty()) {
-		Mesh sideMesh(data.grassSideVertices, data.grassSideIndices);
-		sideMesh.textures.push_back(voxelTextures.at(VoxelType::GRASS).side);
-		sideMesh.setUseTexture(true);
-		chunkMeshes[VoxelType::GRASS].push_back(sideMesh);
+
+	if (hasMesh) {
+		mesh.update(meshData.vertices, meshData.indices);
 	}
-	if (!data.grassBottomVertices.empty()) {
-		Mesh bottomMesh(data.grassBottomVertices, data.grassBottomIndices);
-		bottomMesh.textures.push_back(voxelTextures.at(VoxelType::GRASS).bottom);
-		bottomMesh.setUseTexture(true);
-		chunkMeshes[VoxelType::GRASS].push_back(bottomMesh);
+	else {
+		mesh = ChunkMesh(meshData.vertices, meshData.indices);
+		hasMesh = true;
 	}
+	boundsMin = chunkPosition + glm::vec3(0.0f, static_cast<float>(meshData.solidMinY), 0.0f);
+	boundsMax = chunkPosition + glm::vec3(static_cast<float>(CHUNK_SIZE), static_cast<float>(meshData.solidMaxY), static_cast<float>(CHUNK_SIZE));
 }
 
-void VoxelChunk::render(Shader& shader) {
-	if (chunkMeshes.empty()) {
-		return;
+int VoxelChunk::render(Shader& shader) {
+	if (!hasMesh) {
+		return 0;
 	}
 
 	glm::mat4 model = glm::translate(glm::mat4(1.0f), chunkPosition);
 	shader.setMat4("model", model);
-	shader.setFloat("material.shininess", 32.0f);
-	shader.setInt("applyGrassTint", 0);
-
-	for (auto& pair : chunkMeshes) {
-		VoxelType voxelType = pair.first;
-		for (size_t i = 0; i < pair.second.size(); i++) {
-			auto& mesh = pair.second[i];
-			if (voxelType == VoxelType::GRASS && mesh.textures[0].path == "grass_block_top.png") {
-				shader.setInt("applyGrassTint", 1);
-				shader.set3Float("grassTintColor", 0.6f, 1.0f, 0.4f);
-			}
-			else {
-				shader.setInt("applyGrassTint", 0);
-			}
-			mesh.render(shader);
-		}
-	}
+	mesh.render();
+	return 1;
 }
 
 void VoxelChunk::cleanup() {
-	for (auto& pair : chunkMeshes) {
-		for (auto& mesh : pair.second) {
-			mesh.clearnup();
-		}
+	if (hasMesh) {
+		mesh.cleanup();
+		hasMesh = false;
 	}
-	chunkMeshes.clear();
 }
 
-void VoxelChunk::addFaceToMeshData(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, glm::vec3 localPos, Face face) {
+int VoxelChunk::getMaterialBucketCount() const {
+	int count = 0;
+	for (int i = 0; i < MATERIAL_BUCKETS; i++) {
+		if (materialBuckets & (1 << i)) count++;
+	}
+	return count;
+}
+
+void VoxelChunk::addFaceToMeshData(std::vector<VoxelVertex>& vertices, std::vector<unsigned int>& indices, glm::ivec3 localPos, Face face, int layer, uint8_t light) {
+	addQuadToMeshData(vertices, indices, localPos, glm::ivec3(1), face, layer, light);
+}
+
+void VoxelChunk::addQuadToMeshData(std::vector<VoxelVertex>& vertices, std::vector<unsigned int>& indices, glm::ivec3 minCorner, glm::ivec3 size, Face face, int layer, uint8_t light) {
 	unsigned int startIndex = vertices.size();
-	glm::vec3 facePositions[4];
-	glm::vec3 normal;
+	glm::ivec3 facePositions[4];
+	// extent of the quad along the texture's u and v axes, in blocks
+	int texWidth, texHeight;
 
-	// IMPORTANT: Add 0.5 offset to center the block at its coordinate
-	glm::vec3 blockCenter = localPos + glm::vec3(0.5f, 0.5f, 0.5f);
+	glm::ivec3 p = minCorner;
+	glm::ivec3 q = minCorner + size;
 
 	switch (face) {
 	case Face::FRONT:
-		facePositions[0] = blockCenter + glm::vec3(-0.5f, -0.5f, 0.5f);
-		facePositions[1] = blockCenter + glm::vec3(0.5f, -0.5f, 0.5f);
-		facePositions[2] = blockCenter + glm::vec3(0.5f, 0.5f, 0.5f);
-		facePositions[3] = blockCenter + glm::vec3(-0.5f, 0.5f, 0.5f);
-		normal = glm::vec3(0.0f, 0.0f, 1.0f);
+		facePositions[0] = glm::ivec3(p.x, p.y, q.z);
+		facePositions[1] = glm::ivec3(q.x, p.y, q.z);
+		facePositions[2] = glm::ivec3(q.x, q.y, q.z);
+		facePositions[3] = glm::ivec3(p.x, q.y, q.z);
+		texWidth = size.x; texHeight = size.y;
 		break;
 	case Face::BACK:
-		facePositions[0] = blockCenter + glm::vec3(0.5f, -0.5f, -0.5f);
-		facePositions[1] = blockCenter + glm::vec3(-0.5f, -0.5f, -0.5f);
-		facePositions[2] = blockCenter + glm::vec3(-0.5f, 0.5f, -0.5f);
-		facePositions[3] = blockCenter + glm::vec3(0.5f, 0.5f, -0.5f);
-		normal = glm::vec3(0.0f, 0.0f, -1.0f);
+		facePositions[0] = glm::ivec3(q.x, p.y, p.z);
+		facePositions[1] = glm::ivec3(p.x, p.y, p.z);
+		facePositions[2] = glm::ivec3(p.x, q.y, p.z);
+		facePositions[3] = glm::ivec3(q.x, q.y, p.z);
+		texWidth = size.x; texHeight = size.y;
 		break;
 	case Face::LEFT:
-		facePositions[0] = blockCenter + glm::vec3(-0.5f, -0.5f, -0.5f);
-		facePositions[1] = blockCenter + glm::vec3(-0.5f, -0.5f, 0.5f);
-		facePositions[2] = blockCenter + glm::vec3(-0.5f, 0.5f, 0.5f);
-		facePositions[3] = blockCenter + glm::vec3(-0.5f, 0.5f, -0.5f);
-		normal = glm::vec3(-1.0f, 0.0f, 0.0f);
+		facePositions[0] = glm::ivec3(p.x, p.y, p.z);
+		facePositions[1] = glm::ivec3(p.x, p.y, q.z);
+		facePositions[2] = glm::ivec3(p.x, q.y, q.z);
+		facePositions[3] = glm::ivec3(p.x, q.y, p.z);
+		texWidth = size.z; texHeight = size.y;
 		break;
 	case Face::RIGHT:
-		facePositions[0] = blockCenter + glm::vec3(0.5f, -0.5f, 0.5f);
-		facePositions[1] = blockCenter + glm::vec3(0.5f, -0.5f, -0.5f);
-		facePositions[2] = blockCenter + glm::vec3(0.5f, 0.5f, -0.5f);
-		facePositions[3] = blockCenter + glm::vec3(0.5f, 0.5f, 0.5f);
-		normal = glm::vec3(1.0f, 0.0f, 0.0f);
+		facePositions[0] = glm::ivec3(q.x, p.y, q.z);
+		facePositions[1] = glm::ivec3(q.x, p.y, p.z);
+		facePositions[2] = glm::ivec3(q.x, q.y, p.z);
+		facePositions[3] = glm::ivec3(q.x, q.y, q.z);
+		texWidth = size.z; texHeight = size.y;
 		break;
 	case Face::BOTTOM:
-		facePositions[0] = blockCenter + glm::vec3(-0.5f, -0.5f, -0.5f);
-		facePositions[1] = blockCenter + glm::vec3(0.5f, -0.5f, -0.5f);
-		facePositions[2] = blockCenter + glm::vec3(0.5f, -0.5f, 0.5f);
-		facePositions[3] = blockCenter + glm::vec3(-0.5f, -0.5f, 0.5f);
-		normal = glm::vec3(0.0f, -1.0f, 0.0f);
+		facePositions[0] = glm::ivec3(p.x, p.y, p.z);
+		facePositions[1] = glm::ivec3(q.x, p.y, p.z);
+		facePositions[2] = glm::ivec3(q.x, p.y, q.z);
+		facePositions[3] = glm::ivec3(p.x, p.y, q.z);
+		texWidth = size.x; texHeight = size.z;
 		break;
 	case Face::TOP:
-		facePositions[0] = blockCenter + glm::vec3(-0.5f, 0.5f, 0.5f);
-		facePositions[1] = blockCenter + glm::vec3(0.5f, 0.5f, 0.5f);
-		facePositions[2] = blockCenter + glm::vec3(0.5f, 0.5f, -0.5f);
-		facePositions[3] = blockCenter + glm::vec3(-0.5f, 0.5f, -0.5f);
-		normal = glm::vec3(0.0f, 1.0f, 0.0f);
+	default:
+		facePositions[0] = glm::ivec3(p.x, q.y, q.z);
+		facePositions[1] = glm::ivec3(q.x, q.y, q.z);
+		facePositions[2] = glm::ivec3(q.x, q.y, p.z);
+		facePositions[3] = glm::ivec3(p.x, q.y, p.z);
+		texWidth = size.x; texHeight = size.z;
 		break;
 	}
 
-	glm::vec2 texCoords[] = { {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} };
+	// Block textures use GL_REPEAT, so coordinates past 1.0 tile once per block
+	glm::ivec2 texCoords[] = { {0, 0}, {texWidth, 0}, {texWidth, texHeight}, {0, texHeight} };
 
 	for (int i = 0; i < 4; i++) {
-		vertices.push_back({ facePositions[i], normal, texCoords[i] });
+		vertices.push_back(VoxelVertex::pack(facePositions[i].x, facePositions[i].y, facePositions[i].z,
+			face, texCoords[i].x, texCoords[i].y, layer, light));
 	}
 
 	indices.insert(indices.end(), {
@@ -163,62 +195,270 @@ void VoxelChunk::addFaceToMeshData(std::vector<Vertex>& vertices, std::vector<un
 
 // CORRECTED: Removed the duplicate setBlock function
 void VoxelChunk::setBlock(int localX, int localY, int localZ, VoxelType type) {
-	if (type == VoxelType::AIR) {
-		if (voxels.count(localX) && voxels[localX].count(localY) && voxels[localX][localY].count(localZ)) {
-			voxels[localX][localY].erase(localZ);
-		}
-	}
-	else {
-		voxels[localX][localY][localZ] = type;
-	}
+	voxels.set(localX, localY, localZ, type);
+	heightmap.update(voxels, localX, localY, localZ);
 }
 
 // CORRECTED: Renamed function to getBlockType
 VoxelType VoxelChunk::getBlockType(int localX, int localY, int localZ) {
-	if (voxels.count(localX) && voxels[localX].count(localY) && voxels[localX][localY].count(localZ)) {
-		return voxels.at(localX).at(localY).at(localZ);
+	return voxels.get(localX, localY, localZ);
+}
+
+void VoxelChunk::emitQuad(ChunkMeshData& meshData, VoxelType type, glm::ivec3 minCorner, glm::ivec3 size, Face face, uint8_t light) {
+	int bucket = static_cast<int>(type);
+	if (type == VoxelType::GRASS) {
+		bucket = face == Face::TOP ? 4 : (face == Face::BOTTOM ? 6 : 5);
+	}
+	else if (type == VoxelType::LOG) {
+		// grass never uses its own value, so the log takes that bit
+		bucket = 3;
 	}
-	return VoxelType::AIR;
+	else if (type == VoxelType::LEAVES) {
+		bucket = 7;
+	}
+	else if (type == VoxelType::LAMP) {
+		bucket = 8;
+	}
+	meshData.materialBuckets |= (1 << bucket);
+
+	addQuadToMeshData(meshData.vertices, meshData.indices, minCorner, size, face, textureLayer(type, face), light);
+}
+
+uint8_t VoxelChunk::faceLight(const ChunkLight* light, const ChunkNeighbors& neighbors, int x, int y, int z) {
+	if (!light) {
+		return VoxelVertex::FULL_LIGHT;
+	}
+	if (ChunkStorage::inBounds(x, y, z)) {
+		return light->get(ChunkStorage::index(x, y, z));
+	}
+	return neighbors.lightAt(x, y, z);
 }
 
-void VoxelChunk::rebuildMesh() {
-	ChunkMeshData meshData;
+void VoxelChunk::buildMeshData(const ChunkStorage& voxels, const ChunkNeighbors& neighbors, ChunkMeshData& meshData, MeshingMode mode, const ChunkLight* light) {
+	auto start = std::chrono::high_resolution_clock::now();
 
-	auto hasVoxel = [&](int x, int y, int z) {
-		return voxels.count(x) && voxels.at(x).count(y) && voxels.at(x).at(y).count(z);
-		};
+	meshData.neighborMask = neighbors.mask();
+	if (!voxels.solidHeightRange(meshData.solidMinY, meshData.solidMaxY)) {
+		meshData.solidMinY = meshData.solidMaxY = 0;
+	}
 
-	for (const auto& x_pair : voxels) {
-		int x = x_pair.first;
-		for (const auto& y_pair : x_pair.second) {
-			int y = y_pair.first;
-			for (const auto& z_pair : y_pair.second) {
-				int z = z_pair.first;
-				VoxelType currentType = z_pair.second;
+	// Deep underground chunks have nothing to draw, skip the whole pass
+	if (meshData.solidMaxY > meshData.solidMinY && !neighbors.buried()) {
+		if (mode == MeshingMode::GREEDY) {
+			// greedy meshing visits every voxel six times, so read the packed storage only once
+			std::vector<VoxelType> dense;
+			voxels.unpack(dense);
+			buildGreedyMesh(dense, neighbors, light, meshData, meshData.solidMinY, meshData.solidMaxY);
+		}
+		else {
+			buildNaiveMesh(voxels, neighbors, light, meshData, meshData.solidMinY, meshData.solidMaxY);
+		}
+	}
+
+	meshData.meshingTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void VoxelChunk::buildNaiveMesh(const ChunkStorage& voxels, const ChunkNeighbors& neighbors, const ChunkLight* light, ChunkMeshData& meshData, int minY, int maxY) {
+	static const Face faces[] = { Face::FRONT, Face::BACK, Face::LEFT, Face::RIGHT, Face::TOP, Face::BOTTOM };
+	static const glm::ivec3 offsets[] = { {0, 0, 1}, {0, 0, -1}, {-1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, -1, 0} };
+
+	for (int y = minY; y < maxY; y++) {
+		for (int z = 0; z < CHUNK_SIZE; z++) {
+			for (int x = 0; x < CHUNK_SIZE; x++) {
+				VoxelType currentType = voxels.get(x, y, z);
 				if (currentType == VoxelType::AIR) continue;
 
-				glm::vec3 localVoxelPos(x, y, z);
-				if (currentType == VoxelType::GRASS) {
-					if (!hasVoxel(x, y + 1, z)) VoxelChunk::addFaceToMeshData(meshData.grassTopVertices, meshData.grassTopIndices, localVoxelPos, Face::TOP);
-					if (!hasVoxel(x, y - 1, z)) VoxelChunk::addFaceToMeshData(meshData.grassBottomVertices, meshData.grassBottomIndices, localVoxelPos, Face::BOTTOM);
-					if (!hasVoxel(x, y, z + 1)) VoxelChunk::addFaceToMeshData(meshData.grassSideVertices, meshData.grassSideIndices, localVoxelPos, Face::FRONT);
-					if (!hasVoxel(x, y, z - 1)) VoxelChunk::addFaceToMeshData(meshData.grassSideVertices, meshData.grassSideIndices, localVoxelPos, Face::BACK);
-					if (!hasVoxel(x - 1, y, z)) VoxelChunk::addFaceToMeshData(meshData.grassSideVertices, meshData.grassSideIndices, localVoxelPos, Face::LEFT);
-					if (!hasVoxel(x + 1, y, z)) VoxelChunk::addFaceToMeshData(meshData.grassSideVertices, meshData.grassSideIndices, localVoxelPos, Face::RIGHT);
+				glm::ivec3 localVoxelPos(x, y, z);
+				for (int f = 0; f < 6; f++) {
+					int nx = x + offsets[f].x, ny = y + offsets[f].y, nz = z + offsets[f].z;
+					if (ChunkStorage::inBounds(nx, ny, nz)) {
+						if (voxels.isSolid(nx, ny, nz)) continue;
+					}
+					else if (neighbors.isSolid(nx, ny, nz)) {
+						meshData.seamFacesCulled++;
+						continue;
+					}
+
+					emitQuad(meshData, currentType, localVoxelPos, glm::ivec3(1), faces[f], faceLight(light, neighbors, nx, ny, nz));
+				}
+			}
+		}
+	}
+}
+
+void VoxelChunk::buildGreedyMesh(const std::vector<VoxelType>& dense, const ChunkNeighbors& neighbors, const ChunkLight* light, ChunkMeshData& meshData, int minY, int maxY) {
+	static const Face faces[] = { Face::RIGHT, Face::LEFT, Face::TOP, Face::BOTTOM, Face::FRONT, Face::BACK };
+	// The box being meshed, in chunk coordinates
+	const int lo[3] = { 0, minY, 0 };
+	const int hi[3] = { CHUNK_SIZE, maxY, CHUNK_SIZE };
+
+	auto typeAt = [&](const int p[3]) {
+		if (!ChunkStorage::inBounds(p[0], p[1], p[2])) {
+			return VoxelType::AIR;
+		}
+		return dense[ChunkStorage::index(p[0], p[1], p[2])];
+		};
+
+	// 0 = no face, otherwise VoxelType + 1 of the exposed block with the face's light
+	// above it, so only faces lit alike merge
+	std::vector<int> mask(CHUNK_HEIGHT * CHUNK_SIZE);
+
+	for (int f = 0; f < 6; f++) {
+		int axis = f / 2;				// axis of the face normal
+		int dir = (f % 2 == 0) ? 1 : -1;
+		int u = (axis + 1) % 3;			// the two axes spanning the slice
+		int v = (axis + 2) % 3;
+		int sliceWidth = hi[u] - lo[u];
+		int sliceHeight = hi[v] - lo[v];
+
+		for (int slice = lo[axis]; slice < hi[axis]; slice++) {
+			int pos[3];
+			pos[axis] = slice;
+			for (int b = 0; b < sliceHeight; b++) {
+				for (int a = 0; a < sliceWidth; a++) {
+					pos[u] = lo[u] + a;
+					pos[v] = lo[v] + b;
+					VoxelType type = typeAt(pos);
+					int exposed = 0;
+					if (type != VoxelType::AIR) {
+						int next[3] = { pos[0], pos[1], pos[2] };
+						next[axis] += dir;
+						if (ChunkStorage::inBounds(next[0], next[1], next[2])) {
+							if (typeAt(next) == VoxelType::AIR) {
+								exposed = static_cast<int>(type) + 1;
+							}
+						}
+						else if (neighbors.isSolid(next[0], next[1], next[2])) {
+							meshData.seamFacesCulled++;
+						}
+						else {
+							exposed = static_cast<int>(type) + 1;
+						}
+						if (exposed) {
+							exposed |= faceLight(light, neighbors, next[0], next[1], next[2]) << 8;
+						}
+					}
+					mask[b * sliceWidth + a] = exposed;
 				}
-				else {
-					int typeIndex = static_cast<int>(currentType);
-					if (!hasVoxel(x, y, z + 1)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::FRONT);
-					if (!hasVoxel(x, y, z - 1)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::BACK);
-					if (!hasVoxel(x - 1, y, z)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::LEFT);
-					if (!hasVoxel(x + 1, y, z)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::RIGHT);
-					if (!hasVoxel(x, y + 1, z)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::TOP);
-					if (!hasVoxel(x, y - 1, z)) VoxelChunk::addFaceToMeshData(meshData.simpleVertices[typeIndex], meshData.simpleIndices[typeIndex], localVoxelPos, Face::BOTTOM);
+			}
+
+			// Grow each unvisited cell along u, then along v while the whole row matches
+			for (int b = 0; b < sliceHeight; b++) {
+				for (int a = 0; a < sliceWidth; ) {
+					int material = mask[b * sliceWidth + a];
+					if (material == 0) {
+						a++;
+						continue;
+					}
+
+					int width = 1;
+					while (a + width < sliceWidth && mask[b * sliceWidth + a + width] == material) {
+						width++;
+					}
+
+					int height = 1;
+					bool rowMatches = true;
+					while (b + height < sliceHeight && rowMatches) {
+						for (int k = 0; k < width; k++) {
+							if (mask[(b + height) * sliceWidth + a + k] != material) {
+								rowMatches = false;
+								break;
+							}
+						}
+						if (rowMatches) height++;
+					}
+
+					glm::ivec3 minCorner, size(1);
+					minCorner[axis] = slice;
+					minCorner[u] = lo[u] + a;
+					minCorner[v] = lo[v] + b;
+					size[u] = width;
+					size[v] = height;
+
+					emitQuad(meshData, static_cast<VoxelType>((material & 0xFF) - 1), minCorner, size, faces[f], static_cast<uint8_t>(material >> 8));
+
+					for (int h = 0; h < height; h++) {
+						for (int k = 0; k < width; k++) {
+							mask[(b + h) * sliceWidth + a + k] = 0;
+						}
+					}
+					a += width;
 				}
 			}
 		}
 	}
-	uploadMesh(meshData);
+}
+
+void VoxelChunk::rebuildMesh(const ChunkNeighbors& neighbors, MeshingMode mode) {
+	std::shared_ptr<ChunkMeshData> meshData = std::make_shared<ChunkMeshData>();
+	buildMeshData(voxels, neighbors, *meshData, mode, &light);
+
+	// this covers every edit so far, edit remeshes still running are out of date
+	meshVersion++;
+	uploadMesh(std::shared_ptr<const ChunkMeshData>(meshData));
+}
+
+uint32_t VoxelChunk::markEdited() {
+	return ++meshVersion;
+}
+
+bool VoxelChunk::applyRemesh(uint32_t version, std::shared_ptr<const ChunkMeshData> data) {
+	if (version != meshVersion) {
+		return false;
+	}
+	uploadMesh(std::move(data));
+	return true;
+}
+
+std::shared_ptr<const ChunkEdge> VoxelChunk::extractEdge(const ChunkStorage& voxels, Face side, const ChunkLight* light) {
+	std::shared_ptr<ChunkEdge> edge = std::make_shared<ChunkEdge>();
+	edge->solid.resize(CHUNK_SIZE * CHUNK_SIZE);
+	if (light) {
+		edge->light.resize(CHUNK_SIZE * CHUNK_SIZE);
+	}
+	edge->full = true;
+	for (int b = 0; b < CHUNK_SIZE; b++) {
+		for (int a = 0; a < CHUNK_SIZE; a++) {
+			glm::ivec3 cell = borderCell(side, a, b);
+			bool solid = voxels.isSolid(cell.x, cell.y, cell.z);
+			edge->solid[b * CHUNK_SIZE + a] = solid ? 1 : 0;
+			edge->full = edge->full && solid;
+			if (light) {
+				edge->light[b * CHUNK_SIZE + a] = light->get(ChunkStorage::index(cell.x, cell.y, cell.z));
+			}
+		}
+	}
+	return edge;
+}
+
+ChunkBorders VoxelChunk::extractBorders(const ChunkStorage& voxels, const ChunkLight* light) {
+	ChunkBorders borders;
+	for (int side = 0; side < 6; side++) {
+		borders[side] = extractEdge(voxels, static_cast<Face>(side), light);
+	}
+	return borders;
+}
+
+Face VoxelChunk::oppositeFace(Face face) {
+	switch (face) {
+	case Face::FRONT:  return Face::BACK;
+	case Face::BACK:   return Face::FRONT;
+	case Face::LEFT:   return Face::RIGHT;
+	case Face::RIGHT:  return Face::LEFT;
+	case Face::TOP:    return Face::BOTTOM;
+	case Face::BOTTOM: return Face::TOP;
+	}
+	return face;
+}
+
+int VoxelChunk::textureLayer(VoxelType type, Face face) {
+	// Every other type uses its VoxelType value, grass picks a layer per side
+	if (type == VoxelType::GRASS) {
+		if (face == Face::TOP) return GRASS_TOP_LAYER;
+		if (face == Face::BOTTOM) return static_cast<int>(VoxelType::DIRT);
+		return GRASS_SIDE_LAYER;
+	}
+	return static_cast<int>(type);
 }
 
 // CORRECTED: This function is now a dummy to prevent compile errors.
@@ -2,70 +2,248 @@
 #define VOXELCHUNK_HPP
 
 #include "voxel.hpp"
+#include "chunkstorage.hpp"
+#include "chunklight.hpp"
+#include "chunkmesh.hpp"
+#include "../TextureArray.h"
 #include "../../generation/perlin.h"
 #include <vector>
 #include <array>
+#include <memory>
 #include <unordered_map>
-#include <map> // <-- ADD THIS LINE
 
 // Forward declare the struct to avoid circular dependency
 struct ChunkMeshData;
 
-enum class VoxelType {
-	DIRT = 0,
-	COBBLESTONE = 1,
-	SAND = 2,
-	GRASS = 3,
-	AIR = 4
+// How chunk geometry is built from the voxel data.
+// NAIVE emits one quad per exposed block face, GREEDY merges coplanar faces of
+// the same block type into larger quads with repeating texture coordinates.
+enum class MeshingMode {
+	NAIVE = 0,
+	GREEDY = 1
 };
 
-struct VoxelTextures {
-	Texture diffuse;
-	Texture top;
-	Texture side;
-	Texture bottom;
-	bool hasMultipleTextures = false;
+// Solid flags and light of one border slice of a chunk, CHUNK_SIZE x CHUNK_SIZE.
+// Adjacent chunks read these to cull faces across the chunk seams and to light the
+// faces and voxels next to them. On the side faces a runs along the face and b is y,
+// on the top and bottom faces a is x and b is z.
+struct ChunkEdge {
+	std::vector<uint8_t> solid;
+	// Packed like ChunkLight, empty if the chunk wasn't lit
+	std::vector<uint8_t> light;
+	// every cell solid, nothing behind it can be seen through this side
+	bool full = false;
+
+	bool isSolid(int a, int b) const {
+		return solid[b * CHUNK_SIZE + a] != 0;
+	}
+
+	bool hasLight() const {
+		return !light.empty();
+	}
+
+	uint8_t lightAt(int a, int b) const {
+		return light[b * CHUNK_SIZE + a];
+	}
 };
 
-const int CHUNK_SIZE = 16;
-const int CHUNK_HEIGHT = 64;
+// The outer border slices of one chunk, indexed by the Face they lie on
+typedef std::array<std::shared_ptr<const ChunkEdge>, 6> ChunkBorders;
+
+// Border slices of the adjacent chunks, indexed by the Face pointing towards them.
+// A null entry means that neighbour isn't loaded and faces towards it are kept,
+// unless missingIsSolid is set.
+struct ChunkNeighbors {
+	std::array<std::shared_ptr<const ChunkEdge>, 6> edges;
+	// Set for chunks without any air: buried chunks then need no mesh until a
+	// neighbour with air next to them turns up (see World::queueSeamReculls)
+	bool missingIsSolid = false;
+
+	// Border slice cell of a position just outside the chunk on one axis; false for a
+	// position inside it. edge is null if that neighbour is missing.
+	bool locate(int x, int y, int z, const ChunkEdge*& edge, int& a, int& b) const {
+		Face face;
+		if (x < 0) { face = Face::LEFT; a = z; b = y; }
+		else if (x >= CHUNK_SIZE) { face = Face::RIGHT; a = z; b = y; }
+		else if (z < 0) { face = Face::BACK; a = x; b = y; }
+		else if (z >= CHUNK_SIZE) { face = Face::FRONT; a = x; b = y; }
+		else if (y < 0) { face = Face::BOTTOM; a = x; b = z; }
+		else if (y >= CHUNK_HEIGHT) { face = Face::TOP; a = x; b = z; }
+		else return false;
+
+		edge = edges[static_cast<int>(face)].get();
+		return true;
+	}
+
+	// Solid test for a position just outside the chunk on one axis
+	bool isSolid(int x, int y, int z) const {
+		const ChunkEdge* edge;
+		int a, b;
+		if (!locate(x, y, z, edge, a, b)) return false;
+		if (!edge) return missingIsSolid;
+		return edge->isSolid(a, b);
+	}
+
+	// Packed light of such a position. Faces towards a neighbour that is missing or
+	// wasn't lit get full sky light rather than going black.
+	uint8_t lightAt(int x, int y, int z) const {
+		const ChunkEdge* edge;
+		int a, b;
+		if (!locate(x, y, z, edge, a, b) || !edge || !edge->hasLight()) {
+			return ChunkLight::pack(MAX_LIGHT, 0);
+		}
+		return edge->lightAt(a, b);
+	}
+
+	// True if no face of a chunk without air can be exposed: every neighbour is either
+	// missing (and taken for solid) or solid all along the shared side
+	bool buried() const {
+		if (!missingIsSolid) return false;
+		for (const auto& edge : edges) {
+			if (edge && !edge->full) return false;
+		}
+		return true;
+	}
+
+	// Bit per Face for the neighbours the mesh doesn't have to be redone for
+	uint8_t mask() const {
+		if (missingIsSolid) return 0x3F;
+		uint8_t bits = 0;
+		for (int i = 0; i < 6; i++) {
+			if (edges[i]) bits |= (1 << i);
+		}
+		return bits;
+	}
+};
 
 class VoxelChunk {
 public:
-	// CORRECTED: Changed to unordered_map to match ChunkMeshData
-	std::unordered_map<int, std::unordered_map<int, std::unordered_map<int, VoxelType>>> voxels;
+	ChunkStorage voxels;
+	// Kept current by World, the mesh bakes it into its vertices
+	ChunkLight light;
 
 private:
 	glm::vec3 chunkPosition;
-	std::map<VoxelType, std::vector<Mesh>> chunkMeshes;
-	std::map<VoxelType, VoxelTextures> voxelTextures;
-	bool texturesLoaded = false;
+	ChunkMesh mesh;
+	bool hasMesh = false;
+	// CPU copy of the uploaded geometry (voxels left empty), never modified once set
+	std::shared_ptr<const ChunkMeshData> geometry;
+	// Bumped by every voxel change; remesh results built for an older version are dropped
+	uint32_t meshVersion = 0;
+	// World space box around the solid voxels, only valid while hasMesh
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
 	bool voxelDataLoaded = false;
+	// Top solid voxel per column, kept current by setBlock
+	ChunkHeightmap heightmap;
+
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	size_t seamFacesCulled = 0;
+	size_t meshBytes = 0;
+	uint16_t materialBuckets = 0;
+	// Which neighbours' border slices the current mesh was culled against
+	uint8_t neighborMask = 0;
 
 public:
-	VoxelChunk(glm::vec3 pos, unsigned int seed) : chunkPosition(pos) {}
+	VoxelChunk(glm::vec3 pos, unsigned int seed) : chunkPosition(pos), boundsMin(pos), boundsMax(pos) {}
 
-	~VoxelChunk() {
-		cleanup();
-	}
+	~VoxelChunk();
+
+	// Texture array layers of the block faces; DIRT, COBBLESTONE and SAND use their VoxelType value
+	static const int GRASS_TOP_LAYER = 3;
+	static const int GRASS_SIDE_LAYER = 4;
+	// Meshes the old per-material renderer used, see ChunkMeshData::materialBuckets
+	static const int MATERIAL_BUCKETS = 9;
+	// Kept off unit 0 so the sampler2DArray never shares a unit with diffuse0
+	static const int BLOCK_TEXTURE_UNIT = 1;
 
 	void uploadMesh(const ChunkMeshData& data);
-	void render(Shader& shader);
+	// Takes over the geometry without copying it. A chunk that already has buffers
+	// gets their contents replaced instead of new ones.
+	void uploadMesh(std::shared_ptr<const ChunkMeshData> data);
+	// Draws the whole chunk with one call, returns the number of draw calls issued
+	int render(Shader& shader);
 	void cleanup();
 
-	static void addFaceToMeshData(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, glm::vec3 localPos, Face face);
+	// Block textures are one texture array shared by every chunk.
+	// Loading is idempotent; uploadMesh loads them if startup didn't.
+	static void loadBlockTextures();
+	static void releaseBlockTextures();
+	// Binds the block texture array and sets the shader state every chunk draws with
+	static void bindBlockTextures(Shader& shader);
+	static size_t getBlockTextureBytes();
+
+	static void addFaceToMeshData(std::vector<VoxelVertex>& vertices, std::vector<unsigned int>& indices, glm::ivec3 localPos, Face face, int layer,
+		uint8_t light = VoxelVertex::FULL_LIGHT);
+	// Quad on the given side of the block box [minCorner, minCorner + size), texture repeats once per block
+	static void addQuadToMeshData(std::vector<VoxelVertex>& vertices, std::vector<unsigned int>& indices, glm::ivec3 minCorner, glm::ivec3 size, Face face, int layer,
+		uint8_t light = VoxelVertex::FULL_LIGHT);
+	// Fills the vertices/indices of meshData from the solid voxels with exposed faces.
+	// Every face takes the light of the voxel in front of it; without light they are all
+	// fully sky lit.
+	static void buildMeshData(const ChunkStorage& voxels, const ChunkNeighbors& neighbors, ChunkMeshData& meshData,
+		MeshingMode mode = MeshingMode::NAIVE, const ChunkLight* light = nullptr);
+
+	// The border light is left out when light is null
+	static std::shared_ptr<const ChunkEdge> extractEdge(const ChunkStorage& voxels, Face side, const ChunkLight* light = nullptr);
+	static ChunkBorders extractBorders(const ChunkStorage& voxels, const ChunkLight* light = nullptr);
+	static Face oppositeFace(Face face);
+	// Voxel on the given side of a chunk at cell (a, b) of its border slice, laid out like ChunkEdge
+	static glm::ivec3 borderCell(Face side, int a, int b) {
+		switch (side) {
+		case Face::LEFT:   return glm::ivec3(0, b, a);
+		case Face::RIGHT:  return glm::ivec3(CHUNK_SIZE - 1, b, a);
+		case Face::BACK:   return glm::ivec3(a, b, 0);
+		case Face::FRONT:  return glm::ivec3(a, b, CHUNK_SIZE - 1);
+		case Face::BOTTOM: return glm::ivec3(a, 0, b);
+		case Face::TOP:
+		default:           return glm::ivec3(a, CHUNK_HEIGHT - 1, b);
+		}
+	}
+	// Texture layer stored in the vertices of this block face
+	static int textureLayer(VoxelType type, Face face);
 
 	// This old function is kept for compatibility but is now a dummy
 	Voxel& getBlock(int x, int y, int z);
 
-	void rebuildMesh();
+	// Remeshes the whole chunk right away, superseding any edit remesh still running
+	void rebuildMesh(const ChunkNeighbors& neighbors, MeshingMode mode = MeshingMode::NAIVE);
+	// Records an edit, returns the version a remesh of it must match
+	uint32_t markEdited();
+	// Uploads an edit remesh unless the chunk changed again since; returns false if dropped
+	bool applyRemesh(uint32_t version, std::shared_ptr<const ChunkMeshData> data);
+	std::shared_ptr<const ChunkMeshData> getGeometry() const { return geometry; }
+	uint32_t getMeshVersion() const { return meshVersion; }
 	void setBlock(int localX, int localY, int localZ, VoxelType type);
+	const ChunkHeightmap& getHeightmap() const { return heightmap; }
+	void setHeightmap(const ChunkHeightmap& map) { heightmap = map; }
 
 	// CORRECTED: Renamed function to avoid overload conflict
 	VoxelType getBlockType(int localX, int localY, int localZ);
 
+	size_t getVertexCount() const { return vertexCount; }
+	size_t getIndexCount() const { return indexCount; }
+	size_t getSeamFacesCulled() const { return seamFacesCulled; }
+	uint8_t getNeighborMask() const { return neighborMask; }
+	size_t getMeshBytes() const { return meshBytes; }
+	bool hasGeometry() const { return hasMesh; }
+	glm::vec3 getBoundsMin() const { return boundsMin; }
+	glm::vec3 getBoundsMax() const { return boundsMax; }
+	// Draw calls the per-material meshes used before the texture array would need
+	int getMaterialBucketCount() const;
+
 private:
-	void loadTextures();
+	static TextureArray blockTextures;
+	static bool blockTexturesLoaded;
+
+	// Both mesh the layers [minY, maxY) of the chunk, the ones holding solid voxels
+	static void buildNaiveMesh(const ChunkStorage& voxels, const ChunkNeighbors& neighbors, const ChunkLight* light, ChunkMeshData& meshData, int minY, int maxY);
+	static void buildGreedyMesh(const std::vector<VoxelType>& dense, const ChunkNeighbors& neighbors, const ChunkLight* light, ChunkMeshData& meshData, int minY, int maxY);
+	// Light of the air voxel at (x, y, z), which may lie just outside the chunk
+	static uint8_t faceLight(const ChunkLight* light, const ChunkNeighbors& neighbors, int x, int y, int z);
+	// Appends one quad and records which per-material mesh it used to belong to
+	static void emitQuad(ChunkMeshData& meshData, VoxelType type, glm::ivec3 minCorner, glm::ivec3 size, Face face, uint8_t light);
 };
 
 #endif
\ No newline at end of file
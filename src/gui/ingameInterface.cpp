@@ -3,6 +3,8 @@
 #include "../player/Player.h"
 #include "../graphics/env/World.h"
 #include "../graphics/models/voxel.hpp"
+#include "../graphics/TextureCache.h"
+#include "../jobs/JobSystem.h"
 
 IngameInterface::IngameInterface(GLFWwindow* window)
 	: window(window),
@@ -41,7 +43,7 @@ void IngameInterface::updateFPS(double currentTime) {
 	}
 }
 
-void IngameInterface::renderImGui(const World& world, Player& player,
+void IngameInterface::renderImGui(World& world, Player& player,
 	const Camera& cam, float deltaTime,
 	const RaycastInfo& raycastInfo, bool guiMode) {
 
@@ -57,6 +59,18 @@ void IngameInterface::renderImGui(const World& world, Player& player,
 	ImGui::Text("FPS: %.1f", fps);
 	ImGui::Text("Frame Time: %.2f ms", frameTime);
 	ImGui::Text("Delta Time: %.4f s", deltaTime);
+	ImGui::Text("Textures: %zu loaded, %.1f MB", TextureCache::getTextureCount(),
+		TextureCache::getMemoryUsage() / (1024.0 * 1024.0));
+	ImGui::Text("Texture Loads: %zu decoded, %zu shared", TextureCache::getLoadCount(), TextureCache::getHitCount());
+	ImGui::Text("Block Texture Array: %.1f KB", VoxelChunk::getBlockTextureBytes() / 1024.0);
+	ImGui::Text("Chunk Draw Calls: %d (%d with per-material meshes)", world.getDrawCalls(), world.getMaterialDrawCalls());
+	ImGui::Text("Chunks Visible: %d, Culled: %d", world.getVisibleChunks(), world.getCulledChunks());
+	const UploadScheduler& uploads = world.getUploadScheduler();
+	ImGui::Text("Chunk Uploads: %d, %.2f ms, %.0f KB (budget %.2f ms)", uploads.getLastUploads(),
+		uploads.getLastUploadMs(), uploads.getLastUploadBytes() / 1024.0, uploads.getFrameBudgetMs());
+	ImGui::Text("Upload Cost: %.2f ms/MB + %.3f ms per chunk for its light seams", uploads.getMsPerMegabyte(), uploads.getMsPerChunk());
+	JobSystem& jobs = JobSystem::get();
+	ImGui::Text("Jobs: %zu run, %zu stolen (%u workers)", jobs.getJobsRun(), jobs.getJobsStolen(), jobs.getWorkerCount());
 
 	// Show GUI mode status
 	ImGui::Separator();
@@ -79,6 +93,7 @@ void IngameInterface::renderImGui(const World& world, Player& player,
 	ImGui::Text("  Y: %.2f", playerPos.y);
 	ImGui::Text("  Z: %.2f", playerPos.z);
 	ImGui::Text("On Ground: %s", player.isOnGround() ? "Yes" : "No");
+	ImGui::Text("Biome: %s", BiomeMap::info(world.getBiomeAt(static_cast<int>(std::floor(playerPos.x)), static_cast<int>(std::floor(playerPos.z)))).name);
 
 	// Selected block info
 	if (raycastInfo.blockSelected) {
@@ -97,7 +112,52 @@ void IngameInterface::renderImGui(const World& world, Player& player,
 	if (guiMode) {
 		// World info window
 		ImGui::Begin("World Info", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
-		ImGui::Text("Render Distance: %d", world.getRenderDistance());
+		ImGui::Text("Render Distance: %d (%d layers up and down)", world.getRenderDistance(), world.getVerticalRenderDistance());
+		ImGui::Text("Terrain: %s", world.getTerrainMode() == TerrainMode::DENSITY ? "3D density" : "2D heightmap");
+		ImGui::Text("  graph %s, %zu nodes in %zu steps", world.getTerrainGraph().getSource().c_str(),
+			world.getTerrainGraph().getNodeCount(), world.getTerrainGraph().getStepCount());
+		ImGui::Text("Features: %zu placed, %zu writes queued, %zu late merges", world.getFeaturesPlaced(),
+			world.getPendingWrites().getPushedWrites(), world.getLateFeatureMerges());
+
+		WorldMeshStats meshStats = world.getMeshStats();
+		ImGui::Text("Loaded Chunks: %zu", meshStats.chunks);
+		ImGui::Text("Vertices: %zu (%.0f per chunk)", meshStats.vertices,
+			meshStats.chunks > 0 ? static_cast<double>(meshStats.vertices) / meshStats.chunks : 0.0);
+		ImGui::Text("Indices: %zu (%.0f per chunk)", meshStats.indices,
+			meshStats.chunks > 0 ? static_cast<double>(meshStats.indices) / meshStats.chunks : 0.0);
+		ImGui::Text("Meshing Time: %.3f ms per chunk", meshStats.avgMeshingMs);
+		ImGui::Text("Seam Faces Culled: %zu", meshStats.seamFacesCulled);
+		ChunkCancelStats cancelStats = world.getCancelStats();
+		ImGui::Text("Cancelled Chunks: %zu queued, %zu before generation",
+			cancelStats.queued, cancelStats.beforeGeneration);
+		ImGui::Text("  %zu before meshing, %zu before upload",
+			cancelStats.beforeMeshing, cancelStats.beforeUpload);
+		ChunkPipeline& pipeline = world.getPipeline();
+		ImGui::Text("Chunk Pipeline: %zu building, %.0f ms from queued to uploaded", pipeline.size(), pipeline.getAverageLatencyMs());
+		for (int s = static_cast<int>(ChunkStage::TERRAIN); s <= static_cast<int>(ChunkStage::UPLOAD); s++) {
+			ChunkStageStats stage = pipeline.getStats(static_cast<ChunkStage>(s));
+			ImGui::Text("  %-8s %3zu waiting (peak %zu), %2zu running, %.3f ms", ChunkPipeline::stageName(static_cast<ChunkStage>(s)),
+				stage.waiting, stage.peakWaiting, stage.running, stage.averageMs);
+		}
+		ImGui::Text("Mesh Memory: %.1f KB (%.1f KB per chunk)", meshStats.meshBytes / 1024.0,
+			meshStats.chunks > 0 ? meshStats.meshBytes / 1024.0 / meshStats.chunks : 0.0);
+		ChunkEditStats editStats = world.getEditStats();
+		ImGui::Text("Last Edit: %.0f us, %d chunks queued for remeshing", editStats.lastMicroseconds, editStats.lastRemeshes);
+		ImGui::Text("  average %.0f us over %zu edits", editStats.averageMicroseconds, editStats.edits);
+		ImGui::Text("  remeshed in %.0f us, on screen after %.1f ms (%d frames)", editStats.lastRemeshMicroseconds,
+			editStats.lastLatencyMs, editStats.lastLatencyFrames);
+		ImGui::Text("  %zu stale remeshes dropped", editStats.staleRemeshes);
+		ImGui::Text("  relit in %.0f us (average %.0f us): %d voxels, %d chunks", editStats.lastRelightMicroseconds,
+			editStats.averageRelightMicroseconds, editStats.lastRelitVoxels, editStats.lastRelitChunks);
+		ImGui::Text("Light Seams: %zu chunks relit by a neighbour loading", world.getSeamRelights());
+		if (RegionStore* regions = world.getRegionStore()) {
+			ImGui::Text("Saved Chunks: %zu loaded (%.3f ms each), %zu written, %zu pending, %zu failed", regions->getChunksLoaded(),
+				regions->getAverageLoadMs(), regions->getChunksWritten(), regions->getPendingWrites(), regions->getFailedWrites());
+		}
+		if (EditJournal* journal = world.getEditJournal()) {
+			ImGui::Text("Edit Journal: %zu voxels, %.1f KB, %zu compactions", journal->getDeltaCount(),
+				journal->getFileBytes() / 1024.0, journal->getCompactions());
+		}
 
 		ImGui::Separator();
 		ImGui::Text("Controls:");
@@ -106,6 +166,7 @@ void IngameInterface::renderImGui(const World& world, Player& player,
 		ImGui::Text("Mouse - Look");
 		ImGui::Text("Left Click - Launch projectile");
 		ImGui::Text("Right Click - Place block");
+		ImGui::Text("1 / 2 - Place cobblestone / lamp");
 		ImGui::Text("T - Teleport to safe position");
 		ImGui::Text("Tab - Toggle GUI Mode");
 
@@ -120,6 +181,25 @@ void IngameInterface::renderImGui(const World& world, Player& player,
 				// world.setRenderDistance(renderDistance);
 			}
 
+			bool greedyMeshing = world.getMeshingMode() == MeshingMode::GREEDY;
+			if (ImGui::Checkbox("Greedy Meshing", &greedyMeshing)) {
+				world.setMeshingMode(greedyMeshing ? MeshingMode::GREEDY : MeshingMode::NAIVE);
+			}
+			UploadScheduler& uploadScheduler = world.getUploadScheduler();
+			float uploadBudget = static_cast<float>(uploadScheduler.getBudgetMs());
+			if (ImGui::SliderFloat("Upload Budget (ms)", &uploadBudget, 0.25f, 8.0f)) {
+				uploadScheduler.setBudgetMs(uploadBudget);
+			}
+			float targetFrameTime = static_cast<float>(uploadScheduler.getTargetFrameMs());
+			if (ImGui::SliderFloat("Target Frame Time (ms)", &targetFrameTime, 4.0f, 33.3f)) {
+				uploadScheduler.setTargetFrameMs(targetFrameTime);
+			}
+
+			bool frustumCulling = world.getFrustumCulling();
+			if (ImGui::Checkbox("Frustum Culling", &frustumCulling)) {
+				world.setFrustumCulling(frustumCulling);
+			}
+
 			static bool wireframe = false;
 			if (ImGui::Checkbox("Wireframe", &wireframe)) {
 				if (wireframe) {
@@ -25,7 +25,7 @@ public:
 	void initImGui();
 	void cleanupImGui();
 	void updateFPS(double currentTime);
-	void renderImGui(const World& world, Player& player, const Camera& cam,
+	void renderImGui(World& world, Player& player, const Camera& cam,
 		float deltaTime, const RaycastInfo& raycastInfo, bool guiMode = false);
 
 private:
@@ -0,0 +1,222 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace {
+	// Which worker of which JobSystem the current thread is, -1 for any other thread
+	thread_local const JobSystem* t_owner = nullptr;
+	thread_local int t_workerIndex = -1;
+}
+
+JobSystem::JobSystem(unsigned int noWorkers)
+	: m_running(true),
+	m_queuedJobs(0),
+	m_nextQueue(0),
+	m_urgentCount(0),
+	m_mainThreadId(std::this_thread::get_id()),
+	m_jobsRun(0),
+	m_jobsStolen(0) {
+	if (noWorkers == 0) {
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		noWorkers = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < noWorkers; i++) {
+		m_queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+	}
+	for (unsigned int i = 0; i < noWorkers; i++) {
+		m_workers.emplace_back(&JobSystem::workerLoop, this, static_cast<int>(i));
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_running = false;
+	}
+	m_wakeCond.notify_all();
+	for (std::thread& worker : m_workers) {
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+}
+
+JobSystem& JobSystem::get() {
+	static JobSystem instance;
+	return instance;
+}
+
+JobHandle JobSystem::submit(std::function<void()> task, const std::vector<JobHandle>& dependencies, JobPriority priority) {
+	return makeJob(std::move(task), false, dependencies, priority);
+}
+
+JobHandle JobSystem::submitMainThread(std::function<void()> task, const std::vector<JobHandle>& dependencies) {
+	return makeJob(std::move(task), true, dependencies, JobPriority::NORMAL);
+}
+
+JobHandle JobSystem::makeJob(std::function<void()> task, bool mainThread, const std::vector<JobHandle>& dependencies, JobPriority priority) {
+	JobHandle job = std::make_shared<Job>();
+	job->task = std::move(task);
+	job->mainThread = mainThread;
+	job->priority = priority;
+
+	for (const JobHandle& dependency : dependencies) {
+		if (!dependency) continue;
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (!dependency->finished) {
+			job->pendingDependencies++;
+			dependency->continuations.push_back(job);
+		}
+	}
+
+	// drop the reference held while registering; schedule now if nothing is left
+	if (--job->pendingDependencies == 0) {
+		schedule(job);
+	}
+	return job;
+}
+
+void JobSystem::schedule(const JobHandle& job) {
+	if (job->mainThread) {
+		std::lock_guard<std::mutex> lock(m_mainMutex);
+		m_mainJobs.push_back(job);
+		return;
+	}
+
+	if (job->priority == JobPriority::HIGH) {
+		std::lock_guard<std::mutex> lock(m_urgentMutex);
+		m_urgentJobs.push_back(job);
+		m_urgentCount++;
+	}
+	else {
+		// workers keep their own follow-up jobs, everyone else spreads them round robin
+		int index = currentWorkerIndex();
+		if (index < 0) {
+			index = static_cast<int>(m_nextQueue++ % m_queues.size());
+		}
+		std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+		m_queues[index]->jobs.push_back(job);
+	}
+
+	m_queuedJobs++;
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+	}
+	m_wakeCond.notify_one();
+}
+
+void JobSystem::execute(const JobHandle& job) {
+	job->task();
+	m_jobsRun++;
+
+	std::vector<JobHandle> continuations;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finished = true;
+		continuations.swap(job->continuations);
+	}
+	job->done = true;
+
+	for (const JobHandle& continuation : continuations) {
+		if (--continuation->pendingDependencies == 0) {
+			schedule(continuation);
+		}
+	}
+}
+
+bool JobSystem::tryRunOne(int workerIndex) {
+	JobHandle job;
+
+	if (m_urgentCount > 0) {
+		std::lock_guard<std::mutex> lock(m_urgentMutex);
+		if (!m_urgentJobs.empty()) {
+			job = std::move(m_urgentJobs.front());
+			m_urgentJobs.pop_front();
+			m_urgentCount--;
+		}
+	}
+
+	if (!job && workerIndex >= 0) {
+		WorkerQueue& own = *m_queues[workerIndex];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.jobs.empty()) {
+			job = std::move(own.jobs.back());
+			own.jobs.pop_back();
+		}
+	}
+
+	if (!job) {
+		size_t count = m_queues.size();
+		size_t start = workerIndex >= 0 ? static_cast<size_t>(workerIndex) + 1 : m_nextQueue.load();
+		for (size_t i = 0; i < count && !job; i++) {
+			size_t victim = (start + i) % count;
+			if (static_cast<int>(victim) == workerIndex) continue;
+			WorkerQueue& other = *m_queues[victim];
+			std::lock_guard<std::mutex> lock(other.mutex);
+			if (!other.jobs.empty()) {
+				job = std::move(other.jobs.front());
+				other.jobs.pop_front();
+				m_jobsStolen++;
+			}
+		}
+	}
+
+	if (!job) {
+		return false;
+	}
+	m_queuedJobs--;
+	execute(job);
+	return true;
+}
+
+void JobSystem::workerLoop(int workerIndex) {
+	t_owner = this;
+	t_workerIndex = workerIndex;
+
+	while (true) {
+		if (tryRunOne(workerIndex)) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		m_wakeCond.wait(lock, [this] { return m_queuedJobs > 0 || !m_running; });
+		if (!m_running && m_queuedJobs <= 0) {
+			return;
+		}
+	}
+}
+
+int JobSystem::currentWorkerIndex() const {
+	return t_owner == this ? t_workerIndex : -1;
+}
+
+void JobSystem::wait(const JobHandle& job) {
+	if (!job) return;
+	waitUntil([&job] { return job->done.load(); });
+}
+
+void JobSystem::waitUntil(const std::function<bool()>& condition) {
+	bool onMainThread = std::this_thread::get_id() == m_mainThreadId;
+	int workerIndex = currentWorkerIndex();
+	while (!condition()) {
+		if (onMainThread && runMainThreadJobs() > 0) {
+			continue;
+		}
+		if (!tryRunOne(workerIndex)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+int JobSystem::runMainThreadJobs() {
+	std::deque<JobHandle> jobs;
+	{
+		std::lock_guard<std::mutex> lock(m_mainMutex);
+		jobs.swap(m_mainJobs);
+	}
+	for (const JobHandle& job : jobs) {
+		execute(job);
+	}
+	return static_cast<int>(jobs.size());
+}
@@ -0,0 +1,110 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// HIGH jobs are taken before any NORMAL job, for work the player is waiting on
+enum class JobPriority {
+	NORMAL,
+	HIGH
+};
+
+// One unit of work. Jobs only start once every dependency has finished.
+struct Job {
+	std::function<void()> task;
+	bool mainThread = false;
+	JobPriority priority = JobPriority::NORMAL;
+
+	// dependencies still running, plus one held by submit() while it registers them
+	std::atomic<int> pendingDependencies{ 1 };
+	std::atomic<bool> done{ false };
+
+	// guards finished and continuations
+	std::mutex mutex;
+	bool finished = false;
+	std::vector<std::shared_ptr<Job>> continuations;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+// Work-stealing job system shared by the whole engine.
+//
+// Every worker owns a deque: it pushes and pops its own jobs at the back and, when
+// that runs dry, steals from the front of the others'. One core is left to the
+// main thread, which also gets a queue of its own for jobs that have to run where
+// the GL context lives (uploads, texture creation); those run in runMainThreadJobs().
+// Threads waiting on a job help out by running other jobs in the meantime.
+// HIGH priority jobs share one queue that every worker checks before its own deque.
+class JobSystem {
+public:
+	// noWorkers 0 means one per hardware thread minus the main thread
+	explicit JobSystem(unsigned int noWorkers = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// The engine-wide instance, created on first use
+	static JobSystem& get();
+
+	JobHandle submit(std::function<void()> task, const std::vector<JobHandle>& dependencies = {},
+		JobPriority priority = JobPriority::NORMAL);
+	// Same, but the job runs on the main thread in runMainThreadJobs()
+	JobHandle submitMainThread(std::function<void()> task, const std::vector<JobHandle>& dependencies = {});
+
+	// Runs jobs until the handle has finished
+	void wait(const JobHandle& job);
+	// Runs jobs until condition() holds, for waiting on work that isn't one handle
+	void waitUntil(const std::function<bool()>& condition);
+
+	// Main thread only: runs the main-thread jobs queued so far, returns how many ran
+	int runMainThreadJobs();
+
+	unsigned int getWorkerCount() const { return static_cast<unsigned int>(m_workers.size()); }
+	size_t getJobsRun() const { return m_jobsRun; }
+	size_t getJobsStolen() const { return m_jobsStolen; }
+
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	std::vector<std::thread> m_workers;
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+	std::atomic<bool> m_running;
+
+	// Sleeping workers wait here while nothing is queued
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCond;
+	std::atomic<int> m_queuedJobs;
+	std::atomic<unsigned int> m_nextQueue;
+
+	std::mutex m_urgentMutex;
+	std::deque<JobHandle> m_urgentJobs;
+	std::atomic<int> m_urgentCount;
+
+	std::mutex m_mainMutex;
+	std::deque<JobHandle> m_mainJobs;
+	std::thread::id m_mainThreadId;
+
+	std::atomic<size_t> m_jobsRun;
+	std::atomic<size_t> m_jobsStolen;
+
+	JobHandle makeJob(std::function<void()> task, bool mainThread, const std::vector<JobHandle>& dependencies, JobPriority priority);
+	void schedule(const JobHandle& job);
+	void execute(const JobHandle& job);
+	// Takes one queued job: urgent ones, then the own deque, then stealing; index -1 for non-worker threads
+	bool tryRunOne(int workerIndex);
+	void workerLoop(int workerIndex);
+	int currentWorkerIndex() const;
+};
+
+#endif
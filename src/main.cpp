@@ -38,6 +38,9 @@
 #include "gui/ingameInterface.h"
 #include "graphics/models/donut.hpp"
 
+#include "benchmark/Benchmark.h"
+#include "jobs/JobSystem.h"
+
 
 struct RaycastHit {
 	bool hit = false;
@@ -67,6 +70,8 @@ Shader selectionShader;
 unsigned int selectionVAO, selectionVBO;
 bool blockSelected = false;
 glm::ivec3 selectedBlockPos;
+// What right click places, 1 and 2 pick it
+VoxelType placedBlockType = VoxelType::COBBLESTONE;
 
 Shader crosshairShader;
 unsigned int crosshairVAO, crosshairVBO;
@@ -128,8 +133,41 @@ bool isValidPlacementPosition(glm::ivec3 pos);
 void toggleGUIMode();
 
 
-int main()
+int main(int argc, char** argv)
 {
+	// Options combine in any order, e.g. --density --save regions --terrain-graph mine.graph --bench graph
+	std::string benchmark;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--density") {
+			world.setTerrainMode(TerrainMode::DENSITY);
+		}
+		else if (arg == "--terrain-graph" && i + 1 < argc) {
+			world.loadTerrainGraph(argv[++i]);
+		}
+		else if (arg == "--save" && i + 1 < argc) {
+			std::string mode = argv[++i];
+			if (mode == "regions") {
+				world.setSaveMode(SaveMode::REGION_FILES);
+			}
+			else if (mode == "journal") {
+				world.setSaveMode(SaveMode::EDIT_JOURNAL);
+			}
+			else {
+				std::cout << "Unknown save mode " << mode << ", expected regions or journal" << std::endl;
+			}
+		}
+		else if (arg == "--bench" && i + 1 < argc) {
+			benchmark = argv[++i];
+		}
+		else {
+			std::cout << "Unknown option " << arg << std::endl;
+		}
+	}
+	if (!benchmark.empty()) {
+		return Benchmark::run(benchmark, world);
+	}
+
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -155,10 +193,15 @@ int main()
 
 	Shader shader("assets/vertex_core.glsl", "assets/fragment_core.glsl");
 	Shader lampShader("assets/vertex_core.glsl", "assets/lamp.fs");
+	// Chunks use packed VoxelVertex data with their sky and block light baked in
+	Shader voxelShader("assets/voxel.vs", "assets/voxel.fs");
 
 	selectionShader = Shader("assets/selection.vs", "assets/selection.fs");
 	crosshairShader = Shader("assets/crosshair.vs", "assets/crosshair.fs");
 
+	// Decode the block textures once, every chunk shares them
+	VoxelChunk::loadBlockTextures();
+
 	// SETUP RENDERING OBJECTS
 	setupSelectionOutline();
 	setupCrosshair();
@@ -372,7 +415,8 @@ int main()
 			firstFrame = false;
 		}
 
-		world.update(currentCam->cameraPos); // Update world based on camera position
+		world.update(currentCam->cameraPos, currentCam->cameraFront); // Update world based on camera position
+		JobSystem::get().runMainThreadJobs();
 
 		// Also add this right before world.render(shader):
 		static int frameCount = 0;
@@ -384,7 +428,12 @@ int main()
 				<< currentCam->cameraPos.z << ")" << std::endl;
 		}
 
-		world.render(shader);
+		voxelShader.activate();
+		voxelShader.setFloat("skyBrightness", 1.0f);
+		voxelShader.setMat4("view", view);
+		voxelShader.setMat4("projection", projection);
+
+		world.render(voxelShader, projection * view);
 
 		if (blockSelected) {
 			renderSelectionOutline(view, projection);
@@ -440,6 +489,7 @@ int main()
 	glDeleteBuffers(1, &crosshairVBO);
 
 	world.cleanup();
+	VoxelChunk::releaseBlockTextures();
 	glfwTerminate();
 	return 0;
 }
@@ -553,6 +603,15 @@ void processInput(double dt) {
 			player.teleportToSafePosition();
 		}
 
+		if (Keyboard::keyWentDown(GLFW_KEY_1)) {
+			placedBlockType = VoxelType::COBBLESTONE;
+			std::cout << "Placing: cobblestone" << std::endl;
+		}
+		if (Keyboard::keyWentDown(GLFW_KEY_2)) {
+			placedBlockType = VoxelType::LAMP;
+			std::cout << "Placing: lamp" << std::endl;
+		}
+
 		player.move(moveDirection);
 
 		if (Mouse::buttonWentDown(GLFW_MOUSE_BUTTON_LEFT)) {
@@ -566,7 +625,7 @@ void processInput(double dt) {
 			if (blockSelected) {
 				glm::ivec3 newBlockPos = calculateNewBlockPosition(selectedBlockPos, selectedBlockFace);
 				if (isValidPlacementPosition(newBlockPos)) {
-					world.placeBlock(newBlockPos.x, newBlockPos.y, newBlockPos.z, VoxelType::COBBLESTONE);
+					world.placeBlock(newBlockPos.x, newBlockPos.y, newBlockPos.z, placedBlockType);
 				}
 				else {
 					std::cout << "Cannot place block there!" << std::endl;